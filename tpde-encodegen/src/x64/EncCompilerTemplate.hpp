@@ -58,7 +58,7 @@ struct EncodeCompiler {
     using SymRef       = typename Assembler::SymRef;
 
     [[nodiscard]] static std::optional<i32> encodeable_as_imm32_sext(GenericValuePart &gv) noexcept;
-    [[nodiscard]] static std::optional<FeMem> encodeable_as_mem(GenericValuePart &gv, unsigned align) noexcept;
+    [[nodiscard]] std::optional<FeMem> encodeable_as_mem(GenericValuePart &gv, unsigned align) noexcept;
     [[nodiscard]] static std::optional<FeMem> encodeable_with(GenericValuePart &gv, FeMem other) noexcept;
     void          try_salvage_or_materialize(GenericValuePart &gv,
                                              ScratchReg     &dst_scratch,
@@ -168,7 +168,7 @@ std::optional<FeMem> EncodeCompiler<Adaptor, Derived, BaseTy, Config>::
         return std::nullopt;
     if (ap.frame_off() & (align - 1))
         return std::nullopt;
-    return FE_MEM(FE_BP, 0, FE_NOREG, ap.frame_off());
+    return derived()->frame_mem(ap.frame_off());
 }
 
 template <typename Adaptor,
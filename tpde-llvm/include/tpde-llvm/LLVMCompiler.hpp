@@ -2,9 +2,12 @@
 // SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <functional>
 #include <memory>
+#include <span>
+#include <string>
 #include <string_view>
 #include <vector>
 
@@ -17,6 +20,7 @@ class Triple;
 namespace tpde_llvm {
 
 class JITMapperImpl;
+class ObjectCache;
 
 /// In-memory mapper for JIT execution. Memory and registered unwind info will
 /// be released on destruction.
@@ -47,8 +51,45 @@ public:
 /// Compiler for LLVM modules
 class LLVMCompiler {
 protected:
+  /// Optional cache for compiled object files, not owned.
+  ObjectCache *object_cache = nullptr;
+  /// Description of the target for object cache keys.
+  std::string cache_target;
+  /// Module for which cache_source_hash identifies the content, see
+  /// set_object_cache_source.
+  const llvm::Module *cache_source_mod = nullptr;
+  std::array<uint8_t, 32> cache_source_hash;
+  /// Whether to shorten jumps to rel8 where possible (x86-64 only).
+  bool short_jumps = false;
+  /// Whether to lower dense switches to jump tables on AArch64.
+  bool arm64_jump_tables = false;
+  /// Maximum length of memcpy/memmove/memset with a constant length that are
+  /// expanded inline instead of calling the library function.
+  unsigned inline_mem_max_size = 64;
+  /// Whether to keep register assignments at branches to later blocks with a
+  /// single predecessor.
+  bool keep_regs_at_branches = false;
+  /// Whether to select registers to evict by their next use in the block.
+  bool evict_by_next_use = false;
+  /// Whether to prefer fixed registers for loop-carried values.
+  bool loop_fixed_regs = false;
+  /// Whether to strength-reduce integer mul/div/rem by constants.
+  bool const_strength_reduction = false;
+  /// Whether switch cases branch directly to target blocks without PHI nodes.
+  bool switch_direct_branches = false;
+  /// Whether to omit the frame pointer in leaf functions (x86-64 only).
+  bool omit_leaf_frame_pointer = false;
+
   LLVMCompiler() = default;
 
+  /// Description of all options that affect code generation, used as target
+  /// for object cache keys.
+  std::string cache_options() const noexcept;
+
+  /// Compute the object cache key for mod, using the source hash if it was set
+  /// for this module.
+  std::array<uint8_t, 32> object_cache_key(const llvm::Module &mod) noexcept;
+
 public:
   virtual ~LLVMCompiler();
 
@@ -56,10 +97,81 @@ public:
   LLVMCompiler &operator=(const LLVMCompiler &) = delete;
 
   /// Create a compiler for the specified target triple; returns null if the
-  /// triple is not supported. The only supported code model is small, the only
-  /// supported relocation model is PIC.
+  /// triple or CPU is not supported. The only supported code model is small,
+  /// the only supported relocation model is PIC.
+  ///
+  /// \param cpu LLVM CPU name whose features may be used, "native" for the
+  ///   host CPU; empty for the baseline of the architecture.
+  /// \param features Comma-separated list of LLVM target features to enable
+  ///   (+feature) or disable (-feature) in addition to the CPU features.
   static std::unique_ptr<LLVMCompiler>
-      create(const llvm::Triple &triple) noexcept;
+      create(const llvm::Triple &triple,
+             std::string_view cpu = {},
+             std::string_view features = {}) noexcept;
+
+  /// Use the cache for compile_to_elf and compile_and_map; the cache must
+  /// outlive the compiler. Pass null to disable caching.
+  void set_object_cache(ObjectCache *cache) noexcept { object_cache = cache; }
+
+  /// Identify mod by the buffer it was parsed from for the object cache,
+  /// instead of serializing it to bitcode for the cache lookup. Applies to the
+  /// next compilation of mod, which must not be modified after parsing.
+  void set_object_cache_source(const llvm::Module &mod,
+                               std::span<const uint8_t> source) noexcept;
+
+  /// Use the shortest encoding for jumps inside a function, which requires an
+  /// additional pass over the code of each function. Currently only
+  /// implemented for x86-64.
+  void set_short_jumps(bool enable) noexcept { short_jumps = enable; }
+
+  /// Lower dense switches to jump tables on AArch64 instead of a binary
+  /// search. On x86-64, jump tables are always used.
+  void set_arm64_jump_tables(bool enable) noexcept {
+    arm64_jump_tables = enable;
+  }
+
+  /// Set the maximum length in bytes of memcpy, memmove and memset with a
+  /// constant length that are expanded inline; 0 always calls the library
+  /// function.
+  void set_inline_mem_max_size(unsigned size) noexcept {
+    inline_mem_max_size = size;
+  }
+
+  /// Keep the register assignment at branches to blocks that have the
+  /// branching block as single predecessor but are not compiled directly
+  /// afterwards, so that these blocks need not reload the values.
+  void set_keep_regs_at_branches(bool enable) noexcept {
+    keep_regs_at_branches = enable;
+  }
+
+  /// Compute instruction-level next uses for each block and, when registers
+  /// run out, evict the value whose next use is farthest away.
+  void set_evict_by_next_use(bool enable) noexcept {
+    evict_by_next_use = enable;
+  }
+
+  /// Prefer fixed registers for the PHI nodes of innermost loop headers and
+  /// the values from inside the loop that flow into them.
+  void set_loop_fixed_regs(bool enable) noexcept { loop_fixed_regs = enable; }
+
+  /// Lower integer multiplication, division and remainder by constants to
+  /// shifts and multiply-high sequences instead of mul/div instructions.
+  void set_const_strength_reduction(bool enable) noexcept {
+    const_strength_reduction = enable;
+  }
+
+  /// Let switch cases branch directly to target blocks without PHI nodes
+  /// instead of going through a separate label per case.
+  void set_switch_direct_branches(bool enable) noexcept {
+    switch_direct_branches = enable;
+  }
+
+  /// Omit the frame pointer in functions without calls, keeping the stack
+  /// frame in the red zone below the stack pointer if it is small enough.
+  /// Currently only implemented for x86-64.
+  void set_omit_leaf_frame_pointer(bool enable) noexcept {
+    omit_leaf_frame_pointer = enable;
+  }
 
   /// Compile the module to an object file and emit it into the buffer. The
   /// module might be modified during compilation.
@@ -73,6 +185,19 @@ public:
   virtual JITMapper compile_and_map(
       llvm::Module &mod,
       std::function<void *(std::string_view)> resolver) noexcept = 0;
+
+  /// Like compile_and_map, but only map stubs for the defined functions, which
+  /// compile the function on its first call. Global variables are mapped
+  /// immediately. The compiler and the module must outlive the returned
+  /// mapper and must not be used otherwise in the meantime; resolver might be
+  /// called during later compilations. If the compilation of a function fails,
+  /// the error is logged and the call continues at error_handler with the
+  /// arguments of the function; without error handler, the process is
+  /// aborted.
+  virtual JITMapper compile_and_map_lazy(
+      llvm::Module &mod,
+      std::function<void *(std::string_view)> resolver,
+      void *error_handler = nullptr) noexcept = 0;
 };
 
 } // namespace tpde_llvm
@@ -0,0 +1,74 @@
+// SPDX-FileCopyrightText: 2025 Contributors to TPDE <https://tpde.org>
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace llvm {
+class Module;
+} // namespace llvm
+
+namespace tpde_llvm {
+
+/// Persistent on-disk cache for compiled object files, keyed on the content of
+/// the module, the target, and the TPDE/LLVM version. The cache directory can
+/// be shared by multiple processes: entries are written atomically and the
+/// total size is bounded by evicting the least recently used entries. Eviction
+/// runs when a process stored a significant part of the maximum size or a few
+/// minutes after the last eviction, so the size can temporarily exceed the
+/// limit.
+class ObjectCache {
+public:
+  using Key = std::array<uint8_t, 32>;
+
+private:
+  std::string dir;
+  uint64_t max_size;
+  /// Bytes stored by this cache since the last prune.
+  std::atomic<uint64_t> stored_since_prune = 0;
+
+public:
+  /// Create a cache in dir, which is created if it doesn't exist. If the total
+  /// size of the cached objects exceeds max_size bytes, least recently used
+  /// objects are removed.
+  ObjectCache(std::string dir, uint64_t max_size) noexcept;
+
+  /// Compute the key for a module. target must describe all target options
+  /// that affect code generation, e.g. triple and CPU features. If source_hash
+  /// is non-null, it identifies the module content (see hash_source);
+  /// otherwise, the module is serialized to bitcode, which is comparatively
+  /// expensive.
+  static Key compute_key(const llvm::Module &mod,
+                         std::string_view target,
+                         const Key *source_hash = nullptr) noexcept;
+
+  /// Hash the buffer the module was parsed from. Together with the module
+  /// identifier and the LLVM version, this identifies the module as long as it
+  /// is not modified after parsing.
+  static Key hash_source(const llvm::Module &mod,
+                         std::span<const uint8_t> source) noexcept;
+
+  /// Read the object file for the key into buf, returns true on a hit.
+  bool lookup(const Key &key, std::vector<uint8_t> &buf) noexcept;
+
+  /// Store the object file for the key. Failures are ignored.
+  void store(const Key &key, std::span<const uint8_t> obj) noexcept;
+
+private:
+  std::string entry_path(const Key &key) const noexcept;
+
+  /// Whether enough data was stored or enough time passed since the last
+  /// prune of any process.
+  bool should_prune() const noexcept;
+
+  /// Remove least recently used entries until the cache fits max_size.
+  void prune() noexcept;
+};
+
+} // namespace tpde_llvm
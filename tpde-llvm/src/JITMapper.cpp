@@ -7,6 +7,7 @@
 #include "tpde/AssemblerElf.hpp"
 #include "tpde/ElfMapper.hpp"
 
+#include <llvm/IR/Module.h>
 #include <llvm/Support/TimeProfiler.h>
 
 namespace tpde_llvm {
@@ -17,6 +18,64 @@ bool JITMapperImpl::map(tpde::AssemblerElfBase &assembler,
   return mapper.map(assembler, resolver);
 }
 
+bool JITMapperImpl::init_lazy(llvm::Module &mod,
+                              u32 func_count,
+                              std::function<void *(std::string_view)> resolver,
+                              LazyCompiler compiler,
+                              void *error_handler) noexcept {
+  lazy = std::make_unique<LazyState>();
+  lazy->mod = &mod;
+  lazy->resolver = std::move(resolver);
+  lazy->compiler = std::move(compiler);
+  lazy->func_addrs.resize(func_count);
+  return lazy->stubs.init(
+      func_count, &JITMapperImpl::lazy_compile, this, error_handler);
+}
+
+void *JITMapperImpl::lazy_compile(void *ctx, u32 func_idx) noexcept {
+  auto *self = static_cast<JITMapperImpl *>(ctx);
+  LazyState &lazy = *self->lazy;
+
+  std::lock_guard lock{lazy.mutex};
+  if (void *addr = lazy.func_addrs[func_idx]) {
+    // Another thread compiled the function in the meantime.
+    return addr;
+  }
+
+  llvm::TimeTraceScope time_scope("TPDE_LazyCompile");
+  auto [assembler, sym] = lazy.compiler(func_idx);
+  if (!assembler) {
+    return nullptr;
+  }
+
+  auto func_mapper = std::make_unique<tpde::ElfMapper>();
+  auto resolver = [self](std::string_view name) {
+    return self->lazy_resolve(name);
+  };
+  if (!func_mapper->map(*assembler, resolver)) {
+    return nullptr;
+  }
+
+  void *addr = func_mapper->get_sym_addr(sym);
+  lazy.mappers.push_back(std::move(func_mapper));
+  lazy.func_addrs[func_idx] = addr;
+  return addr;
+}
+
+void *JITMapperImpl::lazy_resolve(std::string_view name) noexcept {
+  // Globals of the module are mapped by the initial mapping (functions as
+  // their stubs); only external symbols are left to the user resolver.
+  llvm::StringRef name_ref{name.data(), name.size()};
+  if (const llvm::GlobalValue *gv = lazy->mod->getNamedValue(name_ref)) {
+    if (auto it = globals.find(gv); it != globals.end()) {
+      if (void *addr = mapper.get_sym_addr(it->second)) {
+        return addr;
+      }
+    }
+  }
+  return lazy->resolver(name);
+}
+
 JITMapper::JITMapper(std::unique_ptr<JITMapperImpl> impl) noexcept
     : impl(std::move(impl)) {}
 
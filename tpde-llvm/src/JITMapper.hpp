@@ -2,31 +2,92 @@
 // SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
 #pragma once
 
+#include "base.hpp"
 #include "tpde/AssemblerElf.hpp"
 #include "tpde/ElfMapper.hpp"
 
 #include <llvm/ADT/DenseMap.h>
 #include <llvm/IR/GlobalValue.h>
 
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+class Module;
+} // namespace llvm
+
 namespace tpde_llvm {
 
 class JITMapperImpl {
+public:
   using GlobalMap =
       llvm::DenseMap<const llvm::GlobalValue *, tpde::AssemblerElfBase::SymRef>;
 
+  /// Compile the function with the given index into an assembler that contains
+  /// only this function. Returns the assembler and the symbol of the function,
+  /// or a null assembler on failure.
+  using LazyCompiler = std::function<
+      std::pair<tpde::AssemblerElfBase *, tpde::AssemblerElfBase::SymRef>(
+          u32)>;
+
+private:
   tpde::ElfMapper mapper;
 
   GlobalMap globals;
 
+  struct LazyState {
+    llvm::Module *mod;
+    std::function<void *(std::string_view)> resolver;
+    LazyCompiler compiler;
+    tpde::LazyStubs stubs;
+    /// Protects compilation, which might be triggered from multiple threads.
+    std::mutex mutex;
+    /// Addresses of already compiled functions.
+    std::vector<void *> func_addrs;
+    /// Mappings of the lazily compiled functions.
+    std::vector<std::unique_ptr<tpde::ElfMapper>> mappers;
+  };
+
+  /// State for lazy compilation, only set for compile_and_map_lazy.
+  std::unique_ptr<LazyState> lazy;
+
 public:
   JITMapperImpl(GlobalMap &&globals) : globals(std::move(globals)) {}
 
+  /// Allocate stubs for lazy compilation of func_count functions, returns
+  /// true on success. Must be called before compilation of the module. Calls
+  /// of functions that fail to compile continue at error_handler.
+  bool init_lazy(llvm::Module &mod,
+                 u32 func_count,
+                 std::function<void *(std::string_view)> resolver,
+                 LazyCompiler compiler,
+                 void *error_handler) noexcept;
+
+  /// Address of the stub of the function with the given index.
+  void *lazy_stub_addr(u32 func_idx) const noexcept {
+    return lazy->stubs.stub_addr(func_idx);
+  }
+
+  void set_globals(GlobalMap &&globals) noexcept {
+    this->globals = std::move(globals);
+  }
+
   /// Map the ELF from the assembler into memory, returns true on success.
   bool map(tpde::AssemblerElfBase &, tpde::ElfMapper::SymbolResolver) noexcept;
 
-  void *lookup_global(llvm::GlobalValue *gv) noexcept {
+  void *lookup_global(const llvm::GlobalValue *gv) noexcept {
     return mapper.get_sym_addr(globals.lookup(gv));
   }
+
+private:
+  static void *lazy_compile(void *ctx, u32 func_idx) noexcept;
+
+  /// Resolve symbol referenced by a lazily compiled function.
+  void *lazy_resolve(std::string_view name) noexcept;
 };
 
 } // namespace tpde_llvm
@@ -67,6 +67,72 @@ static void sort_phi_entries(llvm::PHINode *phi) {
   assert(std::is_sorted(blocks, blocks + count));
 }
 
+/// Conservatively determine whether compiling the instruction may emit a
+/// call, either because it is a call or because it is lowered to a library
+/// call.
+static bool inst_may_emit_call(const llvm::Instruction *inst) {
+  if (auto *call = llvm::dyn_cast<llvm::CallBase>(inst)) {
+    auto *intrin = llvm::dyn_cast<llvm::IntrinsicInst>(call);
+    if (!intrin) {
+      return true;
+    }
+    switch (intrin->getIntrinsicID()) {
+    case llvm::Intrinsic::donothing:
+    case llvm::Intrinsic::sideeffect:
+    case llvm::Intrinsic::experimental_noalias_scope_decl:
+    case llvm::Intrinsic::dbg_assign:
+    case llvm::Intrinsic::dbg_declare:
+    case llvm::Intrinsic::dbg_label:
+    case llvm::Intrinsic::dbg_value:
+    case llvm::Intrinsic::assume:
+    case llvm::Intrinsic::lifetime_start:
+    case llvm::Intrinsic::lifetime_end:
+    case llvm::Intrinsic::invariant_start:
+    case llvm::Intrinsic::invariant_end:
+    case llvm::Intrinsic::expect:
+    case llvm::Intrinsic::fabs:
+    case llvm::Intrinsic::abs:
+    case llvm::Intrinsic::umin:
+    case llvm::Intrinsic::umax:
+    case llvm::Intrinsic::smin:
+    case llvm::Intrinsic::smax:
+    case llvm::Intrinsic::ptrmask:
+    case llvm::Intrinsic::bswap:
+    case llvm::Intrinsic::ctpop:
+    case llvm::Intrinsic::ctlz:
+    case llvm::Intrinsic::cttz: break;
+    default: return true;
+    }
+  }
+
+  switch (inst->getOpcode()) {
+  case llvm::Instruction::FRem:
+  case llvm::Instruction::Resume: return true;
+  case llvm::Instruction::UDiv:
+  case llvm::Instruction::SDiv:
+  case llvm::Instruction::URem:
+  case llvm::Instruction::SRem:
+  case llvm::Instruction::FPToUI:
+  case llvm::Instruction::FPToSI:
+  case llvm::Instruction::UIToFP:
+  case llvm::Instruction::SIToFP:
+    // i128 division and conversions use libcalls.
+    if (inst->getType()->getScalarSizeInBits() > 64 ||
+        inst->getOperand(0)->getType()->getScalarSizeInBits() > 64) {
+      return true;
+    }
+    break;
+  default: break;
+  }
+
+  // All fp128 operations use libcalls.
+  if (inst->getType()->getScalarType()->isFP128Ty()) {
+    return true;
+  }
+  return inst->getNumOperands() > 0 &&
+         inst->getOperand(0)->getType()->getScalarType()->isFP128Ty();
+}
+
 std::pair<llvm::Value *, llvm::Instruction *>
     LLVMAdaptor::fixup_constant(llvm::Constant *cst,
                                 llvm::Instruction *ins_before) {
@@ -167,6 +233,10 @@ llvm::Instruction *LLVMAdaptor::handle_inst_in_block(llvm::Instruction *inst) {
     func_has_dynamic_alloca = true;
   }
 
+  if (!func_may_emit_calls && inst_may_emit_call(inst)) {
+    func_may_emit_calls = true;
+  }
+
   // Check operands for constants; PHI nodes are handled by predecessors.
   if (!llvm::isa<llvm::PHINode>(inst)) {
     for (llvm::Use &use : inst->operands()) {
@@ -211,6 +281,15 @@ llvm::Instruction *LLVMAdaptor::handle_inst_in_block(llvm::Instruction *inst) {
   auto [ty, complex_part_idx] = lower_type(inst->getType());
   values.push_back(ValInfo{
       .type = ty, .fused = fused, .complex_part_tys_idx = complex_part_idx});
+  if (ty == LLVMBasicValType::v256) {
+    func_has_v256 = true;
+  } else if (auto *store = llvm::dyn_cast<llvm::StoreInst>(inst);
+             store && vec256_legal &&
+             store->getValueOperand()->getType()->isVectorTy()) {
+    // Stored constants are materialized into a register, too.
+    llvm::Type *val_ty = store->getValueOperand()->getType();
+    func_has_v256 |= lower_simple_type(val_ty).first == LLVMBasicValType::v256;
+  }
   return nullptr;
 }
 
@@ -236,6 +315,8 @@ bool LLVMAdaptor::switch_func(const IRFuncRef function) noexcept {
   block_succ_ranges.clear();
   initial_stack_slot_indices.clear();
   func_has_dynamic_alloca = false;
+  func_may_emit_calls = false;
+  func_has_v256 = false;
 
   // we keep globals around for all function compilation
   // and assign their value indices at the start of the compilation
@@ -315,6 +396,7 @@ bool LLVMAdaptor::switch_func(const IRFuncRef function) noexcept {
     const auto [ty, complex_part_idx] = lower_type(arg->getType());
     values.push_back(ValInfo{
         .type = ty, .fused = false, .complex_part_tys_idx = complex_part_idx});
+    func_has_v256 |= ty == LLVMBasicValType::v256;
 
     // Check that all parameter types are layout-compatible to LLVM.
     check_type_compatibility(arg->getType(), ty, complex_part_idx);
@@ -456,7 +538,7 @@ void LLVMAdaptor::report_unsupported_type(llvm::Type *type) noexcept {
 }
 
 std::pair<LLVMBasicValType, unsigned long>
-    LLVMAdaptor::lower_simple_type(const llvm::Type *type) noexcept {
+    LLVMAdaptor::lower_simple_type(const llvm::Type *type) const noexcept {
   switch (type->getTypeID()) {
   case llvm::Type::FloatTyID: return {LLVMBasicValType::f32, 1};
   case llvm::Type::DoubleTyID: return {LLVMBasicValType::f64, 1};
@@ -528,6 +610,9 @@ std::pair<LLVMBasicValType, unsigned long>
     //   (no widened vectors: x86-64 would widen, but AArch64 would promote)
     // - Floating-point elements: v2f32, v4f32, v2f64
     //   (single-element vectors would be scalarized; v3f32 would need 12b load)
+    // - If the target has 256-bit vector registers (x86-64 with AVX), also
+    //   v32i8, v16i16, v8i32, v4i64, v8f32, v4f64. Otherwise, these would be
+    //   split into two halves, which we don't support.
     switch (el_ty->getTypeID()) {
     case llvm::Type::IntegerTyID: {
       unsigned el_width = el_ty->getIntegerBitWidth();
@@ -538,6 +623,8 @@ std::pair<LLVMBasicValType, unsigned long>
         return {LLVMBasicValType::v64, 1};
       } else if (el_width * num_elts == 128) {
         return {LLVMBasicValType::v128, 1};
+      } else if (el_width * num_elts == 256 && vec256_legal) {
+        return {LLVMBasicValType::v256, 1};
       }
       return {LLVMBasicValType::invalid, 0};
     }
@@ -546,11 +633,15 @@ std::pair<LLVMBasicValType, unsigned long>
         return {LLVMBasicValType::v64, 1};
       } else if (num_elts == 4) {
         return {LLVMBasicValType::v128, 1};
+      } else if (num_elts == 8 && vec256_legal) {
+        return {LLVMBasicValType::v256, 1};
       }
       return {LLVMBasicValType::invalid, 0};
     case llvm::Type::DoubleTyID:
       if (num_elts == 2) {
         return {LLVMBasicValType::v128, 1};
+      } else if (num_elts == 4 && vec256_legal) {
+        return {LLVMBasicValType::v256, 1};
       }
       return {LLVMBasicValType::invalid, 0};
     default: return {LLVMBasicValType::invalid, 0};
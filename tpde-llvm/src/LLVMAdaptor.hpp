@@ -185,6 +185,15 @@ struct LLVMAdaptor {
   bool func_unsupported = false;
   bool globals_init = false;
   bool func_has_dynamic_alloca = false;
+  /// Whether compiling the current function may emit calls, either for call
+  /// instructions or for operations that are implemented with library calls.
+  bool func_may_emit_calls = false;
+  /// Whether 256-bit vectors are held in a single register (v256). Must be
+  /// set by the target before the first type is lowered.
+  bool vec256_legal = false;
+  /// Whether the current function has v256 values, including stored
+  /// constants.
+  bool func_has_v256 = false;
   // Index boundaries into values.
   u32 global_idx_end = 0;
 
@@ -252,6 +261,12 @@ struct LLVMAdaptor {
     return func_has_dynamic_alloca;
   }
 
+  [[nodiscard]] bool cur_has_v256() const noexcept { return func_has_v256; }
+
+  [[nodiscard]] bool cur_may_emit_calls() const noexcept {
+    return func_may_emit_calls;
+  }
+
   [[nodiscard]] static IRBlockRef cur_entry_block() noexcept { return 0; }
 
   auto cur_blocks() const noexcept {
@@ -575,7 +590,7 @@ public:
     case v32: return 4;
     case v64: return 8;
     case v128: return 16;
-    case v256:
+    case v256: return 32;
     case v512:
     case complex:
     case invalid:
@@ -626,7 +641,7 @@ private:
     case v32: return 4;
     case v64: return 8;
     case v128: return 16;
-    case v256:
+    case v256: return 32;
     case v512:
     case complex:
     case invalid:
@@ -649,10 +664,10 @@ private:
     case f128:
     case v32:
     case v64:
-    case v128: return 1;
+    case v128:
+    case v256: return 1;
     case i128: return 2;
     case complex:
-    case v256:
     case v512:
     case none:
     case invalid:
@@ -687,8 +702,8 @@ private:
                                                      size_t desc_idx) noexcept;
 
   /// Returns (elem-type, num), with num > 0 and a valid type, or (invalid, 0).
-  static std::pair<LLVMBasicValType, unsigned long>
-      lower_simple_type(const llvm::Type *) noexcept;
+  std::pair<LLVMBasicValType, unsigned long>
+      lower_simple_type(const llvm::Type *) const noexcept;
 
   std::pair<LLVMBasicValType, unsigned long>
       lower_complex_type(llvm::Type *) noexcept;
@@ -2,9 +2,19 @@
 // SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
 
 #include "tpde-llvm/LLVMCompiler.hpp"
+#include "tpde-llvm/ObjectCache.hpp"
 
+#include <algorithm>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/TargetParser/AArch64TargetParser.h>
+#include <llvm/TargetParser/Host.h>
 #include <llvm/TargetParser/Triple.h>
+#include <llvm/TargetParser/X86TargetParser.h>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "arm64/LLVMCompilerArm64.hpp"
 #include "x64/LLVMCompilerX64.hpp"
@@ -13,13 +23,150 @@ namespace tpde_llvm {
 
 LLVMCompiler::~LLVMCompiler() = default;
 
-std::unique_ptr<LLVMCompiler>
-    LLVMCompiler::create(const llvm::Triple &triple) noexcept {
+std::string LLVMCompiler::cache_options() const noexcept {
+  std::string res = cache_target;
+  res += ";inline-mem=";
+  res += std::to_string(inline_mem_max_size);
+  if (short_jumps) {
+    res += ";short-jumps";
+  }
+  if (arm64_jump_tables) {
+    res += ";arm64-jump-tables";
+  }
+  if (keep_regs_at_branches) {
+    res += ";keep-regs-at-branches";
+  }
+  if (evict_by_next_use) {
+    res += ";next-use-evict";
+  }
+  if (loop_fixed_regs) {
+    res += ";loop-fixed-regs";
+  }
+  if (const_strength_reduction) {
+    res += ";const-strength-reduction";
+  }
+  if (switch_direct_branches) {
+    res += ";switch-direct-branches";
+  }
+  if (omit_leaf_frame_pointer) {
+    res += ";omit-leaf-fp";
+  }
+  return res;
+}
+
+std::array<uint8_t, 32>
+    LLVMCompiler::object_cache_key(const llvm::Module &mod) noexcept {
+  const ObjectCache::Key *source_hash = nullptr;
+  if (cache_source_mod == &mod) {
+    source_hash = &cache_source_hash;
+    // Compilation modifies the module, so the source only describes it once.
+    cache_source_mod = nullptr;
+  }
+  return ObjectCache::compute_key(mod, cache_options(), source_hash);
+}
+
+void LLVMCompiler::set_object_cache_source(
+    const llvm::Module &mod, std::span<const uint8_t> source) noexcept {
+  cache_source_mod = &mod;
+  cache_source_hash = ObjectCache::hash_source(mod, source);
+}
+
+namespace {
+
+/// Collect the LLVM target features of the CPU and apply the explicitly
+/// enabled/disabled features. Returns false for unknown CPUs or malformed
+/// feature strings.
+bool collect_features(const llvm::Triple &triple,
+                      std::string_view cpu,
+                      std::string_view features,
+                      llvm::StringMap<bool> &res) noexcept {
+  if (cpu == "native") {
+    res = llvm::sys::getHostCPUFeatures();
+  } else if (!cpu.empty() && cpu != "generic") {
+    switch (triple.getArch()) {
+    case llvm::Triple::x86_64: {
+      if (llvm::X86::parseArchX86(cpu, /*Only64Bit=*/true) ==
+          llvm::X86::CK_None) {
+        return false;
+      }
+      llvm::SmallVector<llvm::StringRef> cpu_features;
+      llvm::X86::getFeaturesForCPU(cpu, cpu_features);
+      for (llvm::StringRef feature : cpu_features) {
+        res[feature] = true;
+      }
+      break;
+    }
+    case llvm::Triple::aarch64: {
+      auto cpu_info = llvm::AArch64::parseCpu(cpu);
+      if (!cpu_info) {
+        return false;
+      }
+      std::vector<llvm::StringRef> cpu_features;
+      llvm::AArch64::getExtensionFeatures(cpu_info->getImpliedExtensions(),
+                                          cpu_features);
+      for (llvm::StringRef feature : cpu_features) {
+        if (feature.consume_front("+")) {
+          res[feature] = true;
+        }
+      }
+      break;
+    }
+    default: return false;
+    }
+  }
+
+  llvm::SmallVector<llvm::StringRef> feature_list;
+  llvm::StringRef(features).split(feature_list, ',', -1, /*KeepEmpty=*/false);
+  for (llvm::StringRef feature : feature_list) {
+    if (feature.consume_front("+")) {
+      res[feature] = true;
+    } else if (feature.consume_front("-")) {
+      res[feature] = false;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+std::unique_ptr<LLVMCompiler> LLVMCompiler::create(
+    const llvm::Triple &triple,
+    std::string_view cpu,
+    std::string_view features) noexcept {
+  llvm::StringMap<bool> feature_map;
+  if (!collect_features(triple, cpu, features, feature_map)) {
+    return nullptr;
+  }
+
+  std::unique_ptr<LLVMCompiler> compiler;
   switch (triple.getArch()) {
-  case llvm::Triple::x86_64: return x64::create_compiler(triple);
-  case llvm::Triple::aarch64: return arm64::create_compiler(triple);
+  case llvm::Triple::x86_64:
+    compiler = x64::create_compiler(triple, feature_map);
+    break;
+  case llvm::Triple::aarch64:
+    compiler = arm64::create_compiler(triple, feature_map);
+    break;
   default: return nullptr;
   }
+  if (compiler) {
+    // Resolved features in a stable order, "native" depends on the host.
+    std::vector<llvm::StringRef> enabled;
+    for (const auto &entry : feature_map) {
+      if (entry.getValue()) {
+        enabled.push_back(entry.getKey());
+      }
+    }
+    std::sort(enabled.begin(), enabled.end());
+
+    compiler->cache_target = triple.str();
+    for (llvm::StringRef feature : enabled) {
+      compiler->cache_target += ",+";
+      compiler->cache_target += feature;
+    }
+  }
+  return compiler;
 }
 
 } // namespace tpde_llvm
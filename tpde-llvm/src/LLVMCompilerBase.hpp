@@ -3,7 +3,9 @@
 // SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
 #pragma once
 
+#include <bit>
 #include <elf.h>
+#include <llvm/ADT/DenseMap.h>
 #include <llvm/ADT/SmallString.h>
 #include <llvm/ADT/SmallVector.h>
 #include <llvm/Analysis/ConstantFolding.h>
@@ -20,6 +22,7 @@
 #include <llvm/IR/Operator.h>
 #include <llvm/Support/AtomicOrdering.h>
 #include <llvm/Support/Casting.h>
+#include <llvm/Support/DivisionByConstantInfo.h>
 #include <llvm/Support/TimeProfiler.h>
 #include <llvm/Support/raw_ostream.h>
 
@@ -34,6 +37,7 @@
 #include "JITMapper.hpp"
 #include "LLVMAdaptor.hpp"
 #include "tpde-llvm/LLVMCompiler.hpp"
+#include "tpde-llvm/ObjectCache.hpp"
 
 namespace tpde_llvm {
 
@@ -169,6 +173,17 @@ struct LLVMCompilerBase : public LLVMCompiler,
 
   tpde::util::SmallVector<std::pair<IRValueRef, SymRef>, 16> type_info_syms;
 
+  /// Set during the initial compilation of compile_and_map_lazy; functions
+  /// are only defined as stubs and compiled on their first call.
+  JITMapperImpl *lazy_jit = nullptr;
+  /// Functions of the module of compile_and_map_lazy, indexed by function
+  /// index.
+  std::vector<IRFuncRef> lazy_funcs;
+  /// Set during compile_lazy_func to the mapping of compile_and_map_lazy;
+  /// other globals of the module are defined as absolute symbols at their
+  /// address in this mapping on first use.
+  JITMapperImpl *lazy_func_map = nullptr;
+
   enum class LibFunc {
     divti3,
     udivti3,
@@ -243,12 +258,21 @@ struct LLVMCompilerBase : public LLVMCompiler,
     return static_cast<Derived *>(this);
   }
 
-  // TODO(ts): check if it helps to check this
-  static bool cur_func_may_emit_calls() noexcept { return true; }
+  bool cur_func_may_emit_calls() const noexcept {
+    // Only computed precisely if it is used for omitting the frame pointer.
+    return !this->omit_leaf_frame_pointer ||
+           this->adaptor->cur_may_emit_calls();
+  }
+
+  SymRef cur_personality_func() noexcept;
 
-  SymRef cur_personality_func() const noexcept;
+  bool try_force_fixed_assignment(IRValueRef) const noexcept;
+
+  bool use_reg_snapshots() const noexcept {
+    return this->keep_regs_at_branches;
+  }
 
-  static bool try_force_fixed_assignment(IRValueRef) noexcept { return false; }
+  bool next_use_eviction() const noexcept { return this->evict_by_next_use; }
 
   void analysis_start() noexcept;
   void analysis_end() noexcept;
@@ -379,8 +403,16 @@ public:
 
   SymRef get_libfunc_sym(LibFunc func) noexcept;
 
-  SymRef global_sym(const llvm::GlobalValue *global) const noexcept {
+  /// Symbol for a global referenced by a function compiled by
+  /// compile_lazy_func. Globals are identified by their GlobalValue, not by
+  /// their name, as private and unnamed globals have no unique name.
+  SymRef lazy_global_sym(const llvm::GlobalValue *global) noexcept;
+
+  SymRef global_sym(const llvm::GlobalValue *global) noexcept {
     SymRef res = global_syms.lookup(global);
+    if (!res.valid() && lazy_func_map) {
+      res = lazy_global_sym(global);
+    }
     assert(res.valid());
     return res;
   }
@@ -388,7 +420,16 @@ public:
   void setup_var_ref_assignments() noexcept {}
 
   bool compile_func(IRFuncRef func, u32 idx) noexcept {
-    // Reuse/release memory for stored constants from previous function
+    if (lazy_jit) {
+      void *stub_addr = lazy_jit->lazy_stub_addr(idx);
+      this->assembler.sym_def_abs(this->func_syms[idx],
+                                  reinterpret_cast<uintptr_t>(stub_addr));
+      return true;
+    }
+
+    // Reuse/release memory for stored constants from previous function. This
+    // also covers the second attempt when CompilerX64 compiles a function
+    // again with frame pointer, the constants from the first one are dead.
     const_allocator.reset();
 
     SecRef sec = this->select_section(this->func_syms[idx], func, true);
@@ -409,56 +450,44 @@ public:
 
   bool compile(llvm::Module &mod) noexcept;
 
-  bool compile_unknown(const llvm::Instruction *,
-                       const ValInfo &,
-                       u64) noexcept {
+  /// Compile a single function of the module for which compile_and_map_lazy
+  /// was called into a new object. All other globals are undefined symbols.
+  std::pair<tpde::AssemblerElfBase *, SymRef>
+      compile_lazy_func(JITMapperImpl &map, u32 func_idx) noexcept;
+
+  bool compile_unknown(const llvm::Instruction *, u64) noexcept {
     return false;
   }
 
   bool compile_inst(const llvm::Instruction *, InstRange) noexcept;
 
-  bool compile_ret(const llvm::Instruction *, const ValInfo &, u64) noexcept;
+  bool compile_ret(const llvm::Instruction *, u64) noexcept;
   bool compile_load_generic(const llvm::LoadInst *,
                             GenericValuePart &&) noexcept;
-  bool compile_load(const llvm::Instruction *, const ValInfo &, u64) noexcept;
+  bool compile_load(const llvm::Instruction *, u64) noexcept;
   bool compile_store_generic(const llvm::StoreInst *,
                              GenericValuePart &&) noexcept;
-  bool compile_store(const llvm::Instruction *, const ValInfo &, u64) noexcept;
-  bool compile_int_binary_op(const llvm::Instruction *,
-                             const ValInfo &,
-                             u64) noexcept;
-  bool compile_float_binary_op(const llvm::Instruction *,
-                               const ValInfo &,
-                               u64) noexcept;
-  bool compile_fneg(const llvm::Instruction *, const ValInfo &, u64) noexcept;
-  bool compile_float_ext_trunc(const llvm::Instruction *,
-                               const ValInfo &,
-                               u64) noexcept;
-  bool compile_float_to_int(const llvm::Instruction *,
-                            const ValInfo &,
-                            u64) noexcept;
-  bool compile_int_to_float(const llvm::Instruction *,
-                            const ValInfo &,
-                            u64) noexcept;
-  bool compile_int_trunc(const llvm::Instruction *,
-                         const ValInfo &,
-                         u64) noexcept;
-  bool
-      compile_int_ext(const llvm::Instruction *, const ValInfo &, u64) noexcept;
-  bool compile_ptr_to_int(const llvm::Instruction *,
-                          const ValInfo &,
-                          u64) noexcept;
-  bool compile_int_to_ptr(const llvm::Instruction *,
-                          const ValInfo &,
-                          u64) noexcept;
-  bool
-      compile_bitcast(const llvm::Instruction *, const ValInfo &, u64) noexcept;
-  bool compile_extract_value(const llvm::Instruction *,
-                             const ValInfo &,
-                             u64) noexcept;
-  bool compile_insert_value(const llvm::Instruction *,
-                            const ValInfo &,
-                            u64) noexcept;
+  bool compile_store(const llvm::Instruction *, u64) noexcept;
+  bool compile_int_binary_op(const llvm::Instruction *, u64) noexcept;
+  /// Compile mul/div/rem of a 32/64-bit value by a constant using shifts and
+  /// multiply-high sequences. Returns false if the constant is not handled.
+  bool compile_int_binary_op_const(IntBinaryOp op,
+                                   unsigned width,
+                                   ValuePartRef &lhs,
+                                   u64 rhs,
+                                   ScratchReg &res) noexcept;
+  bool compile_float_binary_op(const llvm::Instruction *, u64) noexcept;
+  bool compile_fneg(const llvm::Instruction *, u64) noexcept;
+  bool compile_float_ext_trunc(const llvm::Instruction *, u64) noexcept;
+  bool compile_float_to_int(const llvm::Instruction *, u64) noexcept;
+  bool compile_int_to_float(const llvm::Instruction *, u64) noexcept;
+  bool compile_int_trunc(const llvm::Instruction *, u64) noexcept;
+  bool compile_int_ext(const llvm::Instruction *, u64) noexcept;
+  bool compile_ptr_to_int(const llvm::Instruction *, u64) noexcept;
+  bool compile_int_to_ptr(const llvm::Instruction *, u64) noexcept;
+  bool compile_bitcast(const llvm::Instruction *, u64) noexcept;
+  bool compile_extract_value(const llvm::Instruction *, u64) noexcept;
+  bool compile_insert_value(const llvm::Instruction *, u64) noexcept;
 
   void extract_element(IRValueRef vec,
                        unsigned idx,
@@ -468,35 +497,56 @@ public:
                       unsigned idx,
                       LLVMBasicValType ty,
                       GenericValuePart el) noexcept;
-  bool compile_extract_element(const llvm::Instruction *,
-                               const ValInfo &,
-                               u64) noexcept;
-  bool compile_insert_element(const llvm::Instruction *,
-                              const ValInfo &,
-                              u64) noexcept;
-  bool compile_shuffle_vector(const llvm::Instruction *,
-                              const ValInfo &,
-                              u64) noexcept;
-
-  bool
-      compile_cmpxchg(const llvm::Instruction *, const ValInfo &, u64) noexcept;
-  bool compile_atomicrmw(const llvm::Instruction *,
-                         const ValInfo &,
-                         u64) noexcept;
-  bool compile_fence(const llvm::Instruction *, const ValInfo &, u64) noexcept;
-  bool compile_freeze(const llvm::Instruction *, const ValInfo &, u64) noexcept;
-  bool compile_call(const llvm::Instruction *, const ValInfo &, u64) noexcept;
-  bool compile_select(const llvm::Instruction *, const ValInfo &, u64) noexcept;
-  bool compile_gep(const llvm::Instruction *, const ValInfo &, u64) noexcept;
-  bool compile_fcmp(const llvm::Instruction *, const ValInfo &, u64) noexcept;
-  bool compile_switch(const llvm::Instruction *, const ValInfo &, u64) noexcept;
-  bool compile_invoke(const llvm::Instruction *, const ValInfo &, u64) noexcept;
-  bool compile_landing_pad(const llvm::Instruction *,
-                           const ValInfo &,
-                           u64) noexcept;
-  bool compile_resume(const llvm::Instruction *, const ValInfo &, u64) noexcept;
+
+  // Operations on 256-bit vectors. These are only called if the adaptor lowers
+  // such vectors to v256, which targets must only enable if they provide an
+  // implementation. Return false if the operation is not supported.
+  bool load_v256(GenericValuePart &&, ScratchReg &) noexcept { return false; }
+  bool store_v256(GenericValuePart &&, GenericValuePart &&) noexcept {
+    return false;
+  }
+  bool int_binary_op_v256(IntBinaryOp,
+                          unsigned /*el_width*/,
+                          GenericValuePart &&,
+                          GenericValuePart &&,
+                          ScratchReg &) noexcept {
+    return false;
+  }
+  bool float_binary_op_v256(FloatBinaryOp,
+                            bool /*is_double*/,
+                            GenericValuePart &&,
+                            GenericValuePart &&,
+                            ScratchReg &) noexcept {
+    return false;
+  }
+  bool select_v256(GenericValuePart &&,
+                   GenericValuePart &&,
+                   GenericValuePart &&,
+                   ScratchReg &) noexcept {
+    return false;
+  }
+
+  bool compile_extract_element(const llvm::Instruction *, u64) noexcept;
+  bool compile_insert_element(const llvm::Instruction *, u64) noexcept;
+  bool compile_shuffle_vector(const llvm::Instruction *, u64) noexcept;
+
+  bool compile_cmpxchg(const llvm::Instruction *, u64) noexcept;
+  bool compile_atomicrmw(const llvm::Instruction *, u64) noexcept;
+  bool compile_fence(const llvm::Instruction *, u64) noexcept;
+  bool compile_freeze(const llvm::Instruction *, u64) noexcept;
+  bool compile_call(const llvm::Instruction *, u64) noexcept;
+  bool compile_select(const llvm::Instruction *, u64) noexcept;
+  bool compile_gep(const llvm::Instruction *, u64) noexcept;
+  bool compile_fcmp(const llvm::Instruction *, u64) noexcept;
+  bool compile_switch(const llvm::Instruction *, u64) noexcept;
+  bool compile_invoke(const llvm::Instruction *, u64) noexcept;
+  bool compile_landing_pad(const llvm::Instruction *, u64) noexcept;
+  bool compile_resume(const llvm::Instruction *, u64) noexcept;
   SymRef lookup_type_info_sym(IRValueRef value) noexcept;
-  bool compile_intrin(const llvm::IntrinsicInst *, const ValInfo &) noexcept;
+  bool compile_intrin(const llvm::IntrinsicInst *) noexcept;
+  /// Expand memcpy/memmove/memset with a small constant length inline.
+  /// Returns false if the library function must be called instead.
+  bool compile_mem_intrin_inline(const llvm::MemIntrinsic *) noexcept;
   bool compile_is_fpclass(const llvm::IntrinsicInst *) noexcept;
   bool compile_overflow_intrin(const llvm::IntrinsicInst *,
                                OverflowOp) noexcept;
@@ -509,7 +559,7 @@ public:
 
   bool compile_alloca(const llvm::AllocaInst *) noexcept { return false; }
 
-  bool compile_br(const llvm::Instruction *, const ValInfo &, u64) noexcept {
+  bool compile_br(const llvm::Instruction *, u64) noexcept {
     return false;
   }
 
@@ -521,26 +571,34 @@ public:
 
   bool handle_intrin(const llvm::IntrinsicInst *) noexcept { return false; }
 
+  /// Whether floor/ceil/trunc/rint/round can be encoded inline. Otherwise, they
+  /// are lowered to libm calls.
+  bool has_native_fp_rounding() const noexcept { return true; }
+
   bool compile_to_elf(llvm::Module &mod,
                       std::vector<uint8_t> &buf) noexcept override;
 
   JITMapper compile_and_map(
       llvm::Module &mod,
       std::function<void *(std::string_view)> resolver) noexcept override;
+
+  JITMapper compile_and_map_lazy(
+      llvm::Module &mod,
+      std::function<void *(std::string_view)> resolver,
+      void *error_handler) noexcept override;
 };
 
 template <typename Adaptor, typename Derived, typename Config>
 typename LLVMCompilerBase<Adaptor, Derived, Config>::SymRef
     LLVMCompilerBase<Adaptor, Derived, Config>::cur_personality_func()
-        const noexcept {
+        noexcept {
   if (!this->adaptor->cur_func->hasPersonalityFn()) {
     return SymRef();
   }
 
   llvm::Constant *p = this->adaptor->cur_func->getPersonalityFn();
   if (auto *gv = llvm::dyn_cast<llvm::GlobalValue>(p)) [[likely]] {
-    assert(global_syms.contains(gv));
-    return global_syms.lookup(gv);
+    return global_sym(gv);
   }
 
   TPDE_LOG_ERR("non-GlobalValue personality function unsupported");
@@ -548,6 +606,44 @@ typename LLVMCompilerBase<Adaptor, Derived, Config>::SymRef
   return SymRef();
 }
 
+template <typename Adaptor, typename Derived, typename Config>
+bool LLVMCompilerBase<Adaptor, Derived, Config>::try_force_fixed_assignment(
+    IRValueRef value) const noexcept {
+  // Keep loop-carried values of innermost loops in registers: the PHI nodes of
+  // the loop header and the values they get from inside the loop (e.g., the
+  // incremented counter). Otherwise, each iteration stores them to their stack
+  // slot at the back-edge and reloads them afterwards.
+  if (!this->loop_fixed_regs) {
+    return false;
+  }
+  const auto local_idx = this->adaptor->val_local_idx(value);
+  const u32 lcl = this->analyzer.liveness_lowest_common_loop(local_idx);
+  // Like the generic heuristic, only consider values that are live after the
+  // current block. Loop 0 is the function itself.
+  if (this->analyzer.liveness_range(local_idx).last <= this->cur_block_idx ||
+      lcl == 0) {
+    return false;
+  }
+  const auto &loop = this->analyzer.loop_from_idx(lcl);
+  if (loop.definitions_in_childs != 0) {
+    return false;
+  }
+
+  const auto is_header_phi = [&](const llvm::Value *val) {
+    const auto *phi = llvm::dyn_cast<llvm::PHINode>(val);
+    if (!phi) {
+      return false;
+    }
+    const auto block = this->adaptor->block_lookup_idx(phi->getParent());
+    return this->analyzer.block_idx(block) == loop.begin;
+  };
+  if (is_header_phi(value)) {
+    return true;
+  }
+  return llvm::isa<llvm::Instruction>(value) &&
+         llvm::any_of(value->users(), is_header_phi);
+}
+
 template <typename Adaptor, typename Derived, typename Config>
 void LLVMCompilerBase<Adaptor, Derived, Config>::analysis_start() noexcept {
   if (llvm::timeTraceProfilerEnabled()) {
@@ -1330,103 +1426,153 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile(
   return true;
 }
 
+template <typename Adaptor, typename Derived, typename Config>
+typename LLVMCompilerBase<Adaptor, Derived, Config>::SymRef
+    LLVMCompilerBase<Adaptor, Derived, Config>::lazy_global_sym(
+        const llvm::GlobalValue *global) noexcept {
+  SymRef res;
+  if (void *addr = lazy_func_map->lookup_global(global)) {
+    // Defined or already resolved by the mapping of the module.
+    res = this->assembler.sym_add_undef("", Assembler::SymBinding::LOCAL);
+    this->assembler.sym_def_abs(res, reinterpret_cast<uintptr_t>(addr));
+  } else {
+    // Declaration that was not referenced by the module, resolved by name.
+    assert(global->isDeclaration() && global->hasName());
+    res = this->assembler.sym_add_undef(global->getName(),
+                                        Assembler::SymBinding::GLOBAL);
+  }
+  global_syms[global] = res;
+  return res;
+}
+
+template <typename Adaptor, typename Derived, typename Config>
+std::pair<tpde::AssemblerElfBase *,
+          typename LLVMCompilerBase<Adaptor, Derived, Config>::SymRef>
+    LLVMCompilerBase<Adaptor, Derived, Config>::compile_lazy_func(
+        JITMapperImpl &map, u32 func_idx) noexcept {
+  // The adaptor still holds the module and its global value numbering from the
+  // initial compilation, only the output of the previous compilation is reset.
+  derived()->reset_keep_adaptor();
+
+  type_info_syms.clear();
+  global_syms.clear();
+  group_secs.clear();
+  libfunc_syms.fill({});
+
+  this->text_writer.switch_section(
+      this->assembler.get_section(this->assembler.get_text_section()));
+
+  assert(func_idx < lazy_funcs.size() && "invalid function index");
+  IRFuncRef lazy_func = lazy_funcs[func_idx];
+  this->func_syms.resize(lazy_funcs.size());
+  this->func_syms[func_idx] = this->assembler.sym_predef_func(
+      this->adaptor->func_link_name(lazy_func), Assembler::SymBinding::GLOBAL);
+  define_func_idx(lazy_func, func_idx);
+
+  lazy_func_map = &map;
+  bool success = derived()->compile_func(lazy_func, func_idx);
+  lazy_func_map = nullptr;
+  if (!success) {
+    TPDE_LOG_ERR("Failed to compile function {}",
+                 this->adaptor->func_link_name(lazy_func));
+    return {nullptr, SymRef()};
+  }
+
+  this->text_writer.flush();
+  this->assembler.finalize();
+  return {&this->assembler, this->func_syms[func_idx]};
+}
+
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_inst(
     const llvm::Instruction *i, InstRange) noexcept {
   TPDE_LOG_TRACE("Compiling inst {}", this->adaptor->inst_fmt_ref(i));
-  static constexpr auto fns = []() constexpr {
-    // TODO: maybe don't use member-function pointers here, these are twice the
-    // size of regular function pointers (hence an entry size is 0x18).
-    using CompileFn = bool (Derived::*)(
-        const llvm::Instruction *, const ValInfo &, u64) noexcept;
-    std::array<std::pair<CompileFn, u64>, llvm::Instruction::OtherOpsEnd> res{};
-    res.fill({&Derived::compile_unknown, 0});
-
+  // A plain switch compiles to a compact jump table and lets the compiler
+  // call the handlers directly with the opcode-specific argument, unlike a
+  // table of member function pointers (0x18 bytes per entry including the
+  // argument). Handlers look up the ValInfo themselves when they need it.
+  // The most frequent instructions come first.
+  switch (i->getOpcode()) {
     // clang-format off
-
-    // Terminators
-    res[llvm::Instruction::Ret] = {&Derived::compile_ret, 0};
-    res[llvm::Instruction::Br] = {&Derived::compile_br, 0};
-    res[llvm::Instruction::Switch] = {&Derived::compile_switch, 0};
-    // TODO: IndirectBr
-    res[llvm::Instruction::Invoke] = {&Derived::compile_invoke, 0};
-    res[llvm::Instruction::Resume] = {&Derived::compile_resume, 0};
-    res[llvm::Instruction::Unreachable] = {&Derived::compile_unreachable, 0};
-
-    // Standard unary operators
-    res[llvm::Instruction::FNeg] = {&Derived::compile_fneg, 0};
-
-    // Standard binary operators
-    res[llvm::Instruction::Add] = {&Derived::compile_int_binary_op, IntBinaryOp::add};
-    res[llvm::Instruction::FAdd] = {&Derived::compile_float_binary_op, FloatBinaryOp::add};
-    res[llvm::Instruction::Sub] = {&Derived::compile_int_binary_op, IntBinaryOp::sub};
-    res[llvm::Instruction::FSub] = {&Derived::compile_float_binary_op, FloatBinaryOp::sub};
-    res[llvm::Instruction::Mul] = {&Derived::compile_int_binary_op, IntBinaryOp::mul};
-    res[llvm::Instruction::FMul] = {&Derived::compile_float_binary_op, FloatBinaryOp::mul};
-    res[llvm::Instruction::UDiv] = {&Derived::compile_int_binary_op, IntBinaryOp::udiv};
-    res[llvm::Instruction::SDiv] = {&Derived::compile_int_binary_op, IntBinaryOp::sdiv};
-    res[llvm::Instruction::FDiv] = {&Derived::compile_float_binary_op, FloatBinaryOp::div};
-    res[llvm::Instruction::URem] = {&Derived::compile_int_binary_op, IntBinaryOp::urem};
-    res[llvm::Instruction::SRem] = {&Derived::compile_int_binary_op, IntBinaryOp::srem};
-    res[llvm::Instruction::FRem] = {&Derived::compile_float_binary_op, FloatBinaryOp::rem};
-    res[llvm::Instruction::Shl] = {&Derived::compile_int_binary_op, IntBinaryOp::shl};
-    res[llvm::Instruction::LShr] = {&Derived::compile_int_binary_op, IntBinaryOp::shr};
-    res[llvm::Instruction::AShr] = {&Derived::compile_int_binary_op, IntBinaryOp::ashr};
-    res[llvm::Instruction::And] = {&Derived::compile_int_binary_op, IntBinaryOp::land};
-    res[llvm::Instruction::Or] = {&Derived::compile_int_binary_op, IntBinaryOp::lor};
-    res[llvm::Instruction::Xor] = {&Derived::compile_int_binary_op, IntBinaryOp::lxor};
-
-    // Memory operators
-    res[llvm::Instruction::Alloca] = {&Derived::compile_alloca, 0};
-    res[llvm::Instruction::Load] = {&Derived::compile_load, 0};
-    res[llvm::Instruction::Store] = {&Derived::compile_store, 0};
-    res[llvm::Instruction::GetElementPtr] = {&Derived::compile_gep, 0};
-    res[llvm::Instruction::Fence] = {&Derived::compile_fence, 0};
-    res[llvm::Instruction::AtomicCmpXchg] = {&Derived::compile_cmpxchg, 0};
-    res[llvm::Instruction::AtomicRMW] = {&Derived::compile_atomicrmw, 0};
-
-    // Cast operators
-    res[llvm::Instruction::Trunc] = {&Derived::compile_int_trunc, 0};
-    res[llvm::Instruction::ZExt] = {&Derived::compile_int_ext, /*sign=*/false};
-    res[llvm::Instruction::SExt] = {&Derived::compile_int_ext, /*sign=*/true};
-    res[llvm::Instruction::FPToUI] = {&Derived::compile_float_to_int, /*flags=!sign,!sat*/0};
-    res[llvm::Instruction::FPToSI] = {&Derived::compile_float_to_int, /*flags=sign,!sat*/1};
-    res[llvm::Instruction::UIToFP] = {&Derived::compile_int_to_float, /*sign=*/false};
-    res[llvm::Instruction::SIToFP] = {&Derived::compile_int_to_float, /*sign=*/true};
-    res[llvm::Instruction::FPTrunc] = {&Derived::compile_float_ext_trunc, 0};
-    res[llvm::Instruction::FPExt] = {&Derived::compile_float_ext_trunc, 0};
-    res[llvm::Instruction::PtrToInt] = {&Derived::compile_ptr_to_int, 0};
-    res[llvm::Instruction::IntToPtr] = {&Derived::compile_int_to_ptr, 0};
-    res[llvm::Instruction::BitCast] = {&Derived::compile_bitcast, 0};
-    // TODO: AddrSpaceCast
-
-    // Other operators
-    res[llvm::Instruction::ICmp] = {&Derived::compile_icmp, 0};
-    res[llvm::Instruction::FCmp] = {&Derived::compile_fcmp, 0};
-    // PHI will not be called
-    res[llvm::Instruction::Call] = {&Derived::compile_call, 0};
-    res[llvm::Instruction::Select] = {&Derived::compile_select, 0};
-    res[llvm::Instruction::ExtractElement] = {&Derived::compile_extract_element, 0};
-    res[llvm::Instruction::InsertElement] = {&Derived::compile_insert_element, 0};
-    res[llvm::Instruction::ShuffleVector] = {&Derived::compile_shuffle_vector, 0};
-    res[llvm::Instruction::ExtractValue] = {&Derived::compile_extract_value, 0};
-    res[llvm::Instruction::InsertValue] = {&Derived::compile_insert_value, 0};
-    res[llvm::Instruction::LandingPad] = {&Derived::compile_landing_pad, 0};
-    res[llvm::Instruction::Freeze] = {&Derived::compile_freeze, 0};
+  case llvm::Instruction::Load: return derived()->compile_load(i, 0);
+  case llvm::Instruction::Store: return derived()->compile_store(i, 0);
+  case llvm::Instruction::GetElementPtr: return derived()->compile_gep(i, 0);
+  case llvm::Instruction::ICmp: return derived()->compile_icmp(i, 0);
+  case llvm::Instruction::Br: return derived()->compile_br(i, 0);
+  case llvm::Instruction::Call: return derived()->compile_call(i, 0);
+  case llvm::Instruction::Add: return derived()->compile_int_binary_op(i, IntBinaryOp::add);
+
+  // Terminators
+  case llvm::Instruction::Ret: return derived()->compile_ret(i, 0);
+  case llvm::Instruction::Switch: return derived()->compile_switch(i, 0);
+  // TODO: IndirectBr
+  case llvm::Instruction::Invoke: return derived()->compile_invoke(i, 0);
+  case llvm::Instruction::Resume: return derived()->compile_resume(i, 0);
+  case llvm::Instruction::Unreachable: return derived()->compile_unreachable(i, 0);
+
+  // Standard unary operators
+  case llvm::Instruction::FNeg: return derived()->compile_fneg(i, 0);
+
+  // Standard binary operators
+  case llvm::Instruction::FAdd: return derived()->compile_float_binary_op(i, FloatBinaryOp::add);
+  case llvm::Instruction::Sub: return derived()->compile_int_binary_op(i, IntBinaryOp::sub);
+  case llvm::Instruction::FSub: return derived()->compile_float_binary_op(i, FloatBinaryOp::sub);
+  case llvm::Instruction::Mul: return derived()->compile_int_binary_op(i, IntBinaryOp::mul);
+  case llvm::Instruction::FMul: return derived()->compile_float_binary_op(i, FloatBinaryOp::mul);
+  case llvm::Instruction::UDiv: return derived()->compile_int_binary_op(i, IntBinaryOp::udiv);
+  case llvm::Instruction::SDiv: return derived()->compile_int_binary_op(i, IntBinaryOp::sdiv);
+  case llvm::Instruction::FDiv: return derived()->compile_float_binary_op(i, FloatBinaryOp::div);
+  case llvm::Instruction::URem: return derived()->compile_int_binary_op(i, IntBinaryOp::urem);
+  case llvm::Instruction::SRem: return derived()->compile_int_binary_op(i, IntBinaryOp::srem);
+  case llvm::Instruction::FRem: return derived()->compile_float_binary_op(i, FloatBinaryOp::rem);
+  case llvm::Instruction::Shl: return derived()->compile_int_binary_op(i, IntBinaryOp::shl);
+  case llvm::Instruction::LShr: return derived()->compile_int_binary_op(i, IntBinaryOp::shr);
+  case llvm::Instruction::AShr: return derived()->compile_int_binary_op(i, IntBinaryOp::ashr);
+  case llvm::Instruction::And: return derived()->compile_int_binary_op(i, IntBinaryOp::land);
+  case llvm::Instruction::Or: return derived()->compile_int_binary_op(i, IntBinaryOp::lor);
+  case llvm::Instruction::Xor: return derived()->compile_int_binary_op(i, IntBinaryOp::lxor);
+
+  // Memory operators
+  case llvm::Instruction::Alloca: return derived()->compile_alloca(i, 0);
+  case llvm::Instruction::Fence: return derived()->compile_fence(i, 0);
+  case llvm::Instruction::AtomicCmpXchg: return derived()->compile_cmpxchg(i, 0);
+  case llvm::Instruction::AtomicRMW: return derived()->compile_atomicrmw(i, 0);
+
+  // Cast operators
+  case llvm::Instruction::Trunc: return derived()->compile_int_trunc(i, 0);
+  case llvm::Instruction::ZExt: return derived()->compile_int_ext(i, /*sign=*/false);
+  case llvm::Instruction::SExt: return derived()->compile_int_ext(i, /*sign=*/true);
+  case llvm::Instruction::FPToUI: return derived()->compile_float_to_int(i, /*flags=!sign,!sat*/0);
+  case llvm::Instruction::FPToSI: return derived()->compile_float_to_int(i, /*flags=sign,!sat*/1);
+  case llvm::Instruction::UIToFP: return derived()->compile_int_to_float(i, /*sign=*/false);
+  case llvm::Instruction::SIToFP: return derived()->compile_int_to_float(i, /*sign=*/true);
+  case llvm::Instruction::FPTrunc: return derived()->compile_float_ext_trunc(i, 0);
+  case llvm::Instruction::FPExt: return derived()->compile_float_ext_trunc(i, 0);
+  case llvm::Instruction::PtrToInt: return derived()->compile_ptr_to_int(i, 0);
+  case llvm::Instruction::IntToPtr: return derived()->compile_int_to_ptr(i, 0);
+  case llvm::Instruction::BitCast: return derived()->compile_bitcast(i, 0);
+  // TODO: AddrSpaceCast
+
+  // Other operators
+  case llvm::Instruction::FCmp: return derived()->compile_fcmp(i, 0);
+  // PHI will not be called
+  case llvm::Instruction::Select: return derived()->compile_select(i, 0);
+  case llvm::Instruction::ExtractElement: return derived()->compile_extract_element(i, 0);
+  case llvm::Instruction::InsertElement: return derived()->compile_insert_element(i, 0);
+  case llvm::Instruction::ShuffleVector: return derived()->compile_shuffle_vector(i, 0);
+  case llvm::Instruction::ExtractValue: return derived()->compile_extract_value(i, 0);
+  case llvm::Instruction::InsertValue: return derived()->compile_insert_value(i, 0);
+  case llvm::Instruction::LandingPad: return derived()->compile_landing_pad(i, 0);
+  case llvm::Instruction::Freeze: return derived()->compile_freeze(i, 0);
 
     // clang-format on
-    return res;
-  }();
-
-  const ValInfo &val_info = this->adaptor->val_info(i);
-  assert(i->getOpcode() < fns.size());
-  const auto [compile_fn, arg] = fns[i->getOpcode()];
-  return (derived()->*compile_fn)(i, val_info, arg);
+  default: return derived()->compile_unknown(i, 0);
+  }
 }
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_ret(
-    const llvm::Instruction *inst, const ValInfo &, u64) noexcept {
+    const llvm::Instruction *inst, u64) noexcept {
   typename Derived::RetBuilder rb{*derived(), *derived()->cur_cc_assigner()};
   if (inst->getNumOperands() != 0) {
     llvm::Value *retval = inst->getOperand(0);
@@ -1582,6 +1728,11 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_load_generic(
   }
   case v128:
   case f128: derived()->encode_loadv128(std::move(ptr_op), res_scratch); break;
+  case v256:
+    if (!derived()->load_v256(std::move(ptr_op), res_scratch)) {
+      return false;
+    }
+    break;
   case complex: {
     auto ty_idx = this->adaptor->val_info(load).complex_part_tys_idx;
     const LLVMComplexPart *part_descs =
@@ -1627,6 +1778,11 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_load_generic(
       case f128:
         derived()->encode_loadv128(std::move(part_addr), res_scratch);
         break;
+      case v256:
+        if (!derived()->load_v256(std::move(part_addr), res_scratch)) {
+          return false;
+        }
+        break;
       default: assert(0); return false;
       }
 
@@ -1647,7 +1803,7 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_load_generic(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_load(
-    const llvm::Instruction *inst, const ValInfo &, u64) noexcept {
+    const llvm::Instruction *inst, u64) noexcept {
   const auto *load = llvm::cast<llvm::LoadInst>(inst);
   auto [_, ptr_ref] = this->val_ref_single(load->getPointerOperand());
   if (ptr_ref.has_assignment() && ptr_ref.assignment().is_stack_variable()) {
@@ -1780,6 +1936,11 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_store_generic(
   case f128:
     derived()->encode_storev128(std::move(ptr_op), op_ref.part(0));
     break;
+  case v256:
+    if (!derived()->store_v256(std::move(ptr_op), op_ref.part(0))) {
+      return false;
+    }
+    break;
   case complex: {
     const LLVMComplexPart *part_descs =
         &this->adaptor->complex_part_types[ty_idx + 1];
@@ -1829,6 +1990,11 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_store_generic(
       case f128:
         derived()->encode_storev128(std::move(part_addr), std::move(part_ref));
         break;
+      case v256:
+        if (!derived()->store_v256(std::move(part_addr), std::move(part_ref))) {
+          return false;
+        }
+        break;
       default: assert(0); return false;
       }
 
@@ -1844,7 +2010,7 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_store_generic(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_store(
-    const llvm::Instruction *inst, const ValInfo &, u64) noexcept {
+    const llvm::Instruction *inst, u64) noexcept {
   const auto *store = llvm::cast<llvm::StoreInst>(inst);
   auto [_, ptr_ref] = this->val_ref_single(store->getPointerOperand());
   if (ptr_ref.has_assignment() && ptr_ref.assignment().is_stack_variable()) {
@@ -1858,7 +2024,7 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_store(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_int_binary_op(
-    const llvm::Instruction *inst, const ValInfo &info, u64 op_val) noexcept {
+    const llvm::Instruction *inst, u64 op_val) noexcept {
   auto *inst_ty = inst->getType();
   IntBinaryOp op = typename IntBinaryOp::Value(op_val);
 
@@ -1907,23 +2073,32 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_int_binary_op(
     }
 
     unsigned ty_idx;
-    switch (info.type) {
+    switch (this->adaptor->val_info(inst).type) {
       using enum LLVMBasicValType;
     case v64: ty_idx = 0; break;
     case v128: ty_idx = 1; break;
+    case v256: ty_idx = 2; break;
     default: return false;
     }
 
-    EncodeFnTy encode_fn = fns[op.index()][ty_idx][width_idx];
-    if (!encode_fn) {
-      return false;
+    EncodeFnTy encode_fn = nullptr;
+    if (ty_idx < 2) {
+      encode_fn = fns[op.index()][ty_idx][width_idx];
+      if (!encode_fn) {
+        return false;
+      }
     }
 
     auto lhs = this->val_ref(inst->getOperand(0));
     auto rhs = this->val_ref(inst->getOperand(1));
     auto [res_vr, res_ref] = this->result_ref_single(inst);
     ScratchReg res{this};
-    if (!(derived()->*encode_fn)(lhs.part(0), rhs.part(0), res)) {
+    if (!encode_fn) {
+      if (!derived()->int_binary_op_v256(
+              op, int_width, lhs.part(0), rhs.part(0), res)) {
+        return false;
+      }
+    } else if (!(derived()->*encode_fn)(lhs.part(0), rhs.part(0), res)) {
       return false;
     }
     this->set_value(res_ref, res);
@@ -2112,8 +2287,6 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_int_binary_op(
     std::swap(lhs_op, rhs_op);
   }
 
-  // TODO(ts): optimize div/rem by constant to a shift?
-
   unsigned ext_width = tpde::util::align_up(int_width, 32);
   if (ext_width != int_width) {
     bool sext = op.is_signed();
@@ -2129,17 +2302,222 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_int_binary_op(
 
   auto res_scratch = ScratchReg{derived()};
 
-  (derived()->*(encode_ptrs[op.index()][ext_width / 32 - 1]))(
-      std::move(lhs_op), std::move(rhs_op), res_scratch);
+  bool const_done = false;
+  if (this->const_strength_reduction && rhs_op.is_const() &&
+      !lhs_op.is_const() &&
+      (op == IntBinaryOp::mul || op.is_div() || op.is_rem())) {
+    u64 rhs_val = rhs_op.const_data()[0];
+    if (op == IntBinaryOp::mul && int_width < 64) {
+      // mul doesn't extend its operands, ignore bits beyond the type.
+      rhs_val = tpde::util::zext(rhs_val, int_width);
+    }
+    const_done = derived()->compile_int_binary_op_const(
+        op, ext_width, lhs_op, rhs_val, res_scratch);
+  }
+
+  if (!const_done) {
+    (derived()->*(encode_ptrs[op.index()][ext_width / 32 - 1]))(
+        std::move(lhs_op), std::move(rhs_op), res_scratch);
+  }
 
   this->set_value(res, res_scratch);
 
   return true;
 }
 
+template <typename Adaptor, typename Derived, typename Config>
+bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_int_binary_op_const(
+    IntBinaryOp op,
+    unsigned width,
+    ValuePartRef &lhs,
+    u64 rhs,
+    ScratchReg &res) noexcept {
+  assert(width == 32 || width == 64);
+  using EncodeFnTy =
+      bool (Derived::*)(GenericValuePart &&, GenericValuePart &&, ScratchReg &);
+  using EncodeUnaryFnTy = bool (Derived::*)(GenericValuePart &&, ScratchReg &);
+  using BinFns = std::array<EncodeFnTy, 2>;
+  static constexpr BinFns add{&Derived::encode_addi32, &Derived::encode_addi64};
+  static constexpr BinFns sub{&Derived::encode_subi32, &Derived::encode_subi64};
+  static constexpr BinFns mul{&Derived::encode_muli32, &Derived::encode_muli64};
+  static constexpr BinFns land{&Derived::encode_landi32,
+                               &Derived::encode_landi64};
+  static constexpr BinFns shl{&Derived::encode_shli32, &Derived::encode_shli64};
+  static constexpr BinFns shr{&Derived::encode_shri32, &Derived::encode_shri64};
+  static constexpr BinFns ashr{&Derived::encode_ashri32,
+                               &Derived::encode_ashri64};
+  static constexpr BinFns umulh{&Derived::encode_umulhi32,
+                                &Derived::encode_umulhi64};
+  static constexpr BinFns smulh{&Derived::encode_smulhi32,
+                                &Derived::encode_smulhi64};
+  static constexpr BinFns udivnpq{&Derived::encode_udivnpqi32,
+                                  &Derived::encode_udivnpqi64};
+
+  const unsigned is64 = width == 64;
+  const u64 mask = is64 ? ~u64{0} : (u64{1} << width) - 1;
+  rhs &= mask;
+  const i64 srhs = is64 ? i64(rhs) : tpde::util::sext(rhs, width);
+
+  auto encode = [&](const BinFns &fns,
+                    GenericValuePart &&a,
+                    GenericValuePart &&b,
+                    ScratchReg &dst) {
+    (derived()->*fns[is64])(std::move(a), std::move(b), dst);
+  };
+  auto imm = [&](u64 val) {
+    return ValuePartRef(this, val & mask, width / 8, Config::GP_BANK);
+  };
+  // The dividend is used multiple times, so keep it in a register and only
+  // pass unowned references to the encoders.
+  auto lhs_reg = [&]() { return lhs.get_unowned_ref(); };
+  auto load_lhs = [&]() {
+    if (!lhs.has_reg()) {
+      lhs.load_to_reg();
+    }
+  };
+
+  // Compute the quotient for udiv/urem with a non-power-of-two divisor.
+  auto udiv_magic = [&](ScratchReg &dst) {
+    auto magics = llvm::UnsignedDivisionByConstantInfo::get(
+        llvm::APInt(width, rhs));
+    u64 magic = magics.Magic.getZExtValue();
+    if (magics.PreShift) {
+      encode(shr, lhs_reg(), imm(magics.PreShift), dst);
+      encode(umulh, std::move(dst), imm(magic), dst);
+    } else {
+      encode(umulh, lhs_reg(), imm(magic), dst);
+    }
+    if (magics.IsAdd) {
+      encode(udivnpq, lhs_reg(), std::move(dst), dst);
+    }
+    if (magics.PostShift) {
+      encode(shr, std::move(dst), imm(magics.PostShift), dst);
+    }
+  };
+
+  // Compute the quotient for sdiv/srem with a divisor other than 2^k.
+  auto sdiv_magic = [&](ScratchReg &dst) {
+    auto magics = llvm::SignedDivisionByConstantInfo::get(
+        llvm::APInt(width, rhs));
+    encode(smulh, lhs_reg(), imm(magics.Magic.getZExtValue()), dst);
+    if (srhs > 0 && magics.Magic.isNegative()) {
+      encode(add, std::move(dst), lhs_reg(), dst);
+    } else if (srhs < 0 && magics.Magic.isStrictlyPositive()) {
+      encode(sub, std::move(dst), lhs_reg(), dst);
+    }
+    if (magics.ShiftAmount) {
+      encode(ashr, std::move(dst), imm(magics.ShiftAmount), dst);
+    }
+    static constexpr std::array<EncodeUnaryFnTy, 2> fixup{
+        &Derived::encode_sdivfixupi32, &Derived::encode_sdivfixupi64};
+    (derived()->*fixup[is64])(std::move(dst), dst);
+  };
+
+  // Add 2^k-1 to negative dividends so that the shift rounds towards zero.
+  auto sdiv_pow2_bias = [&](unsigned shift, ScratchReg &dst) {
+    if (shift == 1) {
+      encode(shr, lhs_reg(), imm(width - 1), dst);
+    } else {
+      encode(ashr, lhs_reg(), imm(width - 1), dst);
+      encode(shr, std::move(dst), imm(width - shift), dst);
+    }
+    encode(add, lhs_reg(), std::move(dst), dst);
+  };
+
+  // x % d = x - (x / d) * d
+  auto rem_from_quotient = [&](ScratchReg &quot) {
+    encode(mul, std::move(quot), imm(rhs), quot);
+    encode(sub, lhs_reg(), std::move(quot), res);
+  };
+
+  const bool pow2 = std::has_single_bit(rhs);
+  const unsigned k = std::countr_zero(rhs);
+
+  switch (op.op) {
+  case IntBinaryOp::mul: {
+    using EncodeMulFns = std::array<EncodeUnaryFnTy, 2>;
+    static constexpr EncodeMulFns mul3{&Derived::encode_mul3i32,
+                                       &Derived::encode_mul3i64};
+    static constexpr EncodeMulFns mul5{&Derived::encode_mul5i32,
+                                       &Derived::encode_mul5i64};
+    static constexpr EncodeMulFns mul9{&Derived::encode_mul9i32,
+                                       &Derived::encode_mul9i64};
+    const EncodeMulFns *fns = nullptr;
+    switch (rhs) {
+    case 3: fns = &mul3; break;
+    case 5: fns = &mul5; break;
+    case 9: fns = &mul9; break;
+    default: break;
+    }
+    if (fns) {
+      (derived()->*(*fns)[is64])(std::move(lhs), res);
+      return true;
+    }
+    if (!pow2 || k == 0) {
+      return false;
+    }
+    encode(shl, std::move(lhs), imm(k), res);
+    return true;
+  }
+  case IntBinaryOp::udiv:
+    if (rhs <= 1) {
+      return false;
+    }
+    if (pow2) {
+      encode(shr, std::move(lhs), imm(k), res);
+      return true;
+    }
+    load_lhs();
+    udiv_magic(res);
+    return true;
+  case IntBinaryOp::urem: {
+    if (rhs <= 1) {
+      return false;
+    }
+    if (pow2) {
+      encode(land, std::move(lhs), imm(rhs - 1), res);
+      return true;
+    }
+    load_lhs();
+    ScratchReg quot{derived()};
+    udiv_magic(quot);
+    rem_from_quotient(quot);
+    return true;
+  }
+  case IntBinaryOp::sdiv:
+  case IntBinaryOp::srem: {
+    // Division by +-1 and INT_MIN is rare enough to not bother.
+    if (srhs == 0 || srhs == 1 || srhs == -1 || (pow2 && k == width - 1)) {
+      return false;
+    }
+    load_lhs();
+    ScratchReg quot{derived()};
+    if (srhs > 0 && pow2) {
+      sdiv_pow2_bias(k, quot);
+      if (op == IntBinaryOp::sdiv) {
+        encode(ashr, std::move(quot), imm(k), res);
+      } else {
+        encode(land, std::move(quot), imm(-rhs), quot);
+        encode(sub, lhs_reg(), std::move(quot), res);
+      }
+      return true;
+    }
+    if (op == IntBinaryOp::sdiv) {
+      sdiv_magic(res);
+    } else {
+      sdiv_magic(quot);
+      rem_from_quotient(quot);
+    }
+    return true;
+  }
+  default: return false;
+  }
+}
+
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_float_binary_op(
-    const llvm::Instruction *inst, const ValInfo &val_info, u64 op) noexcept {
+    const llvm::Instruction *inst, u64 op) noexcept {
+  const ValInfo &val_info = this->adaptor->val_info(inst);
   auto *inst_ty = inst->getType();
   auto *scalar_ty = inst_ty->getScalarType();
 
@@ -2239,12 +2617,18 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_float_binary_op(
       }
     }
     break;
+  case v256: break;
   default: TPDE_UNREACHABLE("invalid basic type for float binary op");
   }
 
   auto [res_vr, res] = this->result_ref_single(inst);
   ScratchReg res_scratch{derived()};
-  if (!(derived()->*encode_fn)(lhs.part(0), rhs.part(0), res_scratch)) {
+  if (!encode_fn) {
+    if (!derived()->float_binary_op_v256(
+            op, is_double, lhs.part(0), rhs.part(0), res_scratch)) {
+      return false;
+    }
+  } else if (!(derived()->*encode_fn)(lhs.part(0), rhs.part(0), res_scratch)) {
     return false;
   }
   this->set_value(res, res_scratch);
@@ -2253,7 +2637,8 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_float_binary_op(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_fneg(
-    const llvm::Instruction *inst, const ValInfo &val_info, u64) noexcept {
+    const llvm::Instruction *inst, u64) noexcept {
+  const ValInfo &val_info = this->adaptor->val_info(inst);
   auto *scalar_ty = inst->getType()->getScalarType();
 
   auto src = this->val_ref(inst->getOperand(0));
@@ -2285,7 +2670,7 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_fneg(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_float_ext_trunc(
-    const llvm::Instruction *inst, const ValInfo &, u64) noexcept {
+    const llvm::Instruction *inst, u64) noexcept {
   auto *src_val = inst->getOperand(0);
   auto *src_ty = src_val->getType();
   auto *dst_ty = inst->getType();
@@ -2324,7 +2709,7 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_float_ext_trunc(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_float_to_int(
-    const llvm::Instruction *inst, const ValInfo &, u64 flags) noexcept {
+    const llvm::Instruction *inst, u64 flags) noexcept {
   bool sign = flags & 0b01;
   bool saturate = flags & 0b10;
 
@@ -2401,7 +2786,7 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_float_to_int(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_int_to_float(
-    const llvm::Instruction *inst, const ValInfo &, u64 sign) noexcept {
+    const llvm::Instruction *inst, u64 sign) noexcept {
   const llvm::Value *src_val = inst->getOperand(0);
   auto *dst_ty = inst->getType();
   auto bit_width = src_val->getType()->getIntegerBitWidth();
@@ -2480,7 +2865,8 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_int_to_float(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_int_trunc(
-    const llvm::Instruction *inst, const ValInfo &val_info, u64) noexcept {
+    const llvm::Instruction *inst, u64) noexcept {
+  const ValInfo &val_info = this->adaptor->val_info(inst);
   ValueRef res_vr = this->result_ref(inst);
   ValueRef src_vr = this->val_ref(inst->getOperand(0));
 
@@ -2526,7 +2912,7 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_int_trunc(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_int_ext(
-    const llvm::Instruction *inst, const ValInfo &, u64 sign) noexcept {
+    const llvm::Instruction *inst, u64 sign) noexcept {
   if (!inst->getType()->isIntegerTy()) {
     return false;
   }
@@ -2570,7 +2956,7 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_int_ext(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_ptr_to_int(
-    const llvm::Instruction *inst, const ValInfo &, u64) noexcept {
+    const llvm::Instruction *inst, u64) noexcept {
   if (!inst->getType()->isIntegerTy()) {
     return false;
   }
@@ -2584,7 +2970,7 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_ptr_to_int(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_int_to_ptr(
-    const llvm::Instruction *inst, const ValInfo &, u64) noexcept {
+    const llvm::Instruction *inst, u64) noexcept {
   if (!inst->getType()->isPointerTy()) {
     return false;
   }
@@ -2610,7 +2996,7 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_int_to_ptr(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_bitcast(
-    const llvm::Instruction *inst, const ValInfo &, u64) noexcept {
+    const llvm::Instruction *inst, u64) noexcept {
   // at most this should be fine to implement as a copy operation
   // as the values cannot be aggregates
   // TODO: this is not necessarily a no-op for vectors
@@ -2640,7 +3026,7 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_bitcast(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_extract_value(
-    const llvm::Instruction *inst, const ValInfo &, u64) noexcept {
+    const llvm::Instruction *inst, u64) noexcept {
   const auto *extract = llvm::cast<llvm::ExtractValueInst>(inst);
   auto src = extract->getAggregateOperand();
 
@@ -2658,7 +3044,7 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_extract_value(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_insert_value(
-    const llvm::Instruction *inst, const ValInfo &, u64) noexcept {
+    const llvm::Instruction *inst, u64) noexcept {
   const auto *insert = llvm::cast<llvm::InsertValueInst>(inst);
   auto agg = insert->getAggregateOperand();
   auto ins = insert->getInsertedValueOperand();
@@ -2744,7 +3130,8 @@ void LLVMCompilerBase<Adaptor, Derived, Config>::insert_element(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_extract_element(
-    const llvm::Instruction *inst, const ValInfo &val_info, u64) noexcept {
+    const llvm::Instruction *inst, u64) noexcept {
+  const ValInfo &val_info = this->adaptor->val_info(inst);
   llvm::Value *src = inst->getOperand(0);
   llvm::Value *index = inst->getOperand(1);
 
@@ -2803,7 +3190,7 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_extract_element(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_insert_element(
-    const llvm::Instruction *inst, const ValInfo &, u64) noexcept {
+    const llvm::Instruction *inst, u64) noexcept {
   llvm::Value *index = inst->getOperand(2);
 
   auto *vec_ty = llvm::cast<llvm::FixedVectorType>(inst->getType());
@@ -2866,7 +3253,7 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_insert_element(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_shuffle_vector(
-    const llvm::Instruction *inst, const ValInfo &, u64) noexcept {
+    const llvm::Instruction *inst, u64) noexcept {
   const auto *shuffle = llvm::cast<llvm::ShuffleVectorInst>(inst);
   llvm::Value *lhs = shuffle->getOperand(0);
   llvm::Value *rhs = shuffle->getOperand(1);
@@ -2943,7 +3330,7 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_shuffle_vector(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_cmpxchg(
-    const llvm::Instruction *inst, const ValInfo &, u64) noexcept {
+    const llvm::Instruction *inst, u64) noexcept {
   const auto *cmpxchg = llvm::cast<llvm::AtomicCmpXchgInst>(inst);
   auto *cmp_val = cmpxchg->getCompareOperand();
   auto *new_val = cmpxchg->getNewValOperand();
@@ -3040,7 +3427,8 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_cmpxchg(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_atomicrmw(
-    const llvm::Instruction *inst, const ValInfo &val_info, u64) noexcept {
+    const llvm::Instruction *inst, u64) noexcept {
+  const ValInfo &val_info = this->adaptor->val_info(inst);
   const auto *rmw = llvm::cast<llvm::AtomicRMWInst>(inst);
   llvm::Type *ty = rmw->getType();
   unsigned size = this->adaptor->mod->getDataLayout().getTypeSizeInBits(ty);
@@ -3228,7 +3616,7 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_atomicrmw(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_fence(
-    const llvm::Instruction *inst, const ValInfo &, u64) noexcept {
+    const llvm::Instruction *inst, u64) noexcept {
   const auto *fence = llvm::cast<llvm::FenceInst>(inst);
   if (fence->getSyncScopeID() == llvm::SyncScope::SingleThread) {
     // memory barrier only
@@ -3249,7 +3637,7 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_fence(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_freeze(
-    const llvm::Instruction *inst, const ValInfo &, u64) noexcept {
+    const llvm::Instruction *inst, u64) noexcept {
   // essentially a no-op
   auto src_ref = this->val_ref(inst->getOperand(0));
   auto res_ref = this->result_ref(inst);
@@ -3263,10 +3651,10 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_freeze(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_call(
-    const llvm::Instruction *inst, const ValInfo &info, u64) noexcept {
+    const llvm::Instruction *inst, u64) noexcept {
   const auto *call = llvm::cast<llvm::CallBase>(inst);
   if (auto *intrin = llvm::dyn_cast<llvm::IntrinsicInst>(call)) {
-    return compile_intrin(intrin, info);
+    return compile_intrin(intrin);
   }
 
   if (call->isMustTailCall() || call->hasOperandBundles()) {
@@ -3333,7 +3721,8 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_call(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_select(
-    const llvm::Instruction *inst, const ValInfo &val_info, u64) noexcept {
+    const llvm::Instruction *inst, u64) noexcept {
+  const ValInfo &val_info = this->adaptor->val_info(inst);
   if (!inst->getOperand(0)->getType()->isIntegerTy()) {
     return false;
   }
@@ -3374,6 +3763,12 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_select(
     derived()->encode_select_v2u64(
         std::move(cond), lhs.part(0), rhs.part(0), res_scratch);
     break;
+  case v256:
+    if (!derived()->select_v256(
+            std::move(cond), lhs.part(0), rhs.part(0), res_scratch)) {
+      return false;
+    }
+    break;
   case complex: {
     // Handle case of complex with two i64 as i128, this is extremely hacky...
     // TODO(ts): support full complex types using branches
@@ -3408,7 +3803,7 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_select(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_gep(
-    const llvm::Instruction *inst, const ValInfo &, u64) noexcept {
+    const llvm::Instruction *inst, u64) noexcept {
   auto *gep = llvm::cast<llvm::GetElementPtrInst>(inst);
   if (gep->getType()->isVectorTy()) {
     return false;
@@ -3564,7 +3959,7 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_gep(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_fcmp(
-    const llvm::Instruction *inst, const ValInfo &, u64) noexcept {
+    const llvm::Instruction *inst, u64) noexcept {
   const auto *cmp = llvm::cast<llvm::FCmpInst>(inst);
   auto *cmp_ty = cmp->getOperand(0)->getType();
   if (cmp_ty->isVectorTy()) {
@@ -3717,7 +4112,7 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_fcmp(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_switch(
-    const llvm::Instruction *inst, const ValInfo &, u64) noexcept {
+    const llvm::Instruction *inst, u64) noexcept {
   const auto *switch_inst = llvm::cast<llvm::SwitchInst>(inst);
   ValuePartRef cmp_ref{this};
   AsmReg cmp_reg;
@@ -3765,21 +4160,85 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_switch(
   });
 
   // because some blocks might have PHI-values we need to first jump to a
-  // label which then fixes the registers and then jumps to the block
-  // TODO(ts): check which blocks need PHIs and otherwise jump directly to
-  // them? probably better for branch predictor
+  // label which then fixes the registers and then jumps to the block.
+  // If enabled, this label is shared by all cases with the same target and
+  // cases to blocks without PHI nodes branch directly to the target block,
+  // the register state is already consistent after spilling.
+  const bool direct_branches = this->switch_direct_branches;
+  llvm::SmallDenseMap<IRBlockRef, typename Assembler::Label, 16> phi_labels;
+  tpde::util::SmallVector<std::pair<typename Assembler::Label, IRBlockRef>, 16>
+      edge_labels;
+  const auto target_label = [&](IRBlockRef target) {
+    if (!direct_branches) {
+      edge_labels.emplace_back(this->assembler.label_create(), target);
+      return edge_labels.back().first;
+    }
+    if (!this->analyzer.block_has_phis(target)) {
+      return this->block_labels[(u32)this->analyzer.block_idx(target)];
+    }
+    auto [it, inserted] = phi_labels.try_emplace(target);
+    if (inserted) {
+      it->second = this->assembler.label_create();
+      edge_labels.emplace_back(it->second, target);
+    }
+    return it->second;
+  };
+
+  const auto default_label = target_label(
+      this->adaptor->block_lookup_idx(switch_inst->getDefaultDest()));
 
   tpde::util::SmallVector<typename Assembler::Label, 64> case_labels;
   for (auto i = 0u; i < cases.size(); ++i) {
-    case_labels.push_back(this->assembler.label_create());
+    case_labels.push_back(target_label(cases[i].second));
   }
 
-  const auto default_label = this->assembler.label_create();
-
   const auto build_range = [&,
                             this](size_t begin, size_t end, const auto &self) {
     assert(begin <= end);
     const auto num_cases = end - begin;
+
+    // If all cases fit into a 64-value window and go to at most three
+    // distinct blocks, test the value against one bit mask per block instead
+    // of building a compare tree. Same profitability heuristic as LLVM.
+    if (num_cases >= 3 && cases[end - 1].first - cases[begin].first < 64) {
+      // Bit indices are relative to zero if possible to avoid the subtraction.
+      const u64 low = cases[end - 1].first < 64 ? 0 : cases[begin].first;
+      std::array<IRBlockRef, 3> dests;
+      std::array<std::pair<u64, typename Assembler::Label>, 3> tests;
+      unsigned num_dests = 0;
+      for (auto i = begin; i < end; ++i) {
+        unsigned j = 0;
+        while (j < num_dests && dests[j] != cases[i].second) {
+          ++j;
+        }
+        if (j == dests.size()) {
+          num_dests = 0;
+          break;
+        }
+        if (j == num_dests) {
+          dests[j] = cases[i].second;
+          tests[j] = std::make_pair(u64{0}, case_labels[i]);
+          ++num_dests;
+        }
+        tests[j].first |= u64{1} << (cases[i].first - low);
+      }
+
+      if ((num_dests == 1 && num_cases >= 3) ||
+          (num_dests == 2 && num_cases >= 5) ||
+          (num_dests == 3 && num_cases >= 6)) {
+        if (derived()->switch_emit_bit_tests(default_label,
+                                             std::span{tests.data(), num_dests},
+                                             cmp_reg,
+                                             tmp_reg,
+                                             low,
+                                             cases[end - 1].first,
+                                             width_is_32)) {
+          derived()->generate_raw_jump(Derived::Jump::jmp, default_label);
+          return;
+        }
+      }
+    }
+
     if (num_cases <= 4) {
       // if there are four or less cases we just compare the values
       // against each of them
@@ -3858,18 +4317,11 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_switch(
   build_range(0, case_labels.size(), build_range);
 
   // write out the labels
-  this->label_place(default_label);
   // TODO(ts): factor into arch-code?
-  derived()->generate_branch_to_block(
-      Derived::Jump::jmp,
-      this->adaptor->block_lookup_idx(switch_inst->getDefaultDest()),
-      false,
-      false);
-
-  for (auto i = 0u; i < cases.size(); ++i) {
-    this->label_place(case_labels[i]);
+  for (auto [label, target] : edge_labels) {
+    this->label_place(label);
     derived()->generate_branch_to_block(
-        Derived::Jump::jmp, cases[i].second, false, false);
+        Derived::Jump::jmp, target, false, false);
   }
 
   this->end_branch_region();
@@ -3880,7 +4332,7 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_switch(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_invoke(
-    const llvm::Instruction *inst, const ValInfo &val_info, u64) noexcept {
+    const llvm::Instruction *inst, u64) noexcept {
   const auto *invoke = llvm::cast<llvm::InvokeInst>(inst);
 
   // we need to spill here since the call might branch off
@@ -3896,7 +4348,7 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_invoke(
   // TODO: if the call needs stack space, this must be undone in the unwind
   // block! LLVM emits .cfi_escape 0x2e, <off>, we should do the same?
   // (Current workaround by treating invoke as dynamic alloca.)
-  if (!this->compile_call(invoke, val_info, 0)) {
+  if (!this->compile_call(invoke, 0)) {
     return false;
   }
   const auto off_after_call = this->text_writer.offset();
@@ -4013,7 +4465,7 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_invoke(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_landing_pad(
-    const llvm::Instruction *inst, const ValInfo &, u64) noexcept {
+    const llvm::Instruction *inst, u64) noexcept {
   auto res_ref = this->result_ref(inst);
   res_ref.part(0).set_value_reg(Derived::LANDING_PAD_RES_REGS[0]);
   res_ref.part(1).set_value_reg(Derived::LANDING_PAD_RES_REGS[1]);
@@ -4023,13 +4475,13 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_landing_pad(
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_resume(
-    const llvm::Instruction *inst, const ValInfo &val_info, u64) noexcept {
+    const llvm::Instruction *inst, u64) noexcept {
   IRValueRef arg = inst->getOperand(0);
 
   const auto sym = get_libfunc_sym(LibFunc::resume);
 
   derived()->create_helper_call({&arg, 1}, nullptr, sym);
-  return derived()->compile_unreachable(nullptr, val_info, 0);
+  return derived()->compile_unreachable(nullptr, 0);
 }
 
 template <typename Adaptor, typename Derived, typename Config>
@@ -4057,7 +4509,7 @@ typename LLVMCompilerBase<Adaptor, Derived, Config>::SymRef
 
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_intrin(
-    const llvm::IntrinsicInst *inst, const ValInfo &info) noexcept {
+    const llvm::IntrinsicInst *inst) noexcept {
   const auto intrin_id = inst->getIntrinsicID();
 
   switch (intrin_id) {
@@ -4093,6 +4545,10 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_intrin(
     return true;
   }
   case llvm::Intrinsic::memcpy: {
+    if (compile_mem_intrin_inline(llvm::cast<llvm::MemIntrinsic>(inst))) {
+      return true;
+    }
+
     const auto dst = inst->getOperand(0);
     const auto src = inst->getOperand(1);
     const auto len = inst->getOperand(2);
@@ -4104,6 +4560,10 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_intrin(
     return true;
   }
   case llvm::Intrinsic::memset: {
+    if (compile_mem_intrin_inline(llvm::cast<llvm::MemIntrinsic>(inst))) {
+      return true;
+    }
+
     const auto dst = inst->getOperand(0);
     const auto val = inst->getOperand(1);
     const auto len = inst->getOperand(2);
@@ -4115,6 +4575,10 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_intrin(
     return true;
   }
   case llvm::Intrinsic::memmove: {
+    if (compile_mem_intrin_inline(llvm::cast<llvm::MemIntrinsic>(inst))) {
+      return true;
+    }
+
     const auto dst = inst->getOperand(0);
     const auto src = inst->getOperand(1);
     const auto len = inst->getOperand(2);
@@ -4160,6 +4624,44 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_intrin(
   case llvm::Intrinsic::round:
   case llvm::Intrinsic::rint:
   case llvm::Intrinsic::trunc:
+    if (derived()->has_native_fp_rounding()) {
+      const auto is_double = inst->getType()->isDoubleTy();
+      if (!is_double && !inst->getType()->isFloatTy()) {
+        return false;
+      }
+
+      using EncodeFnTy = bool (Derived::*)(GenericValuePart &&, ScratchReg &);
+      EncodeFnTy fn;
+      switch (intrin_id) {
+        using enum llvm::Intrinsic::IndependentIntrinsics;
+      case floor:
+        fn = is_double ? &Derived::encode_floorf64 : &Derived::encode_floorf32;
+        break;
+      case ceil:
+        fn = is_double ? &Derived::encode_ceilf64 : &Derived::encode_ceilf32;
+        break;
+      case round:
+        fn = is_double ? &Derived::encode_roundf64 : &Derived::encode_roundf32;
+        break;
+      case rint:
+        fn = is_double ? &Derived::encode_rintf64 : &Derived::encode_rintf32;
+        break;
+      case trunc:
+        fn = is_double ? &Derived::encode_truncf64 : &Derived::encode_truncf32;
+        break;
+      default: TPDE_UNREACHABLE("invalid rounding intrinsic");
+      }
+
+      auto val = this->val_ref(inst->getOperand(0));
+      auto [res_vr, res_ref] = this->result_ref_single(inst);
+      ScratchReg res{derived()};
+      if (!(derived()->*fn)(val.part(0), res)) {
+        return false;
+      }
+      this->set_value(res_ref, res);
+      return true;
+    }
+    [[fallthrough]];
   case llvm::Intrinsic::pow:
   case llvm::Intrinsic::powi:
   case llvm::Intrinsic::sin:
@@ -4446,9 +4948,9 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_intrin(
   case llvm::Intrinsic::ssub_sat:
     return compile_saturating_intrin(inst, OverflowOp::ssub);
   case llvm::Intrinsic::fptoui_sat:
-    return compile_float_to_int(inst, info, /*flags=!sign|sat*/ 0b10);
+    return compile_float_to_int(inst, /*flags=!sign|sat*/ 0b10);
   case llvm::Intrinsic::fptosi_sat:
-    return compile_float_to_int(inst, info, /*flags=sign|sat*/ 0b11);
+    return compile_float_to_int(inst, /*flags=sign|sat*/ 0b11);
   case llvm::Intrinsic::fshl:
   case llvm::Intrinsic::fshr: {
     if (!inst->getType()->isIntegerTy()) {
@@ -4768,6 +5270,123 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_intrin(
   }
 }
 
+template <typename Adaptor, typename Derived, typename Config>
+bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_mem_intrin_inline(
+    const llvm::MemIntrinsic *inst) noexcept {
+  const auto *len_const = llvm::dyn_cast<llvm::ConstantInt>(inst->getLength());
+  if (!len_const || inst->isVolatile() ||
+      len_const->getValue().ugt(this->inline_mem_max_size)) {
+    return false;
+  }
+  const u32 len = len_const->getZExtValue();
+
+  const auto intrin_id = inst->getIntrinsicID();
+  u64 fill = 0;
+  if (intrin_id == llvm::Intrinsic::memset) {
+    const auto *val = llvm::dyn_cast<llvm::ConstantInt>(inst->getOperand(1));
+    if (!val) {
+      // TODO: splat non-constant values
+      return false;
+    }
+    fill = val->getZExtValue() * 0x0101'0101'0101'0101;
+  } else if (intrin_id == llvm::Intrinsic::memmove) {
+    // All parts are loaded before the first store and need a register each.
+    if (len > 64) {
+      return false;
+    }
+  }
+
+  // Use the largest access up to 16 bytes that fits into the remaining length.
+  const auto part_size = [len](u32 off) -> u32 {
+    return len - off >= 16 ? 16 : std::bit_floor(len - off);
+  };
+
+  // Base register and displacement of a pointer; ref must stay alive while
+  // the address is used.
+  const auto ptr_addr = [this](ValuePartRef &ref) -> std::pair<AsmReg, i64> {
+    if (ref.has_assignment() && ref.assignment().is_stack_variable()) {
+      GenericValuePart addr =
+          derived()->create_addr_for_alloca(ref.assignment());
+      const auto &expr = std::get<typename GenericValuePart::Expr>(addr.state);
+      return {expr.base_reg(), expr.disp};
+    }
+    return {ref.load_to_reg(), 0};
+  };
+
+  const auto load = [this](AsmReg base, i64 disp, u32 size, ScratchReg &res) {
+    auto addr = typename GenericValuePart::Expr{base, disp};
+    switch (size) {
+    case 1: derived()->encode_loadi8(std::move(addr), res); break;
+    case 2: derived()->encode_loadi16(std::move(addr), res); break;
+    case 4: derived()->encode_loadi32(std::move(addr), res); break;
+    case 8: derived()->encode_loadi64(std::move(addr), res); break;
+    case 16: derived()->encode_loadv128u(std::move(addr), res); break;
+    default: TPDE_UNREACHABLE("invalid access size");
+    }
+  };
+
+  const auto store = [this](AsmReg base,
+                            i64 disp,
+                            u32 size,
+                            GenericValuePart &&val) {
+    auto addr = typename GenericValuePart::Expr{base, disp};
+    switch (size) {
+    case 1: derived()->encode_storei8(std::move(addr), std::move(val)); break;
+    case 2: derived()->encode_storei16(std::move(addr), std::move(val)); break;
+    case 4: derived()->encode_storei32(std::move(addr), std::move(val)); break;
+    case 8: derived()->encode_storei64(std::move(addr), std::move(val)); break;
+    case 16:
+      derived()->encode_storev128u(std::move(addr), std::move(val));
+      break;
+    default: TPDE_UNREACHABLE("invalid access size");
+    }
+  };
+
+  auto [dst_vr, dst_ref] = this->val_ref_single(inst->getDest());
+  const auto [dst_base, dst_disp] = ptr_addr(dst_ref);
+
+  if (intrin_id == llvm::Intrinsic::memset) {
+    const u64 fill_data[2] = {fill, fill};
+    for (u32 off = 0; off < len;) {
+      const u32 size = part_size(off);
+      if (size == 16) {
+        ValuePartRef val{this, fill_data, 16, Config::FP_BANK};
+        store(dst_base, dst_disp + off, size, std::move(val));
+      } else {
+        ValuePartRef val{this, fill, size, Config::GP_BANK};
+        store(dst_base, dst_disp + off, size, std::move(val));
+      }
+      off += size;
+    }
+    return true;
+  }
+
+  const auto *transfer = llvm::cast<llvm::MemTransferInst>(inst);
+  auto [src_vr, src_ref] = this->val_ref_single(transfer->getSource());
+  const auto [src_base, src_disp] = ptr_addr(src_ref);
+
+  if (intrin_id == llvm::Intrinsic::memcpy) {
+    for (u32 off = 0; off < len;) {
+      const u32 size = part_size(off);
+      ScratchReg tmp{derived()};
+      load(src_base, src_disp + off, size, tmp);
+      store(dst_base, dst_disp + off, size, std::move(tmp));
+      off += size;
+    }
+    return true;
+  }
+
+  // memmove: source and destination may overlap.
+  util::SmallVector<ScratchReg, 8> parts;
+  for (u32 off = 0; off < len; off += part_size(off)) {
+    load(src_base, src_disp + off, part_size(off), parts.emplace_back(this));
+  }
+  for (u32 off = 0, i = 0; off < len; off += part_size(off), ++i) {
+    store(dst_base, dst_disp + off, part_size(off), std::move(parts[i]));
+  }
+  return true;
+}
+
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_is_fpclass(
     const llvm::IntrinsicInst *inst) noexcept {
@@ -5010,6 +5629,15 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_saturating_intrin(
 template <typename Adaptor, typename Derived, typename Config>
 bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_to_elf(
     llvm::Module &mod, std::vector<uint8_t> &buf) noexcept {
+  ObjectCache::Key cache_key;
+  if (this->object_cache) {
+    llvm::TimeTraceScope time_scope("TPDE_CacheLookup");
+    cache_key = this->object_cache_key(mod);
+    if (this->object_cache->lookup(cache_key, buf)) {
+      return true;
+    }
+  }
+
   if (this->adaptor->mod) {
     derived()->reset();
   }
@@ -5019,6 +5647,9 @@ bool LLVMCompilerBase<Adaptor, Derived, Config>::compile_to_elf(
 
   llvm::TimeTraceScope time_scope("TPDE_EmitObj");
   buf = this->assembler.build_object_file();
+  if (this->object_cache) {
+    this->object_cache->store(cache_key, buf);
+  }
   return true;
 }
 
@@ -5029,10 +5660,43 @@ JITMapper LLVMCompilerBase<Adaptor, Derived, Config>::compile_and_map(
   if (this->adaptor->mod) {
     derived()->reset();
   }
+
+  ObjectCache::Key cache_key;
+  if (this->object_cache) {
+    llvm::TimeTraceScope time_scope("TPDE_CacheLookup");
+    cache_key = this->object_cache_key(mod);
+    std::vector<u8> obj;
+    if (this->object_cache->lookup(cache_key, obj)) {
+      if (this->assembler.load_object_file(obj)) {
+        // Globals in the cached object are identified by their name.
+        JITMapperImpl::GlobalMap globals;
+        this->assembler.sym_for_each_named(
+            [&](SymRef sym, std::string_view name) {
+              if (llvm::GlobalValue *gv = mod.getNamedValue(name)) {
+                globals.try_emplace(gv, sym);
+              }
+            });
+        auto res = std::make_unique<JITMapperImpl>(std::move(globals));
+        bool success = res->map(this->assembler, resolver);
+        // The cached object is not part of any compilation.
+        this->assembler.reset();
+        if (!success) {
+          return JITMapper{nullptr};
+        }
+        return JITMapper{std::move(res)};
+      }
+      TPDE_LOG_WARN("Ignoring malformed object cache entry");
+    }
+  }
+
   if (!compile(mod)) {
     return JITMapper{nullptr};
   }
 
+  if (this->object_cache) {
+    this->object_cache->store(cache_key, this->assembler.build_object_file());
+  }
+
   auto res = std::make_unique<JITMapperImpl>(std::move(global_syms));
   if (!res->map(this->assembler, resolver)) {
     return JITMapper{nullptr};
@@ -5041,4 +5705,44 @@ JITMapper LLVMCompilerBase<Adaptor, Derived, Config>::compile_and_map(
   return JITMapper{std::move(res)};
 }
 
+template <typename Adaptor, typename Derived, typename Config>
+JITMapper LLVMCompilerBase<Adaptor, Derived, Config>::compile_and_map_lazy(
+    llvm::Module &mod,
+    std::function<void *(std::string_view)> resolver,
+    void *error_handler) noexcept {
+  if (this->adaptor->mod) {
+    derived()->reset();
+  }
+
+  auto res = std::make_unique<JITMapperImpl>(JITMapperImpl::GlobalMap{});
+  auto lazy_compiler = [this, map = res.get()](u32 func_idx) {
+    return compile_lazy_func(*map, func_idx);
+  };
+  if (!res->init_lazy(
+          mod, mod.size(), resolver, lazy_compiler, error_handler)) {
+    return JITMapper{nullptr};
+  }
+
+  lazy_jit = res.get();
+  bool success = compile(mod);
+  lazy_jit = nullptr;
+  if (!success) {
+    return JITMapper{nullptr};
+  }
+
+  res->set_globals(std::move(global_syms));
+  if (!res->map(this->assembler, resolver)) {
+    return JITMapper{nullptr};
+  }
+
+  // Lazy compilations reuse the adaptor state of this compilation and only
+  // need the function for an index.
+  lazy_funcs.clear();
+  for (IRFuncRef func : this->adaptor->funcs()) {
+    lazy_funcs.push_back(func);
+  }
+
+  return JITMapper{std::move(res)};
+}
+
 } // namespace tpde_llvm
@@ -0,0 +1,271 @@
+// SPDX-FileCopyrightText: 2025 Contributors to TPDE <https://tpde.org>
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "tpde-llvm/ObjectCache.hpp"
+
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/BLAKE3.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "base.hpp"
+
+#ifndef TPDE_LLVM_VERSION
+  #define TPDE_LLVM_VERSION "unknown"
+#endif
+
+namespace tpde_llvm {
+
+namespace {
+
+constexpr std::string_view ENTRY_SUFFIX = ".o";
+constexpr std::string_view TMP_PREFIX = "tmp.";
+
+/// Temporary files older than this are left over from crashed processes.
+constexpr time_t STALE_TMP_SECONDS = 60 * 60;
+
+/// Prune at the latest this long after the last prune of any process; the
+/// modification time of the lock file records the last prune.
+constexpr time_t PRUNE_INTERVAL_SECONDS = 5 * 60;
+/// Prune after a process stored more than max_size / PRUNE_SIZE_DIVISOR
+/// bytes since its last prune.
+constexpr uint64_t PRUNE_SIZE_DIVISOR = 8;
+
+void hash_str(llvm::BLAKE3 &hasher, std::string_view str) noexcept {
+  uint64_t len = str.size();
+  hasher.update(llvm::ArrayRef<uint8_t>(
+      reinterpret_cast<const uint8_t *>(&len), sizeof(len)));
+  hasher.update(llvm::StringRef(str.data(), str.size()));
+}
+
+bool write_all(int fd, const uint8_t *data, size_t size) noexcept {
+  while (size > 0) {
+    ssize_t res = ::write(fd, data, size);
+    if (res < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += res;
+    size -= res;
+  }
+  return true;
+}
+
+} // namespace
+
+ObjectCache::ObjectCache(std::string dir, uint64_t max_size) noexcept
+    : dir(std::move(dir)), max_size(max_size) {
+  if (::mkdir(this->dir.c_str(), 0755) != 0 && errno != EEXIST) {
+    TPDE_LOG_WARN("Failed to create object cache directory {}", this->dir);
+  }
+}
+
+ObjectCache::Key ObjectCache::compute_key(const llvm::Module &mod,
+                                          std::string_view target,
+                                          const Key *source_hash) noexcept {
+  llvm::BLAKE3 hasher;
+  hash_str(hasher, TPDE_LLVM_VERSION);
+  hash_str(hasher, LLVM_VERSION_STRING);
+  hash_str(hasher, target);
+  if (source_hash) {
+    hash_str(hasher, "source");
+    hasher.update(llvm::ArrayRef<uint8_t>(*source_hash));
+    return hasher.final();
+  }
+
+  // Only the module itself is needed for the key, skip the symbol table of
+  // WriteBitcodeToFile, which needs a target lookup and symbol mangling.
+  llvm::SmallVector<char, 0> bitcode;
+  llvm::BitcodeWriter writer(bitcode);
+  writer.writeModule(mod);
+  writer.writeStrtab();
+  hash_str(hasher, std::string_view(bitcode.data(), bitcode.size()));
+  return hasher.final();
+}
+
+ObjectCache::Key
+    ObjectCache::hash_source(const llvm::Module &mod,
+                             std::span<const uint8_t> source) noexcept {
+  // The module identifier is used as source file name if the source doesn't
+  // specify one.
+  llvm::BLAKE3 hasher;
+  hash_str(hasher, mod.getModuleIdentifier());
+  hash_str(hasher, mod.getSourceFileName());
+  hash_str(hasher,
+           std::string_view(reinterpret_cast<const char *>(source.data()),
+                            source.size()));
+  return hasher.final();
+}
+
+std::string ObjectCache::entry_path(const Key &key) const noexcept {
+  static constexpr char hex[] = "0123456789abcdef";
+  std::string path = dir;
+  path += '/';
+  for (uint8_t byte : key) {
+    path += hex[byte >> 4];
+    path += hex[byte & 0xf];
+  }
+  path += ENTRY_SUFFIX;
+  return path;
+}
+
+bool ObjectCache::lookup(const Key &key, std::vector<uint8_t> &buf) noexcept {
+  std::string path = entry_path(key);
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+
+  // Entries are only created by rename, so they are always complete. An entry
+  // that is removed concurrently remains readable while it is open.
+  bool success = false;
+  struct stat st;
+  if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+    buf.resize(st.st_size);
+    size_t off = 0;
+    while (off < buf.size()) {
+      ssize_t res = ::read(fd, buf.data() + off, buf.size() - off);
+      if (res < 0 && errno == EINTR) {
+        continue;
+      }
+      if (res <= 0) {
+        break;
+      }
+      off += res;
+    }
+    success = off == buf.size();
+  }
+
+  ::close(fd);
+
+  // Update modification time for LRU eviction. This requires write permission
+  // on the file, which a read-only descriptor doesn't provide.
+  if (success && ::utimensat(AT_FDCWD, path.c_str(), nullptr, 0) != 0) {
+    TPDE_LOG_WARN("Failed to update modification time of {}", path);
+  }
+  return success;
+}
+
+void ObjectCache::store(const Key &key, std::span<const uint8_t> obj) noexcept {
+  std::string tmp_path = dir + '/';
+  tmp_path += TMP_PREFIX;
+  tmp_path += "XXXXXX";
+  int fd = ::mkstemp(tmp_path.data());
+  if (fd < 0) {
+    TPDE_LOG_WARN("Failed to create temporary file in {}", dir);
+    return;
+  }
+
+  // mkstemp creates the file with mode 0600.
+  bool success =
+      ::fchmod(fd, 0644) == 0 && write_all(fd, obj.data(), obj.size());
+  success &= ::close(fd) == 0;
+  if (!success || ::rename(tmp_path.c_str(), entry_path(key).c_str()) != 0) {
+    TPDE_LOG_WARN("Failed to write object cache entry");
+    ::unlink(tmp_path.c_str());
+    return;
+  }
+
+  stored_since_prune += obj.size();
+  if (should_prune()) {
+    prune();
+  }
+}
+
+bool ObjectCache::should_prune() const noexcept {
+  if (stored_since_prune > max_size / PRUNE_SIZE_DIVISOR) {
+    return true;
+  }
+  struct stat st;
+  std::string lock_path = dir + "/lock";
+  if (::stat(lock_path.c_str(), &st) != 0) {
+    return true;
+  }
+  return ::time(nullptr) - st.st_mtime >= PRUNE_INTERVAL_SECONDS;
+}
+
+void ObjectCache::prune() noexcept {
+  // Only one process needs to prune at a time; if another process is already
+  // pruning, skip this.
+  std::string lock_path = dir + "/lock";
+  int lock_fd = ::open(lock_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (lock_fd < 0) {
+    return;
+  }
+  if (::flock(lock_fd, LOCK_EX | LOCK_NB) != 0) {
+    ::close(lock_fd);
+    return;
+  }
+  stored_since_prune = 0;
+
+  struct Entry {
+    struct timespec mtime;
+    uint64_t size;
+    std::string name;
+  };
+  std::vector<Entry> entries;
+  uint64_t total_size = 0;
+  time_t now = ::time(nullptr);
+
+  if (DIR *d = ::opendir(dir.c_str())) {
+    int dir_fd = ::dirfd(d);
+    while (struct dirent *ent = ::readdir(d)) {
+      std::string_view name = ent->d_name;
+      bool is_tmp = name.starts_with(TMP_PREFIX);
+      if (!is_tmp && !name.ends_with(ENTRY_SUFFIX)) {
+        continue;
+      }
+      struct stat st;
+      if (::fstatat(dir_fd, ent->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0 ||
+          !S_ISREG(st.st_mode)) {
+        continue;
+      }
+      if (is_tmp) {
+        if (now - st.st_mtime > STALE_TMP_SECONDS) {
+          (void)::unlinkat(dir_fd, ent->d_name, 0);
+        }
+        continue;
+      }
+      entries.push_back(Entry{st.st_mtim, uint64_t(st.st_size), ent->d_name});
+      total_size += st.st_size;
+    }
+
+    if (total_size > max_size) {
+      const auto older = [](const Entry &a, const Entry &b) {
+        if (a.mtime.tv_sec != b.mtime.tv_sec) {
+          return a.mtime.tv_sec < b.mtime.tv_sec;
+        }
+        return a.mtime.tv_nsec < b.mtime.tv_nsec;
+      };
+      std::sort(entries.begin(), entries.end(), older);
+      for (const Entry &entry : entries) {
+        if (total_size <= max_size) {
+          break;
+        }
+        if (::unlinkat(dir_fd, entry.name.c_str(), 0) == 0) {
+          total_size -= entry.size;
+        }
+      }
+    }
+    ::closedir(d);
+  }
+
+  // Record the time of this prune for should_prune of all processes.
+  (void)::futimens(lock_fd, nullptr);
+  ::flock(lock_fd, LOCK_UN);
+  ::close(lock_fd);
+}
+
+} // namespace tpde_llvm
@@ -2,6 +2,8 @@
 //
 // SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
 
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
 #include <llvm/IR/InlineAsm.h>
 #include <llvm/IR/Instruction.h>
 #include <llvm/IR/Instructions.h>
@@ -57,8 +59,9 @@ struct LLVMCompilerArm64 : tpde::a64::CompilerA64<LLVMAdaptor,
   static constexpr std::array<AsmReg, 2> LANDING_PAD_RES_REGS = {AsmReg::R0,
                                                                  AsmReg::R1};
 
-  explicit LLVMCompilerArm64(std::unique_ptr<LLVMAdaptor> &&adaptor)
-      : Base{adaptor.get()}, adaptor(std::move(adaptor)) {
+  explicit LLVMCompilerArm64(std::unique_ptr<LLVMAdaptor> &&adaptor,
+                             CPU_FEATURES cpu_features = CPU_BASELINE)
+      : Base{adaptor.get(), cpu_features}, adaptor(std::move(adaptor)) {
     static_assert(tpde::Compiler<LLVMCompilerArm64, tpde::a64::PlatformConfig>);
   }
 
@@ -96,16 +99,14 @@ struct LLVMCompilerArm64 : tpde::a64::CompilerA64<LLVMAdaptor,
                       LLVMBasicValType ty,
                       GenericValuePart el) noexcept;
 
-  bool compile_unreachable(const llvm::Instruction *,
-                           const ValInfo &,
-                           u64) noexcept;
-  bool compile_alloca(const llvm::Instruction *, const ValInfo &, u64) noexcept;
-  bool compile_br(const llvm::Instruction *, const ValInfo &, u64) noexcept;
+  bool compile_unreachable(const llvm::Instruction *, u64) noexcept;
+  bool compile_alloca(const llvm::Instruction *, u64) noexcept;
+  bool compile_br(const llvm::Instruction *, u64) noexcept;
   void generate_conditional_branch(Jump jmp,
                                    IRBlockRef true_target,
                                    IRBlockRef false_target) noexcept;
   bool compile_inline_asm(const llvm::CallBase *) noexcept;
-  bool compile_icmp(const llvm::Instruction *, const ValInfo &, u64) noexcept;
+  bool compile_icmp(const llvm::Instruction *, u64) noexcept;
   void compile_i32_cmp_zero(AsmReg reg, llvm::CmpInst::Predicate p) noexcept;
 
   GenericValuePart create_addr_for_alloca(tpde::AssignmentPartRef ap) noexcept;
@@ -126,6 +127,14 @@ struct LLVMCompilerArm64 : tpde::a64::CompilerA64<LLVMAdaptor,
                               u64 low_bound,
                               u64 high_bound,
                               bool width_is_32) noexcept;
+  bool switch_emit_bit_tests(
+      Label default_label,
+      std::span<const std::pair<u64, Label>> tests,
+      AsmReg cmp_reg,
+      AsmReg tmp_reg,
+      u64 low_bound,
+      u64 high_bound,
+      bool width_is_32) noexcept;
   void switch_emit_binary_step(Label case_label,
                                Label gt_label,
                                AsmReg cmp_reg,
@@ -251,7 +260,6 @@ void LLVMCompilerArm64::insert_element(ValuePart &vec_ref,
 }
 
 bool LLVMCompilerArm64::compile_unreachable(const llvm::Instruction *,
-                                            const ValInfo &,
                                             u64) noexcept {
   ASM(UDF, 1);
   this->release_regs_after_return();
@@ -259,7 +267,6 @@ bool LLVMCompilerArm64::compile_unreachable(const llvm::Instruction *,
 }
 
 bool LLVMCompilerArm64::compile_alloca(const llvm::Instruction *inst,
-                                       const ValInfo &,
                                        u64) noexcept {
   const auto *alloca = llvm::cast<llvm::AllocaInst>(inst);
   assert(this->adaptor->cur_has_dynamic_alloca());
@@ -344,7 +351,6 @@ bool LLVMCompilerArm64::compile_alloca(const llvm::Instruction *inst,
 }
 
 bool LLVMCompilerArm64::compile_br(const llvm::Instruction *inst,
-                                   const ValInfo &,
                                    u64) noexcept {
   const auto *br = llvm::cast<llvm::BranchInst>(inst);
   if (br->isUnconditional()) {
@@ -427,7 +433,6 @@ bool LLVMCompilerArm64::compile_inline_asm(
 }
 
 bool LLVMCompilerArm64::compile_icmp(const llvm::Instruction *inst,
-                                     const ValInfo &,
                                      u64) noexcept {
   const auto *cmp = llvm::cast<llvm::ICmpInst>(inst);
   auto *cmp_ty = cmp->getOperand(0)->getType();
@@ -469,7 +474,7 @@ bool LLVMCompilerArm64::compile_icmp(const llvm::Instruction *inst,
   const llvm::BranchInst *fuse_br = nullptr;
   const llvm::Instruction *fuse_ext = nullptr;
   if (!cmp->user_empty() && *cmp->user_begin() == cmp->getNextNode() &&
-      (analyzer.liveness_info(val_idx(cmp)).ref_count <= 2)) {
+      (analyzer.liveness_ref_count(val_idx(cmp)) <= 2)) {
     auto *fuse_inst = cmp->getNextNode();
     assert(cmp->hasNUses(1));
     if (auto *br = llvm::dyn_cast<llvm::BranchInst>(fuse_inst)) {
@@ -658,48 +663,93 @@ bool LLVMCompilerArm64::switch_emit_jump_table(Label default_label,
                                                u64 low_bound,
                                                u64 high_bound,
                                                bool width_is_32) noexcept {
-  (void)default_label;
-  (void)labels;
-  (void)cmp_reg;
-  (void)tmp_reg;
-  (void)low_bound;
-  (void)high_bound;
-  (void)width_is_32;
-  // TODO: implement adr/adrp to get address of jump table
-#if 0
-    ScratchReg scratch{this};
-    if (low_bound != 0) {
-        switch_emit_cmp(scratch, cmp_reg, low_bound, width_is_32);
-        generate_raw_jump(Jump::Jcc, default_label);
+  if (!this->arm64_jump_tables) {
+    return false;
+  }
+
+  // NB: we must not evict any registers here.
+  if (low_bound != 0) {
+    switch_emit_cmp(cmp_reg, tmp_reg, low_bound, width_is_32);
+    generate_raw_jump(Jump::Jlo, default_label);
+  }
+  switch_emit_cmp(cmp_reg, tmp_reg, high_bound, width_is_32);
+  generate_raw_jump(Jump::Jhi, default_label);
+
+  if (width_is_32) {
+    // zero-extend cmp_reg since we use the full width
+    ASM(MOVw, cmp_reg, cmp_reg);
+  }
+
+  if (low_bound != 0) {
+    if (!ASMIF(SUBxi, cmp_reg, cmp_reg, low_bound)) {
+      materialize_constant(low_bound, CompilerConfig::GP_BANK, 8, tmp_reg);
+      ASM(SUBx, cmp_reg, cmp_reg, tmp_reg);
     }
-    switch_emit_cmp(scratch, cmp_reg, high_bound, width_is_32);
-    generate_raw_jump(Jump::Jhi, default_label);
+  }
 
-    if (width_is_32) {
-        // zero-extend cmp_reg since we use the full width
-        ASM(MOVw, cmp_reg, cmp_reg);
+  // The table directly follows the branch, so the code must be contiguous
+  // without veneers in between.
+  constexpr u32 table_disp = 5 * 4;
+  text_writer.ensure_space(table_disp + 4 * labels.size());
+  // adr tmp_reg, table; immlo is zero as the displacement is 4-byte aligned.
+  text_writer.write_inst_unchecked(0x1000'0000 | ((table_disp >> 2) << 5) |
+                                   tmp_reg.id());
+  // load the 4 byte displacement from the jump table
+  ASMNC(ADDx_lsl, cmp_reg, tmp_reg, cmp_reg, 2);
+  ASMNC(LDRSWxu, cmp_reg, cmp_reg, 0);
+  ASMNC(ADDx, tmp_reg, tmp_reg, cmp_reg);
+  ASMNC(BR, tmp_reg);
+
+  auto sec_ref = text_writer.get_sec_ref();
+  const auto table_off = text_writer.offset();
+  for (u32 i = 0; i < labels.size(); i++) {
+    if (assembler.label_is_pending(labels[i])) {
+      assembler.add_unresolved_entry(
+          labels[i],
+          sec_ref,
+          text_writer.offset(),
+          Assembler::UnresolvedEntryKind::JUMP_TABLE);
+      text_writer.write_unchecked<u32>(table_off);
+    } else {
+      const auto label_off = assembler.label_offset(labels[i]);
+      text_writer.write_unchecked<i32>((i32)label_off - (i32)table_off);
     }
+  }
+  return true;
+}
 
-    if (low_bound != 0 && !ASMIF(CMPxi, cmp_reg, low_bound)) {
-        const auto tmp = scratch.alloc_gp();
-        materialize_constant(low_bound, 0, 4, tmp);
-        ASM(CMPx, cmp_reg, tmp);
+bool LLVMCompilerArm64::switch_emit_bit_tests(
+    Label default_label,
+    std::span<const std::pair<u64, Label>> tests,
+    AsmReg cmp_reg,
+    AsmReg tmp_reg,
+    u64 low_bound,
+    u64 high_bound,
+    bool width_is_32) noexcept {
+  // NB: we must not evict any registers here. cmp_reg is not used after this
+  // point, so we can turn it into the bit index.
+  if (low_bound != 0) {
+    if (width_is_32) {
+      if (!ASMIF(SUBwi, cmp_reg, cmp_reg, low_bound)) {
+        materialize_constant(low_bound, CompilerConfig::GP_BANK, 4, tmp_reg);
+        ASM(SUBw, cmp_reg, cmp_reg, tmp_reg);
+      }
+    } else if (!ASMIF(SUBxi, cmp_reg, cmp_reg, low_bound)) {
+      materialize_constant(low_bound, CompilerConfig::GP_BANK, 8, tmp_reg);
+      ASM(SUBx, cmp_reg, cmp_reg, tmp_reg);
     }
+  }
+  switch_emit_cmp(cmp_reg, tmp_reg, high_bound - low_bound, width_is_32);
+  generate_raw_jump(Jump::Jhi, default_label);
 
-    auto  tmp        = scratch.alloc_gp();
-    Label jump_table = assembler.label_create();
-    ASM(LEA64rm, tmp, FE_MEM(FE_IP, 0, FE_NOREG, -1));
-    // we reuse the jump offset stuff since the patch procedure is the same
-    assembler.label_add_unresolved_jump_offset(jump_table,
-                                               assembler.text_cur_off() - 4);
-    // load the 4 byte displacement from the jump table
-    ASM(MOVSXr64m32, cmp_reg, FE_MEM(tmp, 4, cmp_reg, 0));
-    ASM(ADD64rr, tmp, cmp_reg);
-    ASM(JMPr, tmp);
-
-    assembler.emit_jump_table(jump_table, labels);
-#endif
-  return false;
+  // LSRV uses the shift amount modulo 64, so the upper half of cmp_reg doesn't
+  // matter for 32-bit values.
+  for (const auto &[mask, label] : tests) {
+    materialize_constant(mask, CompilerConfig::GP_BANK, 8, tmp_reg);
+    ASM(LSRVx, tmp_reg, tmp_reg, cmp_reg);
+    generate_raw_jump(Jump(Jump::Tbnz, tmp_reg, u8(0)), label);
+  }
+  return true;
 }
 
 void LLVMCompilerArm64::switch_emit_binary_step(
@@ -918,15 +968,31 @@ bool LLVMCompilerArm64::handle_overflow_intrin_128(
 }
 
 std::unique_ptr<LLVMCompiler>
-    create_compiler(const llvm::Triple &triple) noexcept {
+    create_compiler(const llvm::Triple &triple,
+                    const llvm::StringMap<bool> &features) noexcept {
   if (!triple.isOSBinFormatELF()) {
     return nullptr;
   }
 
+  using CPU_FEATURES = LLVMCompilerArm64::CPU_FEATURES;
+  using FeatureName = std::pair<llvm::StringLiteral, CPU_FEATURES>;
+  static constexpr FeatureName feature_names[] = {
+      {"lse", LLVMCompilerArm64::CPU_LSE},
+      {"fullfp16", LLVMCompilerArm64::CPU_FP16},
+      {"dotprod", LLVMCompilerArm64::CPU_DOTPROD},
+  };
+  u32 cpu_features = LLVMCompilerArm64::CPU_BASELINE;
+  for (const auto &[name, feature] : feature_names) {
+    if (features.lookup(name)) {
+      cpu_features |= feature;
+    }
+  }
+
   llvm::StringRef dl_str = "e-m:e-p270:32:32-p271:32:32-p272:64:64-"
                            "i8:8:32-i16:16:32-i64:64-i128:128-n32:64-S128-Fn32";
   auto adaptor = std::make_unique<LLVMAdaptor>(llvm::DataLayout(dl_str));
-  return std::make_unique<LLVMCompilerArm64>(std::move(adaptor));
+  return std::make_unique<LLVMCompilerArm64>(std::move(adaptor),
+                                             CPU_FEATURES(cpu_features));
 }
 
 } // namespace tpde_llvm::arm64
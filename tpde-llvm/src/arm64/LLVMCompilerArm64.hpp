@@ -3,6 +3,7 @@
 // SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
 #pragma once
 
+#include <llvm/ADT/StringMap.h>
 #include <memory>
 
 #include "tpde-llvm/LLVMCompiler.hpp"
@@ -13,6 +14,10 @@ class Triple;
 
 namespace tpde_llvm::arm64 {
 
-std::unique_ptr<LLVMCompiler> create_compiler(const llvm::Triple &) noexcept;
+/// Create a compiler using the enabled target features from the map, which
+/// uses LLVM feature names.
+std::unique_ptr<LLVMCompiler>
+    create_compiler(const llvm::Triple &,
+                    const llvm::StringMap<bool> &features) noexcept;
 
 } // namespace tpde_llvm::arm64
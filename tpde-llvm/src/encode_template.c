@@ -61,6 +61,14 @@ typedef u64 v2u64 __attribute__((vector_size(16)));
 typedef float v4f32 __attribute__((vector_size(16)));
 typedef double v2f64 __attribute__((vector_size(16)));
 
+typedef u8 v32u8 __attribute__((vector_size(32)));
+typedef u16 v16u16 __attribute__((vector_size(32)));
+typedef i32 v8i32 __attribute__((vector_size(32)));
+typedef u32 v8u32 __attribute__((vector_size(32)));
+typedef u64 v4u64 __attribute__((vector_size(32)));
+typedef float v8f32 __attribute__((vector_size(32)));
+typedef double v4f64 __attribute__((vector_size(32)));
+
 // clang-format off
 
 // --------------------------
@@ -97,6 +105,16 @@ __m512 TARGET_V4 loadv512(__m512* ptr) { return *ptr; }
 uint64x2_t TARGET_V1 loadv128(uint64x2_t *ptr) { return *ptr; }
 #endif
 
+// unaligned, e.g. for inline memcpy
+#ifdef __x86_64__
+__m128 TARGET_V1 loadv128u(void* ptr) { return _mm_loadu_ps(ptr); }
+__m256 TARGET_V3 loadv256u(void* ptr) { return _mm256_loadu_ps(ptr); }
+#endif
+
+#ifdef __aarch64__
+uint64x2_t TARGET_V1 loadv128u(void *ptr) { uint64x2_t v; __builtin_memcpy(&v, ptr, 16); return v; }
+#endif
+
 // llvm.load.relative intrinsic
 u8* loadreli64(u8 *ptr, i64 off) { return &ptr[*(i32 *)(ptr + off)]; }
 
@@ -129,6 +147,15 @@ void TARGET_V4 storev512(__m512* ptr, __m512 value) { *ptr = value; }
 void TARGET_V1 storev128(uint64x2_t *ptr, uint64x2_t value) { *ptr = value; }
 #endif
 
+#ifdef __x86_64__
+void TARGET_V1 storev128u(void* ptr, __m128 value) { _mm_storeu_ps(ptr, value); }
+void TARGET_V3 storev256u(void* ptr, __m256 value) { _mm256_storeu_ps(ptr, value); }
+#endif
+
+#ifdef __aarch64__
+void TARGET_V1 storev128u(void *ptr, uint64x2_t value) { __builtin_memcpy(ptr, &value, 16); }
+#endif
+
 // --------------------------
 // integer arithmetic
 // --------------------------
@@ -178,6 +205,24 @@ u128 TARGET_V1 shri128(u128 a, u128 b) { return (a >> b); }
 i128 TARGET_V1 ashri128(i128 a, i128 b) { return (a >> b); }
 u128 TARGET_V1 absi128(i128 a) { return a < 0 ? -(u128)a : a; }
 
+// Building blocks for multiplication/division by constants
+u32 TARGET_V1 mul3i32(u32 a) { return a * 3; }
+u32 TARGET_V1 mul5i32(u32 a) { return a * 5; }
+u32 TARGET_V1 mul9i32(u32 a) { return a * 9; }
+u64 TARGET_V1 mul3i64(u64 a) { return a * 3; }
+u64 TARGET_V1 mul5i64(u64 a) { return a * 5; }
+u64 TARGET_V1 mul9i64(u64 a) { return a * 9; }
+u32 TARGET_V1 umulhi32(u32 a, u32 b) { return ((u64)a * b) >> 32; }
+i32 TARGET_V1 smulhi32(i32 a, i32 b) { return ((i64)a * b) >> 32; }
+u64 TARGET_V1 umulhi64(u64 a, u64 b) { return ((u128)a * b) >> 64; }
+i64 TARGET_V1 smulhi64(i64 a, i64 b) { return ((i128)a * b) >> 64; }
+// q = umulh(a, magic) for divisors with a 33/65-bit magic number
+u32 TARGET_V1 udivnpqi32(u32 a, u32 q) { return ((a - q) >> 1) + q; }
+u64 TARGET_V1 udivnpqi64(u64 a, u64 q) { return ((a - q) >> 1) + q; }
+// Round quotient towards zero
+i32 TARGET_V1 sdivfixupi32(i32 q) { return q + ((u32)q >> 31); }
+i64 TARGET_V1 sdivfixupi64(i64 q) { return q + ((u64)q >> 63); }
+
 // For better codegen when shifting by immediates
 u128 TARGET_V1 shli128_lt64(u128 a, u64 amt, u64 iamt) {
     u64 lo = (u64)a << amt;
@@ -460,6 +505,51 @@ v2f64 TARGET_V1 subv2f64(v2f64 a, v2f64 b) { return (a - b); }
 v2f64 TARGET_V1 mulv2f64(v2f64 a, v2f64 b) { return (a * b); }
 v2f64 TARGET_V1 divv2f64(v2f64 a, v2f64 b) { return (a / b); }
 
+#ifdef __x86_64__
+// --------------------------
+// 256-bit vector arithmetic
+// --------------------------
+
+// Only operations that map to a single AVX/AVX2 instruction.
+v32u8 TARGET_V3 addv32u8(v32u8 a, v32u8 b) { return (a + b); }
+v32u8 TARGET_V3 subv32u8(v32u8 a, v32u8 b) { return (a - b); }
+v32u8 TARGET_V3 andv32u8(v32u8 a, v32u8 b) { return (a & b); }
+v32u8 TARGET_V3 xorv32u8(v32u8 a, v32u8 b) { return (a ^ b); }
+v32u8 TARGET_V3 orv32u8(v32u8 a, v32u8 b) { return (a | b); }
+v16u16 TARGET_V3 addv16u16(v16u16 a, v16u16 b) { return (a + b); }
+v16u16 TARGET_V3 subv16u16(v16u16 a, v16u16 b) { return (a - b); }
+v16u16 TARGET_V3 mulv16u16(v16u16 a, v16u16 b) { return (a * b); }
+v16u16 TARGET_V3 andv16u16(v16u16 a, v16u16 b) { return (a & b); }
+v16u16 TARGET_V3 xorv16u16(v16u16 a, v16u16 b) { return (a ^ b); }
+v16u16 TARGET_V3 orv16u16(v16u16 a, v16u16 b) { return (a | b); }
+v8u32 TARGET_V3 addv8u32(v8u32 a, v8u32 b) { return (a + b); }
+v8u32 TARGET_V3 subv8u32(v8u32 a, v8u32 b) { return (a - b); }
+v8u32 TARGET_V3 mulv8u32(v8u32 a, v8u32 b) { return (a * b); }
+v8u32 TARGET_V3 andv8u32(v8u32 a, v8u32 b) { return (a & b); }
+v8u32 TARGET_V3 xorv8u32(v8u32 a, v8u32 b) { return (a ^ b); }
+v8u32 TARGET_V3 orv8u32(v8u32 a, v8u32 b) { return (a | b); }
+v8u32 TARGET_V3 shlv8u32(v8u32 a, v8u32 b) { return (a << b); }
+v8u32 TARGET_V3 lshrv8u32(v8u32 a, v8u32 b) { return (a >> b); }
+v8i32 TARGET_V3 ashrv8i32(v8i32 a, v8i32 b) { return (a >> b); }
+v4u64 TARGET_V3 addv4u64(v4u64 a, v4u64 b) { return (a + b); }
+v4u64 TARGET_V3 subv4u64(v4u64 a, v4u64 b) { return (a - b); }
+v4u64 TARGET_V3 andv4u64(v4u64 a, v4u64 b) { return (a & b); }
+v4u64 TARGET_V3 xorv4u64(v4u64 a, v4u64 b) { return (a ^ b); }
+v4u64 TARGET_V3 orv4u64(v4u64 a, v4u64 b) { return (a | b); }
+v4u64 TARGET_V3 shlv4u64(v4u64 a, v4u64 b) { return (a << b); }
+v4u64 TARGET_V3 lshrv4u64(v4u64 a, v4u64 b) { return (a >> b); }
+
+v8f32 TARGET_V3 addv8f32(v8f32 a, v8f32 b) { return (a + b); }
+v8f32 TARGET_V3 subv8f32(v8f32 a, v8f32 b) { return (a - b); }
+v8f32 TARGET_V3 mulv8f32(v8f32 a, v8f32 b) { return (a * b); }
+v8f32 TARGET_V3 divv8f32(v8f32 a, v8f32 b) { return (a / b); }
+
+v4f64 TARGET_V3 addv4f64(v4f64 a, v4f64 b) { return (a + b); }
+v4f64 TARGET_V3 subv4f64(v4f64 a, v4f64 b) { return (a - b); }
+v4f64 TARGET_V3 mulv4f64(v4f64 a, v4f64 b) { return (a * b); }
+v4f64 TARGET_V3 divv4f64(v4f64 a, v4f64 b) { return (a / b); }
+#endif
+
 float TARGET_V1 fnegf32(float a) { return (-a); }
 double TARGET_V1 fnegf64(double a) { return (-a); }
 fp128 TARGET_V1 fnegf128(fp128 a) { return -a; }
@@ -480,6 +570,24 @@ double TARGET_V1 copysignf64(double a, double b) { return __builtin_copysign(a,
 float TARGET_V1 sqrtf32(float a) { return __builtin_sqrtf(a); }
 double TARGET_V1 sqrtf64(double a) { return __builtin_sqrt(a); }
 
+// On x86-64, these need SSE4.1 (ROUNDSS/ROUNDSD) and are only used with it.
+#ifdef __x86_64__
+  #define TARGET_ROUND TARGET_V2
+#else
+  #define TARGET_ROUND TARGET_V1
+#endif
+float TARGET_ROUND floorf32(float a) { return __builtin_floorf(a); }
+double TARGET_ROUND floorf64(double a) { return __builtin_floor(a); }
+float TARGET_ROUND ceilf32(float a) { return __builtin_ceilf(a); }
+double TARGET_ROUND ceilf64(double a) { return __builtin_ceil(a); }
+float TARGET_ROUND truncf32(float a) { return __builtin_truncf(a); }
+double TARGET_ROUND truncf64(double a) { return __builtin_trunc(a); }
+float TARGET_ROUND rintf32(float a) { return __builtin_rintf(a); }
+double TARGET_ROUND rintf64(double a) { return __builtin_rint(a); }
+float TARGET_ROUND roundf32(float a) { return __builtin_roundf(a); }
+double TARGET_ROUND roundf64(double a) { return __builtin_round(a); }
+#undef TARGET_ROUND
+
 float TARGET_V1 minnumf32(float a, float b) { return __builtin_fminf(a, b); }
 double TARGET_V1 minnumf64(double a, double b) { return __builtin_fmin(a, b); }
 float TARGET_V1 maxnumf32(float a, float b) { return __builtin_fmaxf(a, b); }
@@ -683,6 +791,9 @@ i128 TARGET_V1 select_i128(u8 cond, i128 val1, i128 val2) { return ((cond & 1) ?
 float TARGET_V1 select_f32(u8 cond, float val1, float val2) { return ((cond & 1) ? val1 : val2); }
 double TARGET_V1 select_f64(u8 cond, double val1, double val2) { return ((cond & 1) ? val1 : val2); }
 v2u64 TARGET_V1 select_v2u64(u8 cond, v2u64 val1, v2u64 val2) { return ((cond & 1) ? val1 : val2); }
+#ifdef __x86_64__
+v4u64 TARGET_V3 select_v4u64(u8 cond, v4u64 val1, v4u64 val2) { return ((cond & 1) ? val1 : val2); }
+#endif
 
 // --------------------------
 // float comparisons
@@ -2,6 +2,8 @@
 //
 // SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
 
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
 #include <llvm/IR/InlineAsm.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/Intrinsics.h>
@@ -58,9 +60,13 @@ struct LLVMCompilerX64 : tpde::x64::CompilerX64<LLVMAdaptor,
   static constexpr std::array<AsmReg, 2> LANDING_PAD_RES_REGS = {AsmReg::AX,
                                                                  AsmReg::DX};
 
-  explicit LLVMCompilerX64(std::unique_ptr<LLVMAdaptor> &&adaptor)
-      : Base{adaptor.get()}, adaptor(std::move(adaptor)) {
+  explicit LLVMCompilerX64(std::unique_ptr<LLVMAdaptor> &&adaptor,
+                           CPU_FEATURES cpu_features = CPU_BASELINE)
+      : Base{adaptor.get(), cpu_features}, adaptor(std::move(adaptor)) {
     static_assert(tpde::Compiler<LLVMCompilerX64, tpde::x64::PlatformConfig>);
+    // With AVX, 256-bit vectors are passed in YMM registers, so keep them in a
+    // single register instead of rejecting them.
+    this->adaptor->vec256_legal = has_cpu_feats(CPU_AVX);
   }
 
   void reset() noexcept {
@@ -80,6 +86,16 @@ struct LLVMCompilerX64 : tpde::x64::CompilerX64<LLVMAdaptor,
     return !arg_is_int128(val_idx);
   }
 
+  bool use_short_jumps() const noexcept { return this->short_jumps; }
+
+  bool cur_func_uses_ymm() const noexcept {
+    return this->adaptor->cur_has_v256();
+  }
+
+  bool may_omit_leaf_frame_pointer() const noexcept {
+    return this->omit_leaf_frame_pointer;
+  }
+
   void finish_func(u32 func_idx) noexcept;
 
   void load_address_of_var_reference(AsmReg dst,
@@ -88,16 +104,14 @@ struct LLVMCompilerX64 : tpde::x64::CompilerX64<LLVMAdaptor,
   std::optional<CallBuilder>
       create_call_builder(const llvm::CallBase * = nullptr) noexcept;
 
-  bool compile_unreachable(const llvm::Instruction *,
-                           const ValInfo &,
-                           u64) noexcept;
-  bool compile_alloca(const llvm::Instruction *, const ValInfo &, u64) noexcept;
-  bool compile_br(const llvm::Instruction *, const ValInfo &, u64) noexcept;
+  bool compile_unreachable(const llvm::Instruction *, u64) noexcept;
+  bool compile_alloca(const llvm::Instruction *, u64) noexcept;
+  bool compile_br(const llvm::Instruction *, u64) noexcept;
   void generate_conditional_branch(Jump jmp,
                                    IRBlockRef true_target,
                                    IRBlockRef false_target) noexcept;
   bool compile_inline_asm(const llvm::CallBase *) noexcept;
-  bool compile_icmp(const llvm::Instruction *, const ValInfo &, u64) noexcept;
+  bool compile_icmp(const llvm::Instruction *, u64) noexcept;
   void compile_i32_cmp_zero(AsmReg reg, llvm::CmpInst::Predicate p) noexcept;
 
   GenericValuePart create_addr_for_alloca(tpde::AssignmentPartRef ap) noexcept;
@@ -118,6 +132,14 @@ struct LLVMCompilerX64 : tpde::x64::CompilerX64<LLVMAdaptor,
                               u64 low_bound,
                               u64 high_bound,
                               bool width_is_32) noexcept;
+  bool switch_emit_bit_tests(
+      Label default_label,
+      std::span<const std::pair<u64, Label>> tests,
+      AsmReg cmp_reg,
+      AsmReg tmp_reg,
+      u64 low_bound,
+      u64 high_bound,
+      bool width_is_32) noexcept;
   void switch_emit_binary_step(Label case_label,
                                Label gt_label,
                                AsmReg cmp_reg,
@@ -129,6 +151,54 @@ struct LLVMCompilerX64 : tpde::x64::CompilerX64<LLVMAdaptor,
                           ValueRef *result,
                           SymRef sym) noexcept;
 
+  // Use POPCNT/LZCNT if available, the snippets only use baseline x86-64.
+  bool encode_ctpopi32(GenericValuePart &&val, ScratchReg &res) noexcept;
+  bool encode_ctpopi64(GenericValuePart &&val, ScratchReg &res) noexcept;
+  bool encode_ctlzi32(GenericValuePart &&val, ScratchReg &res) noexcept;
+  bool encode_ctlzi64(GenericValuePart &&val, ScratchReg &res) noexcept;
+  bool encode_ctlzi32_zero_poison(GenericValuePart &&val,
+                                  ScratchReg &res) noexcept {
+    if (!has_cpu_feats(CPU_LZCNT)) {
+      return EncCompiler::encode_ctlzi32_zero_poison(std::move(val), res);
+    }
+    return encode_ctlzi32(std::move(val), res);
+  }
+  bool encode_ctlzi64_zero_poison(GenericValuePart &&val,
+                                  ScratchReg &res) noexcept {
+    if (!has_cpu_feats(CPU_LZCNT)) {
+      return EncCompiler::encode_ctlzi64_zero_poison(std::move(val), res);
+    }
+    return encode_ctlzi64(std::move(val), res);
+  }
+
+  bool load_v256(GenericValuePart &&addr, ScratchReg &res) noexcept {
+    return encode_loadv256u(std::move(addr), res);
+  }
+  bool store_v256(GenericValuePart &&addr, GenericValuePart &&val) noexcept {
+    return encode_storev256u(std::move(addr), std::move(val));
+  }
+  bool int_binary_op_v256(IntBinaryOp op,
+                          unsigned el_width,
+                          GenericValuePart &&lhs,
+                          GenericValuePart &&rhs,
+                          ScratchReg &res) noexcept;
+  bool float_binary_op_v256(FloatBinaryOp op,
+                            bool is_double,
+                            GenericValuePart &&lhs,
+                            GenericValuePart &&rhs,
+                            ScratchReg &res) noexcept;
+  bool select_v256(GenericValuePart &&cond,
+                   GenericValuePart &&lhs,
+                   GenericValuePart &&rhs,
+                   ScratchReg &res) noexcept {
+    return encode_select_v4u64(
+        std::move(cond), std::move(lhs), std::move(rhs), res);
+  }
+
+  bool has_native_fp_rounding() const noexcept {
+    return has_cpu_feats(CPU_SSE4_1);
+  }
+
   bool handle_intrin(const llvm::IntrinsicInst *) noexcept;
 
   bool handle_overflow_intrin_128(OverflowOp op,
@@ -201,7 +271,6 @@ std::optional<LLVMCompilerX64::CallBuilder>
 }
 
 bool LLVMCompilerX64::compile_unreachable(const llvm::Instruction *,
-                                          const ValInfo &,
                                           u64) noexcept {
   ASM(UD2);
   this->release_regs_after_return();
@@ -209,7 +278,6 @@ bool LLVMCompilerX64::compile_unreachable(const llvm::Instruction *,
 }
 
 bool LLVMCompilerX64::compile_alloca(const llvm::Instruction *inst,
-                                     const ValInfo &,
                                      u64) noexcept {
   const auto *alloca = llvm::cast<llvm::AllocaInst>(inst);
   assert(this->adaptor->cur_has_dynamic_alloca());
@@ -296,9 +364,7 @@ bool LLVMCompilerX64::compile_alloca(const llvm::Instruction *inst,
   return true;
 }
 
-bool LLVMCompilerX64::compile_br(const llvm::Instruction *inst,
-                                 const ValInfo &,
-                                 u64) noexcept {
+bool LLVMCompilerX64::compile_br(const llvm::Instruction *inst, u64) noexcept {
   const auto *br = llvm::cast<llvm::BranchInst>(inst);
   if (br->isUnconditional()) {
     auto spilled = this->spill_before_branch();
@@ -354,6 +420,135 @@ void LLVMCompilerX64::generate_conditional_branch(
   this->release_spilled_regs(spilled);
 }
 
+bool LLVMCompilerX64::encode_ctpopi32(GenericValuePart &&val,
+                                      ScratchReg &res) noexcept {
+  if (!has_cpu_feats(CPU_POPCNT)) {
+    return EncCompiler::encode_ctpopi32(std::move(val), res);
+  }
+  AsmReg src_reg = gval_as_reg_reuse(val, res);
+  AsmReg res_reg = res.alloc_gp();
+  ASM(POPCNT32rr, res_reg, src_reg);
+  return true;
+}
+
+bool LLVMCompilerX64::encode_ctpopi64(GenericValuePart &&val,
+                                      ScratchReg &res) noexcept {
+  if (!has_cpu_feats(CPU_POPCNT)) {
+    return EncCompiler::encode_ctpopi64(std::move(val), res);
+  }
+  AsmReg src_reg = gval_as_reg_reuse(val, res);
+  AsmReg res_reg = res.alloc_gp();
+  ASM(POPCNT64rr, res_reg, src_reg);
+  return true;
+}
+
+bool LLVMCompilerX64::encode_ctlzi32(GenericValuePart &&val,
+                                     ScratchReg &res) noexcept {
+  if (!has_cpu_feats(CPU_LZCNT)) {
+    return EncCompiler::encode_ctlzi32(std::move(val), res);
+  }
+  AsmReg src_reg = gval_as_reg_reuse(val, res);
+  AsmReg res_reg = res.alloc_gp();
+  ASM(LZCNT32rr, res_reg, src_reg);
+  return true;
+}
+
+bool LLVMCompilerX64::encode_ctlzi64(GenericValuePart &&val,
+                                     ScratchReg &res) noexcept {
+  if (!has_cpu_feats(CPU_LZCNT)) {
+    return EncCompiler::encode_ctlzi64(std::move(val), res);
+  }
+  AsmReg src_reg = gval_as_reg_reuse(val, res);
+  AsmReg res_reg = res.alloc_gp();
+  ASM(LZCNT64rr, res_reg, src_reg);
+  return true;
+}
+
+bool LLVMCompilerX64::int_binary_op_v256(IntBinaryOp op,
+                                         unsigned el_width,
+                                         GenericValuePart &&lhs,
+                                         GenericValuePart &&rhs,
+                                         ScratchReg &res) noexcept {
+  // 256-bit integer operations require AVX2.
+  if (!has_cpu_feats(CPU_AVX2)) {
+    return false;
+  }
+
+  using EncodeFnTy = bool (LLVMCompilerX64::*)(
+      GenericValuePart &&, GenericValuePart &&, ScratchReg &);
+  // fns[op.index()][8=0/16=1/32=2/64=3]
+  static constexpr auto fns = []() constexpr {
+    std::array<EncodeFnTy[4], IntBinaryOp::num_ops> tbl{};
+    auto entry = [&tbl](IntBinaryOp op) { return tbl[op.index()]; };
+
+    entry(IntBinaryOp::add)[0] = &LLVMCompilerX64::encode_addv32u8;
+    entry(IntBinaryOp::add)[1] = &LLVMCompilerX64::encode_addv16u16;
+    entry(IntBinaryOp::add)[2] = &LLVMCompilerX64::encode_addv8u32;
+    entry(IntBinaryOp::add)[3] = &LLVMCompilerX64::encode_addv4u64;
+    entry(IntBinaryOp::sub)[0] = &LLVMCompilerX64::encode_subv32u8;
+    entry(IntBinaryOp::sub)[1] = &LLVMCompilerX64::encode_subv16u16;
+    entry(IntBinaryOp::sub)[2] = &LLVMCompilerX64::encode_subv8u32;
+    entry(IntBinaryOp::sub)[3] = &LLVMCompilerX64::encode_subv4u64;
+    entry(IntBinaryOp::mul)[1] = &LLVMCompilerX64::encode_mulv16u16;
+    entry(IntBinaryOp::mul)[2] = &LLVMCompilerX64::encode_mulv8u32;
+    entry(IntBinaryOp::land)[0] = &LLVMCompilerX64::encode_andv32u8;
+    entry(IntBinaryOp::land)[1] = &LLVMCompilerX64::encode_andv16u16;
+    entry(IntBinaryOp::land)[2] = &LLVMCompilerX64::encode_andv8u32;
+    entry(IntBinaryOp::land)[3] = &LLVMCompilerX64::encode_andv4u64;
+    entry(IntBinaryOp::lxor)[0] = &LLVMCompilerX64::encode_xorv32u8;
+    entry(IntBinaryOp::lxor)[1] = &LLVMCompilerX64::encode_xorv16u16;
+    entry(IntBinaryOp::lxor)[2] = &LLVMCompilerX64::encode_xorv8u32;
+    entry(IntBinaryOp::lxor)[3] = &LLVMCompilerX64::encode_xorv4u64;
+    entry(IntBinaryOp::lor)[0] = &LLVMCompilerX64::encode_orv32u8;
+    entry(IntBinaryOp::lor)[1] = &LLVMCompilerX64::encode_orv16u16;
+    entry(IntBinaryOp::lor)[2] = &LLVMCompilerX64::encode_orv8u32;
+    entry(IntBinaryOp::lor)[3] = &LLVMCompilerX64::encode_orv4u64;
+    entry(IntBinaryOp::shl)[2] = &LLVMCompilerX64::encode_shlv8u32;
+    entry(IntBinaryOp::shl)[3] = &LLVMCompilerX64::encode_shlv4u64;
+    entry(IntBinaryOp::shr)[2] = &LLVMCompilerX64::encode_lshrv8u32;
+    entry(IntBinaryOp::shr)[3] = &LLVMCompilerX64::encode_lshrv4u64;
+    entry(IntBinaryOp::ashr)[2] = &LLVMCompilerX64::encode_ashrv8i32;
+    return tbl;
+  }();
+
+  unsigned width_idx;
+  switch (el_width) {
+  case 8: width_idx = 0; break;
+  case 16: width_idx = 1; break;
+  case 32: width_idx = 2; break;
+  case 64: width_idx = 3; break;
+  default: return false;
+  }
+
+  EncodeFnTy encode_fn = fns[op.index()][width_idx];
+  if (!encode_fn) {
+    return false;
+  }
+  return (this->*encode_fn)(std::move(lhs), std::move(rhs), res);
+}
+
+bool LLVMCompilerX64::float_binary_op_v256(FloatBinaryOp op,
+                                           bool is_double,
+                                           GenericValuePart &&lhs,
+                                           GenericValuePart &&rhs,
+                                           ScratchReg &res) noexcept {
+  switch (op) {
+  case FloatBinaryOp::add:
+    return is_double ? encode_addv4f64(std::move(lhs), std::move(rhs), res)
+                     : encode_addv8f32(std::move(lhs), std::move(rhs), res);
+  case FloatBinaryOp::sub:
+    return is_double ? encode_subv4f64(std::move(lhs), std::move(rhs), res)
+                     : encode_subv8f32(std::move(lhs), std::move(rhs), res);
+  case FloatBinaryOp::mul:
+    return is_double ? encode_mulv4f64(std::move(lhs), std::move(rhs), res)
+                     : encode_mulv8f32(std::move(lhs), std::move(rhs), res);
+  case FloatBinaryOp::div:
+    return is_double ? encode_divv4f64(std::move(lhs), std::move(rhs), res)
+                     : encode_divv8f32(std::move(lhs), std::move(rhs), res);
+  default: return false;
+  }
+}
+
 bool LLVMCompilerX64::compile_inline_asm(const llvm::CallBase *call) noexcept {
   auto inline_asm = llvm::cast<llvm::InlineAsm>(call->getCalledOperand());
   // TODO: handle inline assembly that actually does something
@@ -379,7 +574,6 @@ bool LLVMCompilerX64::compile_inline_asm(const llvm::CallBase *call) noexcept {
 }
 
 bool LLVMCompilerX64::compile_icmp(const llvm::Instruction *inst,
-                                   const ValInfo &,
                                    u64) noexcept {
   const auto *cmp = llvm::cast<llvm::ICmpInst>(inst);
   auto *cmp_ty = cmp->getOperand(0)->getType();
@@ -421,7 +615,7 @@ bool LLVMCompilerX64::compile_icmp(const llvm::Instruction *inst,
   const llvm::BranchInst *fuse_br = nullptr;
   const llvm::Instruction *fuse_ext = nullptr;
   if (!cmp->user_empty() && *cmp->user_begin() == cmp->getNextNode() &&
-      (analyzer.liveness_info(val_idx(cmp)).ref_count <= 2)) {
+      (analyzer.liveness_ref_count(val_idx(cmp)) <= 2)) {
     auto *fuse_inst = cmp->getNextNode();
     assert(cmp->hasNUses(1));
     if (auto *br = llvm::dyn_cast<llvm::BranchInst>(fuse_inst)) {
@@ -553,7 +747,8 @@ void LLVMCompilerX64::compile_i32_cmp_zero(
 
 LLVMCompilerX64::GenericValuePart LLVMCompilerX64::create_addr_for_alloca(
     tpde::AssignmentPartRef ap) noexcept {
-  return GenericValuePart::Expr{AsmReg::BP, ap.variable_stack_off()};
+  auto [base, disp] = frame_addr(ap.variable_stack_off());
+  return GenericValuePart::Expr{base, disp};
 }
 
 void LLVMCompilerX64::switch_emit_cmp(const AsmReg cmp_reg,
@@ -618,12 +813,14 @@ bool LLVMCompilerX64::switch_emit_jump_table(Label default_label,
       text_writer.get_sec_ref(),
       text_writer.offset() - 4,
       Assembler::UnresolvedEntryKind::JMP_OR_MEM_DISP);
+  assembler.relax_add_pcrel_disp(text_writer.offset() - 4);
   // load the 4 byte displacement from the jump table
   ASM(MOVSXr64m32, cmp_reg, FE_MEM(tmp_reg, 4, cmp_reg, 0));
   ASM(ADD64rr, tmp_reg, cmp_reg);
   ASM(JMPr, tmp_reg);
 
   auto sec_ref = text_writer.get_sec_ref();
+  assembler.relax_add_align(text_writer.offset(), 4);
   text_writer.align(4);
   text_writer.ensure_space(4 + 4 * labels.size());
   label_place(jump_table);
@@ -641,6 +838,44 @@ bool LLVMCompilerX64::switch_emit_jump_table(Label default_label,
       text_writer.write<i32>((i32)label_off - (i32)table_off);
     }
   }
+  assembler.relax_add_jump_table(table_off, labels.size());
+  return true;
+}
+
+bool LLVMCompilerX64::switch_emit_bit_tests(
+    Label default_label,
+    std::span<const std::pair<u64, Label>> tests,
+    AsmReg cmp_reg,
+    AsmReg tmp_reg,
+    u64 low_bound,
+    u64 high_bound,
+    bool width_is_32) noexcept {
+  // NB: we must not evict any registers here. cmp_reg is not used after this
+  // point, so we can turn it into the bit index.
+  if (low_bound != 0) {
+    if (width_is_32) {
+      ASM(SUB32ri, cmp_reg, low_bound);
+    } else if ((i64)((i32)low_bound) == (i64)low_bound) {
+      ASM(SUB64ri, cmp_reg, low_bound);
+    } else {
+      ValuePartRef const_ref{this, &low_bound, 8, CompilerConfig::GP_BANK};
+      ASM(SUB64rr, cmp_reg, const_ref.reload_into_specific_fixed(tmp_reg));
+    }
+  }
+  switch_emit_cmp(cmp_reg, tmp_reg, high_bound - low_bound, width_is_32);
+  generate_raw_jump(Jump::ja, default_label);
+
+  // BT with a register offset uses the offset modulo 64, so the upper half of
+  // cmp_reg doesn't matter for 32-bit values.
+  for (const auto &[mask, label] : tests) {
+    if (mask <= 0xffff'ffff) {
+      ASM(MOV32ri, tmp_reg, mask);
+    } else {
+      ASM(MOV64ri, tmp_reg, mask);
+    }
+    ASM(BT64rr, tmp_reg, cmp_reg);
+    generate_raw_jump(Jump::jb, label);
+  }
   return true;
 }
 
@@ -801,15 +1036,47 @@ bool LLVMCompilerX64::handle_overflow_intrin_128(OverflowOp op,
 }
 
 std::unique_ptr<LLVMCompiler>
-    create_compiler(const llvm::Triple &triple) noexcept {
+    create_compiler(const llvm::Triple &triple,
+                    const llvm::StringMap<bool> &features) noexcept {
   if (!triple.isOSBinFormatELF()) {
     return nullptr;
   }
 
+  using CPU_FEATURES = LLVMCompilerX64::CPU_FEATURES;
+  using FeatureName = std::pair<llvm::StringLiteral, CPU_FEATURES>;
+  static constexpr FeatureName feature_names[] = {
+      {"cx16", LLVMCompilerX64::CPU_CMPXCHG16B},
+      {"popcnt", LLVMCompilerX64::CPU_POPCNT},
+      {"sse3", LLVMCompilerX64::CPU_SSE3},
+      {"ssse3", LLVMCompilerX64::CPU_SSSE3},
+      {"sse4.1", LLVMCompilerX64::CPU_SSE4_1},
+      {"sse4.2", LLVMCompilerX64::CPU_SSE4_2},
+      {"avx", LLVMCompilerX64::CPU_AVX},
+      {"avx2", LLVMCompilerX64::CPU_AVX2},
+      {"bmi", LLVMCompilerX64::CPU_BMI1},
+      {"bmi2", LLVMCompilerX64::CPU_BMI2},
+      {"f16c", LLVMCompilerX64::CPU_F16C},
+      {"fma", LLVMCompilerX64::CPU_FMA},
+      {"lzcnt", LLVMCompilerX64::CPU_LZCNT},
+      {"movbe", LLVMCompilerX64::CPU_MOVBE},
+      {"avx512f", LLVMCompilerX64::CPU_AVX512F},
+      {"avx512bw", LLVMCompilerX64::CPU_AVX512BW},
+      {"avx512cd", LLVMCompilerX64::CPU_AVX512CD},
+      {"avx512dq", LLVMCompilerX64::CPU_AVX512DQ},
+      {"avx512vl", LLVMCompilerX64::CPU_AVX512VL},
+  };
+  u32 cpu_features = LLVMCompilerX64::CPU_BASELINE;
+  for (const auto &[name, feature] : feature_names) {
+    if (features.lookup(name)) {
+      cpu_features |= feature;
+    }
+  }
+
   llvm::StringRef dl_str = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64"
                            "-i128:128-f80:128-n8:16:32:64-S128";
   auto adaptor = std::make_unique<LLVMAdaptor>(llvm::DataLayout(dl_str));
-  return std::make_unique<LLVMCompilerX64>(std::move(adaptor));
+  return std::make_unique<LLVMCompilerX64>(std::move(adaptor),
+                                           CPU_FEATURES(cpu_features));
 }
 
 } // namespace tpde_llvm::x64
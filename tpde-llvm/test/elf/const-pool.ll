@@ -0,0 +1,27 @@
+; NOTE: Do not autogenerate
+; SPDX-FileCopyrightText: 2025 Contributors to TPDE <https://tpde.org>
+; SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+; RUN: tpde-llc --target=x86_64 < %s | llvm-readelf -s - | FileCheck %s
+; RUN: tpde-llc --target=aarch64 < %s | llvm-readelf -s - | FileCheck %s
+
+; Identical constants share one symbol in .rodata.
+; CHECK: Symbol table '.symtab'
+; CHECK-COUNT-2: 16 OBJECT LOCAL DEFAULT
+; CHECK-NOT: OBJECT LOCAL
+
+define <4 x i32> @const1() {
+  ret <4 x i32> <i32 1, i32 2, i32 3, i32 4>
+}
+
+define <4 x i32> @const2() {
+  ret <4 x i32> <i32 1, i32 2, i32 3, i32 4>
+}
+
+define <4 x i32> @const3() {
+  ret <4 x i32> <i32 5, i32 6, i32 7, i32 8>
+}
+
+define <4 x i32> @const4() {
+  ret <4 x i32> <i32 5, i32 6, i32 7, i32 8>
+}
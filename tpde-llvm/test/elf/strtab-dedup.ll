@@ -0,0 +1,28 @@
+; NOTE: Do not autogenerate
+; SPDX-FileCopyrightText: 2025 Contributors to TPDE <https://tpde.org>
+; SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+; RUN: tpde-llc --target=x86_64 < %s | llvm-readelf -S -p .shstrtab - | FileCheck %s
+; RUN: tpde-llc --target=aarch64 < %s | llvm-readelf -S -p .shstrtab - | FileCheck %s
+
+; Sections with the same name share a single .shstrtab entry, and the name
+; without .rela is a suffix of the relocation section's name.
+
+; CHECK: Section Headers:
+; CHECK-COUNT-3: ] sec1 PROGBITS
+; CHECK: String dump of section '.shstrtab':
+; CHECK: .rela.sec1
+; CHECK-NOT: sec1
+
+define void @f1() section "sec1" {
+  ret void
+}
+
+define void @f2() section "sec1" {
+  call void @f1()
+  ret void
+}
+
+define void @f3() section "sec1" {
+  ret void
+}
@@ -0,0 +1,47 @@
+; NOTE: Do not autogenerate
+; SPDX-FileCopyrightText: 2025 Contributors to TPDE <https://tpde.org>
+; SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+; RUN: tpde-llc --target=aarch64 --arm64-jump-tables %s | %objdump | FileCheck %s
+; RUN: tpde-llc --target=aarch64 %s | %objdump | FileCheck %s -check-prefix=NOTABLE
+
+; Dense switches branch through a table of 32-bit offsets that directly
+; follows the indirect branch.
+
+define i32 @switch_table(i32 %0) {
+; CHECK-LABEL: <switch_table>:
+; CHECK: cmp {{.*}}, #0x6
+; CHECK-NEXT: b.hi
+; CHECK-NEXT: mov {{w[0-9]+}}, {{w[0-9]+}}
+; CHECK-NEXT: adr [[TAB:x[0-9]+]], 0x{{[0-9a-f]+}}
+; CHECK-NEXT: add [[ENT:x[0-9]+]], [[TAB]], {{x[0-9]+}}, lsl #2
+; CHECK-NEXT: ldrsw [[ENT]], {{\[}}[[ENT]]{{\]}}
+; CHECK-NEXT: add [[TAB]], [[TAB]], [[ENT]]
+; CHECK-NEXT: br [[TAB]]
+; CHECK-NEXT: udf #0x{{[0-9a-f]+}}
+; NOTABLE-LABEL: <switch_table>:
+; NOTABLE-NOT: br x
+; NOTABLE: ret
+entry:
+  switch i32 %0, label %default [
+    i32 0, label %eq0
+    i32 1, label %eq1
+    i32 2, label %eq2
+    i32 4, label %eq4
+    i32 5, label %eq5
+    i32 6, label %eq6]
+eq0:
+  ret i32 0
+eq1:
+  ret i32 1
+eq2:
+  ret i32 2
+eq4:
+  ret i32 4
+eq5:
+  ret i32 5
+eq6:
+  ret i32 6
+default:
+  ret i32 -1
+}
@@ -0,0 +1,49 @@
+; NOTE: Do not autogenerate
+; SPDX-FileCopyrightText: 2025 Contributors to TPDE <https://tpde.org>
+; SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+; RUN: tpde-llc --target=x86_64 %s | %objdump | FileCheck %s -check-prefixes=CHECK,BASE
+; RUN: tpde-llc --target=x86_64 --mattr=+popcnt,+lzcnt %s | %objdump | FileCheck %s -check-prefixes=CHECK,FEAT
+; RUN: tpde-llc --target=x86_64 --mcpu=x86-64-v3 %s | %objdump | FileCheck %s -check-prefixes=CHECK,FEAT
+; RUN: tpde-llc --target=x86_64 --mcpu=x86-64-v3 --mattr=-popcnt,-lzcnt %s | %objdump | FileCheck %s -check-prefixes=CHECK,BASE
+; RUN: not tpde-llc --target=x86_64 --mcpu=no-such-cpu %s 2>&1 | FileCheck %s -check-prefix=ERR
+; RUN: not tpde-llc --target=x86_64 --mattr=popcnt %s 2>&1 | FileCheck %s -check-prefix=ERR
+
+; ERR: Unknown architecture, CPU, or features
+
+define i32 @ctpop_i32(i32 %a) {
+; CHECK-LABEL: <ctpop_i32>:
+; BASE-NOT: popcnt
+; FEAT: popcnt
+  %r = call i32 @llvm.ctpop.i32(i32 %a)
+  ret i32 %r
+}
+
+define i64 @ctpop_i64(i64 %a) {
+; CHECK-LABEL: <ctpop_i64>:
+; BASE-NOT: popcnt
+; FEAT: popcnt
+  %r = call i64 @llvm.ctpop.i64(i64 %a)
+  ret i64 %r
+}
+
+define i32 @ctlz_i32(i32 %a) {
+; CHECK-LABEL: <ctlz_i32>:
+; BASE-NOT: lzcnt
+; FEAT: lzcnt
+  %r = call i32 @llvm.ctlz.i32(i32 %a, i1 false)
+  ret i32 %r
+}
+
+define i64 @ctlz_i64_zero_poison(i64 %a) {
+; CHECK-LABEL: <ctlz_i64_zero_poison>:
+; BASE-NOT: lzcnt
+; FEAT: lzcnt
+  %r = call i64 @llvm.ctlz.i64(i64 %a, i1 true)
+  ret i64 %r
+}
+
+declare i32 @llvm.ctpop.i32(i32)
+declare i64 @llvm.ctpop.i64(i64)
+declare i32 @llvm.ctlz.i32(i32, i1)
+declare i64 @llvm.ctlz.i64(i64, i1)
@@ -0,0 +1,137 @@
+; NOTE: Do not autogenerate
+; SPDX-FileCopyrightText: 2025 Contributors to TPDE <https://tpde.org>
+; SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+; RUN: tpde-llc --target=x86_64 --const-strength-reduction %s | %objdump | FileCheck %s -check-prefixes=CHECK,X64
+; RUN: tpde-llc --target=aarch64 --const-strength-reduction %s | %objdump | FileCheck %s -check-prefixes=CHECK,ARM64
+
+; Multiplication, division and remainder by constants avoid the hardware
+; divider and use shifts and multiply-high sequences instead.
+
+define i32 @mul_i32_8(i32 %a) {
+; CHECK-LABEL: <mul_i32_8>:
+; X64-NOT: imul
+; X64: shl
+; ARM64-NOT: mul
+; ARM64: lsl
+  %r = mul i32 %a, 8
+  ret i32 %r
+}
+
+define i64 @mul_i64_9(i64 %a) {
+; CHECK-LABEL: <mul_i64_9>:
+; X64-NOT: imul
+; X64: lea
+; ARM64-NOT: mul
+; ARM64: add {{.*}}lsl #3
+  %r = mul i64 %a, 9
+  ret i64 %r
+}
+
+define i32 @udiv_i32_16(i32 %a) {
+; CHECK-LABEL: <udiv_i32_16>:
+; X64-NOT: div
+; X64: shr
+; ARM64-NOT: udiv
+; ARM64: lsr
+  %r = udiv i32 %a, 16
+  ret i32 %r
+}
+
+define i32 @udiv_i32_7(i32 %a) {
+; CHECK-LABEL: <udiv_i32_7>:
+; X64-NOT: div
+; X64: imul
+; ARM64-NOT: udiv
+; ARM64: mul
+  %r = udiv i32 %a, 7
+  ret i32 %r
+}
+
+define i64 @udiv_i64_10(i64 %a) {
+; CHECK-LABEL: <udiv_i64_10>:
+; X64-NOT: div
+; X64: mul
+; ARM64-NOT: udiv
+; ARM64: umulh
+  %r = udiv i64 %a, 10
+  ret i64 %r
+}
+
+define i32 @urem_i32_64(i32 %a) {
+; CHECK-LABEL: <urem_i32_64>:
+; X64-NOT: div
+; X64: and {{.*}}0x3f
+; ARM64-NOT: udiv
+; ARM64: and
+  %r = urem i32 %a, 64
+  ret i32 %r
+}
+
+define i64 @urem_i64_1000(i64 %a) {
+; CHECK-LABEL: <urem_i64_1000>:
+; X64-NOT: div
+; X64: mul
+; ARM64-NOT: udiv
+; ARM64: umulh
+  %r = urem i64 %a, 1000
+  ret i64 %r
+}
+
+define i32 @sdiv_i32_4(i32 %a) {
+; CHECK-LABEL: <sdiv_i32_4>:
+; X64-NOT: idiv
+; X64: sar
+; ARM64-NOT: sdiv
+; ARM64: asr
+  %r = sdiv i32 %a, 4
+  ret i32 %r
+}
+
+define i32 @sdiv_i32_neg3(i32 %a) {
+; CHECK-LABEL: <sdiv_i32_neg3>:
+; X64-NOT: idiv
+; X64: imul
+; ARM64-NOT: sdiv
+; ARM64: mul
+  %r = sdiv i32 %a, -3
+  ret i32 %r
+}
+
+define i64 @sdiv_i64_7(i64 %a) {
+; CHECK-LABEL: <sdiv_i64_7>:
+; X64-NOT: idiv
+; X64: imul
+; ARM64-NOT: sdiv
+; ARM64: smulh
+  %r = sdiv i64 %a, 7
+  ret i64 %r
+}
+
+define i32 @srem_i32_8(i32 %a) {
+; CHECK-LABEL: <srem_i32_8>:
+; X64-NOT: idiv
+; X64: and {{.*}}-0x8
+; ARM64-NOT: sdiv
+; ARM64: and
+  %r = srem i32 %a, 8
+  ret i32 %r
+}
+
+define i64 @srem_i64_10(i64 %a) {
+; CHECK-LABEL: <srem_i64_10>:
+; X64-NOT: idiv
+; X64: imul
+; ARM64-NOT: sdiv
+; ARM64: smulh
+  %r = srem i64 %a, 10
+  ret i64 %r
+}
+
+define i32 @udiv_i32_var(i32 %a, i32 %b) {
+; CHECK-LABEL: <udiv_i32_var>:
+; X64: div
+; ARM64: udiv
+  %r = udiv i32 %a, %b
+  ret i32 %r
+}
@@ -27,8 +27,7 @@ define float @ceilf32(float %0) {
 ; ARM64-NEXT:    stp x29, x30, [sp]
 ; ARM64-NEXT:    mov x29, sp
 ; ARM64-NEXT:    nop
-; ARM64-NEXT:    bl 0x30 <ceilf32+0x10>
-; ARM64-NEXT:     R_AARCH64_CALL26 ceilf
+; ARM64-NEXT:    frintp s0, s0
 ; ARM64-NEXT:    ldp x29, x30, [sp]
 ; ARM64-NEXT:    add sp, sp, #0xa0
 ; ARM64-NEXT:    ret
@@ -55,8 +54,7 @@ define double @ceilf64(double %0) {
 ; ARM64-NEXT:    stp x29, x30, [sp]
 ; ARM64-NEXT:    mov x29, sp
 ; ARM64-NEXT:    nop
-; ARM64-NEXT:    bl 0x70 <ceilf64+0x10>
-; ARM64-NEXT:     R_AARCH64_CALL26 ceil
+; ARM64-NEXT:    frintp d0, d0
 ; ARM64-NEXT:    ldp x29, x30, [sp]
 ; ARM64-NEXT:    add sp, sp, #0xa0
 ; ARM64-NEXT:    ret
@@ -0,0 +1,67 @@
+; NOTE: Do not autogenerate
+; SPDX-FileCopyrightText: 2025 Contributors to TPDE <https://tpde.org>
+;
+; SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+; RUN: tpde-llc --target=x86_64 %s | %objdump | FileCheck %s -check-prefixes=CHECK,INLINE
+; RUN: tpde-llc --target=aarch64 %s | %objdump | FileCheck %s -check-prefixes=CHECK,INLINE
+; RUN: tpde-llc --target=x86_64 --inline-mem-max=0 %s | %objdump | FileCheck %s -check-prefixes=CHECK,CALL
+; RUN: tpde-llc --target=aarch64 --inline-mem-max=0 %s | %objdump | FileCheck %s -check-prefixes=CHECK,CALL
+
+declare void @llvm.memcpy.p0.p0.i64(ptr, ptr, i64, i1)
+declare void @llvm.memmove.p0.p0.i64(ptr, ptr, i64, i1)
+declare void @llvm.memset.p0.i64(ptr, i8, i64, i1)
+
+define void @memcpy_small(ptr %dst, ptr %src) {
+; CHECK-LABEL: <memcpy_small>:
+; INLINE-NOT: {{ memcpy}}
+; CALL: {{ memcpy}}
+  call void @llvm.memcpy.p0.p0.i64(ptr %dst, ptr %src, i64 31, i1 false)
+  ret void
+}
+
+define void @memcpy_large(ptr %dst, ptr %src) {
+; CHECK-LABEL: <memcpy_large>:
+; CHECK: {{ memcpy}}
+  call void @llvm.memcpy.p0.p0.i64(ptr %dst, ptr %src, i64 65, i1 false)
+  ret void
+}
+
+define void @memcpy_volatile(ptr %dst, ptr %src) {
+; CHECK-LABEL: <memcpy_volatile>:
+; CHECK: {{ memcpy}}
+  call void @llvm.memcpy.p0.p0.i64(ptr %dst, ptr %src, i64 8, i1 true)
+  ret void
+}
+
+define void @memcpy_alloca(ptr %src) {
+; CHECK-LABEL: <memcpy_alloca>:
+; INLINE-NOT: {{ memcpy}}
+; CALL: {{ memcpy}}
+  %a = alloca [24 x i8]
+  call void @llvm.memcpy.p0.p0.i64(ptr %a, ptr %src, i64 24, i1 false)
+  ret void
+}
+
+define void @memmove_small(ptr %dst, ptr %src) {
+; CHECK-LABEL: <memmove_small>:
+; INLINE-NOT: {{ memmove}}
+; CALL: {{ memmove}}
+  call void @llvm.memmove.p0.p0.i64(ptr %dst, ptr %src, i64 24, i1 false)
+  ret void
+}
+
+define void @memset_small(ptr %dst) {
+; CHECK-LABEL: <memset_small>:
+; INLINE-NOT: {{ memset}}
+; CALL: {{ memset}}
+  call void @llvm.memset.p0.i64(ptr %dst, i8 1, i64 19, i1 false)
+  ret void
+}
+
+define void @memset_var(ptr %dst, i8 %val) {
+; CHECK-LABEL: <memset_var>:
+; CHECK: {{ memset}}
+  call void @llvm.memset.p0.i64(ptr %dst, i8 %val, i64 16, i1 false)
+  ret void
+}
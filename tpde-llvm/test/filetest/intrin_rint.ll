@@ -23,8 +23,7 @@ define float @f32(float %a) {
 ; ARM64-NEXT:    stp x29, x30, [sp]
 ; ARM64-NEXT:    mov x29, sp
 ; ARM64-NEXT:    nop
-; ARM64-NEXT:    bl 0x30 <f32+0x10>
-; ARM64-NEXT:     R_AARCH64_CALL26 rintf
+; ARM64-NEXT:    frintx s0, s0
 ; ARM64-NEXT:    ldp x29, x30, [sp]
 ; ARM64-NEXT:    add sp, sp, #0xa0
 ; ARM64-NEXT:    ret
@@ -50,8 +49,7 @@ define double @f64(double %a) {
 ; ARM64-NEXT:    stp x29, x30, [sp]
 ; ARM64-NEXT:    mov x29, sp
 ; ARM64-NEXT:    nop
-; ARM64-NEXT:    bl 0x70 <f64+0x10>
-; ARM64-NEXT:     R_AARCH64_CALL26 rint
+; ARM64-NEXT:    frintx d0, d0
 ; ARM64-NEXT:    ldp x29, x30, [sp]
 ; ARM64-NEXT:    add sp, sp, #0xa0
 ; ARM64-NEXT:    ret
@@ -0,0 +1,53 @@
+; NOTE: Do not autogenerate
+; SPDX-FileCopyrightText: 2025 Contributors to TPDE <https://tpde.org>
+; SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+; RUN: tpde-llc --target=x86_64 %s | %objdump | FileCheck %s -check-prefixes=CHECK,CALL
+; RUN: tpde-llc --target=x86_64 --mattr=+sse4.1 %s | %objdump | FileCheck %s -check-prefixes=CHECK,NATIVE
+
+; Rounding intrinsics use ROUNDSS/ROUNDSD with SSE4.1 and libm otherwise.
+
+define float @floor_f32(float %a) {
+; CHECK-LABEL: <floor_f32>:
+; CALL: R_X86_64_PLT32 floorf-0x4
+; NATIVE-NOT: call
+; NATIVE: roundss {{.*}}, 0x9
+  %r = call float @llvm.floor.f32(float %a)
+  ret float %r
+}
+
+define double @ceil_f64(double %a) {
+; CHECK-LABEL: <ceil_f64>:
+; CALL: R_X86_64_PLT32 ceil-0x4
+; NATIVE-NOT: call
+; NATIVE: roundsd {{.*}}, 0xa
+  %r = call double @llvm.ceil.f64(double %a)
+  ret double %r
+}
+
+define float @trunc_f32(float %a) {
+; CHECK-LABEL: <trunc_f32>:
+; CALL: R_X86_64_PLT32 truncf-0x4
+; NATIVE-NOT: call
+; NATIVE: roundss {{.*}}, 0xb
+  %r = call float @llvm.trunc.f32(float %a)
+  ret float %r
+}
+
+define double @rint_f64(double %a) {
+; CHECK-LABEL: <rint_f64>:
+; CALL: R_X86_64_PLT32 rint-0x4
+; NATIVE-NOT: call
+; NATIVE: roundsd {{.*}}, 0x4
+  %r = call double @llvm.rint.f64(double %a)
+  ret double %r
+}
+
+define double @round_f64(double %a) {
+; CHECK-LABEL: <round_f64>:
+; CALL: R_X86_64_PLT32 round-0x4
+; NATIVE-NOT: call
+; NATIVE: roundsd {{.*}}, 0xb
+  %r = call double @llvm.round.f64(double %a)
+  ret double %r
+}
@@ -0,0 +1,78 @@
+; NOTE: Do not autogenerate
+; SPDX-FileCopyrightText: 2025 Contributors to TPDE <https://tpde.org>
+; SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+; RUN: tpde-llc --target=x86_64 --omit-leaf-frame-pointer %s | %objdump | FileCheck %s -check-prefixes=CHECK,OMIT
+; RUN: tpde-llc --target=x86_64 %s | %objdump | FileCheck %s -check-prefixes=CHECK,FP
+
+; Leaf functions omit the frame pointer and keep their frame in the red zone.
+
+define i64 @load_field(ptr %p) {
+; CHECK-LABEL: <load_field>:
+; OMIT-NOT: {{push|pop|rbp|rsp}}
+; FP: push rbp
+; CHECK: ret
+  %f = getelementptr i8, ptr %p, i64 8
+  %v = load i64, ptr %f
+  ret i64 %v
+}
+
+define i64 @alloca_leaf(i64 %x) {
+; CHECK-LABEL: <alloca_leaf>:
+; OMIT-NOT: {{push|pop|rbp}}
+; OMIT: ptr [rsp - 0x18], rdi
+; OMIT-NOT: {{push|pop|rbp}}
+; FP: push rbp
+; CHECK: ret
+  %a = alloca i64
+  store volatile i64 %x, ptr %a
+  %v = load volatile i64, ptr %a
+  ret i64 %v
+}
+
+define i32 @loop_leaf(i32 %n) {
+; CHECK-LABEL: <loop_leaf>:
+; OMIT-NOT: {{push|pop|rbp}}
+; FP: push rbp
+; CHECK: ret
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  %s.next = add i32 %s, %i
+  %i.next = add i32 %i, 1
+  %c = icmp ult i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret i32 %s.next
+}
+
+declare void @callee()
+
+define void @non_leaf() {
+; CHECK-LABEL: <non_leaf>:
+; CHECK: push rbp
+; CHECK: call
+  call void @callee()
+  ret void
+}
+
+define i128 @libcall(i128 %a, i128 %b) {
+; CHECK-LABEL: <libcall>:
+; CHECK: push rbp
+; CHECK: __divti3
+  %r = sdiv i128 %a, %b
+  ret i128 %r
+}
+
+define i8 @large_frame(i64 %i) {
+; CHECK-LABEL: <large_frame>:
+; CHECK: push rbp
+; CHECK: ret
+  %a = alloca [200 x i8]
+  %p = getelementptr i8, ptr %a, i64 %i
+  store volatile i8 1, ptr %p
+  %v = load volatile i8, ptr %p
+  ret i8 %v
+}
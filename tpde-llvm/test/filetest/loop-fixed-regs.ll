@@ -0,0 +1,57 @@
+; NOTE: Do not autogenerate
+; SPDX-FileCopyrightText: 2025 Contributors to TPDE <https://tpde.org>
+; SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+; RUN: tpde-llc --target=x86_64 --loop-fixed-regs %s | %objdump | FileCheck %s -check-prefixes=X64
+
+; Loop-carried values of innermost loops are kept in fixed registers, so the
+; loop body neither stores nor reloads them.
+
+define i64 @sum_loop(i64 %n) {
+; X64-LABEL: <sum_loop>:
+; X64: <[[LOOP:L[0-9]+]]>:
+; X64-NOT: {{rbp|rsp}}
+; X64: j{{[a-z]+}} <[[LOOP]]>
+entry:
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ %inc, %latch ]
+  %s = phi i64 [ 0, %entry ], [ %s.next, %latch ]
+  %c = icmp ult i64 %i, %n
+  br i1 %c, label %latch, label %exit
+latch:
+  %s.next = add i64 %s, %i
+  %inc = add i64 %i, 1
+  br label %loop
+exit:
+  ret i64 %s
+}
+
+define i32 @nested_inner_loop(ptr %p) {
+; X64-LABEL: <nested_inner_loop>:
+; X64: <[[OUTER:L[0-9]+]]>:
+; X64: <[[INNER:L[0-9]+]]>:
+; X64-NOT: {{rbp|rsp}}
+; X64: j{{[a-z]+}} <[[INNER]]>
+entry:
+  br label %outer
+outer:
+  %j = phi i32 [ 0, %entry ], [ %j.next, %outer.latch ]
+  br label %inner
+inner:
+  %i = phi i32 [ 0, %outer ], [ %i.next, %inner.latch ]
+  %a = phi i32 [ %j, %outer ], [ %a.next, %inner.latch ]
+  %ic = icmp ult i32 %i, 16
+  br i1 %ic, label %inner.latch, label %outer.latch
+inner.latch:
+  %a.next = xor i32 %a, %i
+  %i.next = add i32 %i, 1
+  br label %inner
+outer.latch:
+  store i32 %a, ptr %p
+  %j.next = add i32 %j, 1
+  %jc = icmp ult i32 %j.next, 16
+  br i1 %jc, label %outer, label %exit
+exit:
+  ret i32 %j.next
+}
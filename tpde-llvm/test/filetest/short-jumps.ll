@@ -0,0 +1,66 @@
+; NOTE: Do not autogenerate
+; SPDX-FileCopyrightText: 2025 Contributors to TPDE <https://tpde.org>
+; SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+; RUN: tpde-llc --target=x86_64 --short-jumps %s | llvm-objdump -d --symbolize-operands --no-addresses --x86-asm-syntax=intel - | FileCheck %s
+; RUN: tpde-llc --target=x86_64 %s | llvm-objdump -d --symbolize-operands --no-addresses --x86-asm-syntax=intel - | FileCheck %s -check-prefix=LONG
+
+; With --short-jumps, forward jumps to close targets use the rel8 encoding
+; instead of rel32.
+
+define i32 @loop(i32 %n) {
+; CHECK-LABEL: <loop>:
+; CHECK-NOT: {{^ *(0f 8[0-9a-f]|e9) }}
+; CHECK: {{^ *7[0-9a-f] [0-9a-f]{2} +j}}
+; CHECK-NOT: {{^ *(0f 8[0-9a-f]|e9) }}
+; CHECK: {{^ *eb [0-9a-f]{2} +jmp}}
+; CHECK-NOT: {{^ *(0f 8[0-9a-f]|e9) }}
+; CHECK: ret
+; LONG-LABEL: <loop>:
+; LONG: {{^ *0f 8[0-9a-f] [0-9a-f]{2} [0-9a-f]{2} [0-9a-f]{2} [0-9a-f]{2} +j}}
+; LONG: ret
+entry:
+  br label %head
+head:
+  %i = phi i32 [ 0, %entry ], [ %i1, %body ]
+  %s = phi i32 [ 0, %entry ], [ %s1, %body ]
+  %c = icmp slt i32 %i, %n
+  br i1 %c, label %body, label %exit
+body:
+  %s1 = add i32 %s, %i
+  %i1 = add i32 %i, 1
+  br label %head
+exit:
+  ret i32 %s
+}
+
+; Jump table entries and the table address are updated when the code before
+; the table shrinks.
+define i32 @jump_table(i32 %c) {
+; CHECK-LABEL: <jump_table>:
+; CHECK: lea [[TAB:[a-z0-9]+]], <jump_table+0x{{[0-9a-f]+}}>
+; CHECK: jmp [[TAB]]
+entry:
+  switch i32 %c, label %d [
+    i32 0, label %e0
+    i32 1, label %e1
+    i32 2, label %e2
+    i32 4, label %e4
+    i32 5, label %e5
+    i32 6, label %e6
+  ]
+e0:
+  ret i32 10
+e1:
+  ret i32 11
+e2:
+  ret i32 12
+e4:
+  ret i32 14
+e5:
+  ret i32 15
+e6:
+  ret i32 16
+d:
+  ret i32 -1
+}
@@ -0,0 +1,91 @@
+; NOTE: Do not autogenerate
+; SPDX-FileCopyrightText: 2025 Contributors to TPDE <https://tpde.org>
+; SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+; RUN: tpde-llc --target=x86_64 %s | %objdump | FileCheck %s -check-prefixes=CHECK,X64
+; RUN: tpde-llc --target=aarch64 %s | %objdump | FileCheck %s -check-prefixes=CHECK,ARM64
+
+; Cases within a 64-value window that go to few distinct blocks are lowered to
+; one bit test per block.
+
+; Whitespace test as in a lexer: ' ', '\t', '\n', '\r'
+define i32 @is_space(i8 %c) {
+; CHECK-LABEL: <is_space>:
+; X64: cmp {{.*}}, 0x20
+; X64-NEXT: ja
+; X64-NEXT: movabs {{.*}}, 0x100002600
+; X64-NEXT: bt
+; X64-NEXT: jb
+; X64-NEXT: jmp
+; ARM64: cmp {{.*}}, #0x20
+; ARM64-NEXT: b.hi
+; ARM64: lsr
+; ARM64-NEXT: tbnz
+; ARM64-NEXT: b
+entry:
+  switch i8 %c, label %no [
+    i8 32, label %yes
+    i8 9, label %yes
+    i8 10, label %yes
+    i8 13, label %yes
+  ]
+yes:
+  ret i32 1
+no:
+  ret i32 0
+}
+
+; Two targets, window not starting at zero.
+define i32 @two_classes(i32 %c) {
+; CHECK-LABEL: <two_classes>:
+; X64: sub {{.*}}, 0x64
+; X64-NEXT: cmp {{.*}}, 0x14
+; X64-NEXT: ja
+; X64: bt
+; X64-NEXT: jb
+; X64: bt
+; X64-NEXT: jb
+; X64-NEXT: jmp
+; ARM64: sub {{.*}}, #0x64
+; ARM64-NEXT: cmp {{.*}}, #0x14
+; ARM64-NEXT: b.hi
+; ARM64: tbnz
+; ARM64: tbnz
+; ARM64-NEXT: b
+entry:
+  switch i32 %c, label %other [
+    i32 100, label %a
+    i32 102, label %a
+    i32 104, label %a
+    i32 110, label %b
+    i32 115, label %b
+    i32 120, label %b
+  ]
+a:
+  ret i32 1
+b:
+  ret i32 2
+other:
+  ret i32 0
+}
+
+; Distinct targets for every case are not suitable for bit tests.
+define i32 @distinct(i32 %c) {
+; CHECK-LABEL: <distinct>:
+; CHECK-NOT: {{bt|tbnz}}
+; CHECK: ret
+entry:
+  switch i32 %c, label %other [
+    i32 1, label %a
+    i32 2, label %b
+    i32 3, label %d
+  ]
+a:
+  ret i32 1
+b:
+  ret i32 2
+d:
+  ret i32 3
+other:
+  ret i32 0
+}
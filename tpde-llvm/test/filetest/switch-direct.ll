@@ -0,0 +1,59 @@
+; NOTE: Do not autogenerate
+; SPDX-FileCopyrightText: 2025 Contributors to TPDE <https://tpde.org>
+; SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+; RUN: tpde-llc --target=x86_64 --switch-direct-branches %s | %objdump | FileCheck %s -check-prefixes=CHECK,X64
+; RUN: tpde-llc --target=aarch64 --switch-direct-branches %s | %objdump | FileCheck %s -check-prefixes=CHECK,ARM64
+
+; Cases branch directly to targets without PHI nodes, only targets with PHI
+; nodes get a label that moves the values.
+
+define i32 @no_phis(i32 %c) {
+; CHECK-LABEL: <no_phis>:
+; X64: cmp {{.*}}, 0x1
+; X64-NEXT: je
+; X64-NEXT: cmp {{.*}}, 0x7
+; X64-NEXT: je
+; X64-NEXT: jmp
+; X64-NEXT: <L{{[0-9]+}}>:
+; X64-NEXT: mov eax, 0x1
+; ARM64: cmp {{.*}}, #0x1
+; ARM64-NEXT: b.eq
+; ARM64-NEXT: cmp {{.*}}, #0x7
+; ARM64-NEXT: b.eq
+; ARM64-NEXT: b
+; ARM64-NEXT: <L{{[0-9]+}}>:
+; ARM64-NEXT: mov w0, #0x1
+entry:
+  switch i32 %c, label %d [
+    i32 1, label %a
+    i32 7, label %b
+  ]
+a:
+  ret i32 1
+b:
+  ret i32 2
+d:
+  ret i32 0
+}
+
+; Both cases share the label that moves the PHI value.
+define i32 @phi(i32 %c, i32 %v) {
+; CHECK-LABEL: <phi>:
+; X64: je [[PHI:<L[0-9]+>]]
+; X64-NEXT: cmp
+; X64-NEXT: je [[PHI]]
+; ARM64: b.eq [[PHI:<L[0-9]+>]]
+; ARM64-NEXT: cmp
+; ARM64-NEXT: b.eq [[PHI]]
+entry:
+  switch i32 %c, label %d [
+    i32 1, label %a
+    i32 7, label %a
+  ]
+a:
+  %p = phi i32 [ %v, %entry ], [ %v, %entry ]
+  ret i32 %p
+d:
+  ret i32 0
+}
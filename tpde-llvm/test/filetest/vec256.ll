@@ -0,0 +1,90 @@
+; NOTE: Do not autogenerate
+; SPDX-FileCopyrightText: 2025 Contributors to TPDE <https://tpde.org>
+; SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+; RUN: tpde-llc --target=x86_64 --mcpu=x86-64-v3 %s | %objdump | FileCheck %s
+
+; With AVX, 256-bit vectors are held in a single YMM register. Functions that
+; use them clear the upper halves with vzeroupper before calls and returns,
+; unless values are passed in YMM registers.
+
+define <8 x float> @fadd_v8f32(<8 x float> %a, <8 x float> %b) {
+; CHECK-LABEL: <fadd_v8f32>:
+; CHECK: vaddps {{.*}}ymm
+; CHECK-NOT: vzeroupper
+; CHECK: ret
+  %r = fadd <8 x float> %a, %b
+  ret <8 x float> %r
+}
+
+define <4 x double> @fmul_v4f64(<4 x double> %a, <4 x double> %b) {
+; CHECK-LABEL: <fmul_v4f64>:
+; CHECK: vmulpd {{.*}}ymm
+; CHECK: ret
+  %r = fmul <4 x double> %a, %b
+  ret <4 x double> %r
+}
+
+define <8 x i32> @add_v8i32(<8 x i32> %a, <8 x i32> %b) {
+; CHECK-LABEL: <add_v8i32>:
+; CHECK: vpaddd {{.*}}ymm
+; CHECK: ret
+  %r = add <8 x i32> %a, %b
+  ret <8 x i32> %r
+}
+
+define void @load_store_v4i64(ptr %p, ptr %q) {
+; CHECK-LABEL: <load_store_v4i64>:
+; CHECK: vmovups {{.*}}ymm
+; CHECK: vmovups {{.*}}ymm
+; CHECK: vzeroupper
+; CHECK: ret
+  %v = load <4 x i64>, ptr %p
+  store <4 x i64> %v, ptr %q
+  ret void
+}
+
+declare void @clobber()
+
+define <8 x float> @spill_v8f32(<8 x float> %a) {
+; CHECK-LABEL: <spill_v8f32>:
+; CHECK: vmovupd {{.*}}ymm
+; CHECK: vzeroupper
+; CHECK-NEXT: call
+; CHECK: vmovupd {{.*}}ymm
+; CHECK-NOT: vzeroupper
+; CHECK: ret
+  call void @clobber()
+  ret <8 x float> %a
+}
+
+define <8 x float> @zero_v8f32() {
+; CHECK-LABEL: <zero_v8f32>:
+; CHECK: vpxor
+; CHECK: ret
+  ret <8 x float> zeroinitializer
+}
+
+declare void @use_v8f32(<8 x float>)
+
+define void @call_ymm_arg(ptr %p) {
+; CHECK-LABEL: <call_ymm_arg>:
+; CHECK: vmovups {{.*}}ymm
+; CHECK-NOT: vzeroupper
+; CHECK: call
+; CHECK: vzeroupper
+; CHECK: ret
+  %v = load <8 x float>, ptr %p
+  call void @use_v8f32(<8 x float> %v)
+  ret void
+}
+
+define void @no_ymm(ptr %p) {
+; CHECK-LABEL: <no_ymm>:
+; CHECK-NOT: vzeroupper
+; CHECK: ret
+  %v = load <4 x float>, ptr %p
+  store <4 x float> %v, ptr %p
+  call void @clobber()
+  ret void
+}
@@ -0,0 +1,31 @@
+; NOTE: Do not autogenerate
+; SPDX-FileCopyrightText: 2025 Contributors to TPDE <https://tpde.org>
+; SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+; RUN: rm -rf %t.cache %t.cache-small
+; RUN: tpde-llc -o %t.o %s
+; RUN: tpde-llc --cache-dir=%t.cache -o %t.miss.o %s
+; RUN: tpde-llc --cache-dir=%t.cache -o %t.hit.o %s
+; RUN: cmp %t.o %t.miss.o
+; RUN: cmp %t.o %t.hit.o
+; RUN: ls %t.cache | FileCheck %s
+
+; The key is computed from the input file, a modified input must miss.
+; RUN: sed 's/i32 1$/i32 2/' %s > %t.mod.ll
+; RUN: tpde-llc --cache-dir=%t.cache -o %t.mod.o %t.mod.ll
+; RUN: not cmp %t.o %t.mod.o
+
+; A cache that is too small for any object doesn't keep entries.
+; RUN: tpde-llc --cache-dir=%t.cache-small --cache-size=0 -o %t.small.o %s
+; RUN: cmp %t.o %t.small.o
+; RUN: ls %t.cache-small | FileCheck --check-prefix=SMALL %s
+
+; CHECK: {{^[0-9a-f]+\.o$}}
+; SMALL-NOT: .o
+
+@global = global i32 1
+
+define i32 @func() {
+  %v = load i32, ptr @global
+  ret i32 %v
+}
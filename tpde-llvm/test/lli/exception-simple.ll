@@ -4,6 +4,8 @@
 
 ; RUN: tpde-lli %s | FileCheck %s
 ; RUN: tpde-lli --orc %s | FileCheck %s
+; RUN: tpde-lli --lazy %s | FileCheck %s
+; RUN: tpde-lli --defer-unwind-registration %s | FileCheck %s
 
 ; CHECK: caught exception
 
@@ -0,0 +1,22 @@
+; NOTE: Do not autogenerate
+; SPDX-FileCopyrightText: 2025 Contributors to TPDE <https://tpde.org>
+; SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+; RUN: not tpde-lli --lazy %s 2>&1 | FileCheck %s
+
+; A function that fails to compile on its first call must not abort the
+; process, but continue at the error handler of tpde-lli.
+; CHECK: JIT compilation failed
+
+@g = global [32 x i8] zeroinitializer
+
+define void @unsupported() {
+  %x = load i256, ptr @g
+  store i256 %x, ptr @g
+  ret void
+}
+
+define i32 @main() {
+  call void @unsupported()
+  ret i32 0
+}
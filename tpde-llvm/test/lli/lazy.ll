@@ -0,0 +1,62 @@
+; NOTE: Do not autogenerate
+; SPDX-FileCopyrightText: 2025 Contributors to TPDE <https://tpde.org>
+; SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+; RUN: tpde-lli %s | FileCheck %s
+; RUN: tpde-lli --lazy %s | FileCheck %s
+
+; CHECK: a=1 b=2 c=3 d=4 e=5 f=6 x=1.500000 y=2.500000
+; CHECK-NEXT: fact=120
+; CHECK-NEXT: fact=720
+; CHECK-NEXT: unnamed
+
+@fmt = private constant [40 x i8] c"a=%d b=%d c=%d d=%d e=%d f=%d x=%f y=%f\00"
+@fmt_fact = private constant [8 x i8] c"fact=%d\00"
+@fact_ptr = internal global ptr @fact
+@empty = private constant [1 x i8] zeroinitializer
+; Unnamed globals cannot be resolved by name.
+@0 = private constant [8 x i8] c"unnamed\00"
+
+declare i32 @printf(ptr, ...)
+declare i32 @puts(ptr)
+
+; The first call goes through the lazy compilation trampoline, which must
+; preserve all argument registers.
+define internal void @print_args(i32 %a, i32 %b, i32 %c, i32 %d, i32 %e, i32 %f, double %x, double %y) {
+  %p = call i32 (ptr, ...) @printf(ptr @fmt, i32 %a, i32 %b, i32 %c, i32 %d, i32 %e, i32 %f, double %x, double %y)
+  %nl = call i32 @puts(ptr @empty)
+  ret void
+}
+
+define i32 @fact(i32 %n) {
+  %c = icmp ule i32 %n, 1
+  br i1 %c, label %ret, label %rec
+rec:
+  %n1 = sub i32 %n, 1
+  %r = call i32 @fact(i32 %n1)
+  %m = mul i32 %n, %r
+  ret i32 %m
+ret:
+  ret i32 1
+}
+
+define void @print_fact(i32 %n) {
+  %f = load ptr, ptr @fact_ptr
+  %r = call i32 %f(i32 %n)
+  %p = call i32 (ptr, ...) @printf(ptr @fmt_fact, i32 %r)
+  %nl = call i32 @puts(ptr @empty)
+  ret void
+}
+
+define void @unused() {
+  call void @unused()
+  ret void
+}
+
+define i32 @main() {
+  call void @print_args(i32 1, i32 2, i32 3, i32 4, i32 5, i32 6, double 1.5, double 2.5)
+  call void @print_fact(i32 5)
+  call void @print_fact(i32 6)
+  %p = call i32 @puts(ptr @0)
+  ret i32 0
+}
@@ -0,0 +1,49 @@
+; NOTE: Do not autogenerate
+; SPDX-FileCopyrightText: 2025 Contributors to TPDE <https://tpde.org>
+; SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+; RUN: tpde-lli %s | FileCheck %s
+
+; CHECK: 0123456789abcdefghijklmnopqrstuvwxyzABC
+; CHECK-NEXT: 012xxxxxxxxxxxxxxxxxxxxxopqrstuvwxyzABC
+; CHECK-NEXT: 0012xxxxxxxxxxxxxxxxxxxxopqrstuvwxyzABC
+; CHECK-NEXT: 12xxxxxxxxxxxxxxxxxxxxopqrstuvwvwxyzABC
+; CHECK-NEXT: abcdefghijklmnopqrstuvwxqrstuvwvwxyzABC
+; CHECK-NEXT: -------hijklmnopqrstuvwxqrstuvwvwxyzABC
+
+@src = private constant [40 x i8] c"0123456789abcdefghijklmnopqrstuvwxyzABC\00"
+@buf = internal global [64 x i8] zeroinitializer
+
+declare i32 @puts(ptr)
+declare void @llvm.memcpy.p0.p0.i64(ptr, ptr, i64, i1)
+declare void @llvm.memmove.p0.p0.i64(ptr, ptr, i64, i1)
+declare void @llvm.memset.p0.i64(ptr, i8, i64, i1)
+
+define i32 @main() {
+  %tmp = alloca [24 x i8]
+  call void @llvm.memcpy.p0.p0.i64(ptr @buf, ptr @src, i64 39, i1 false)
+  call i32 @puts(ptr @buf)
+
+  %buf3 = getelementptr i8, ptr @buf, i64 3
+  call void @llvm.memset.p0.i64(ptr %buf3, i8 120, i64 21, i1 false)
+  call i32 @puts(ptr @buf)
+
+  ; overlapping, destination after source
+  %buf1 = getelementptr i8, ptr @buf, i64 1
+  call void @llvm.memmove.p0.p0.i64(ptr %buf1, ptr @buf, i64 23, i1 false)
+  call i32 @puts(ptr @buf)
+
+  ; overlapping, destination before source
+  %buf2 = getelementptr i8, ptr @buf, i64 2
+  call void @llvm.memmove.p0.p0.i64(ptr @buf, ptr %buf2, i64 31, i1 false)
+  call i32 @puts(ptr @buf)
+
+  %src10 = getelementptr i8, ptr @src, i64 10
+  call void @llvm.memcpy.p0.p0.i64(ptr %tmp, ptr %src10, i64 24, i1 false)
+  call void @llvm.memcpy.p0.p0.i64(ptr @buf, ptr %tmp, i64 24, i1 false)
+  call i32 @puts(ptr @buf)
+
+  call void @llvm.memset.p0.i64(ptr @buf, i8 45, i64 7, i1 false)
+  call i32 @puts(ptr @buf)
+  ret i32 0
+}
@@ -0,0 +1,46 @@
+; NOTE: Do not autogenerate
+; SPDX-FileCopyrightText: 2025 Contributors to TPDE <https://tpde.org>
+; SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+; RUN: tpde-lli %s | FileCheck %s
+
+; PHI moves with cycles (including a multi-part value), a chain reading a
+; cycle member, and constant incoming values.
+
+; CHECK: 3 1 2 2 20 10
+; CHECK-NEXT: 7 0 5 1
+
+declare i32 @printf(ptr, ...)
+
+@fmt1 = private constant [19 x i8] c"%d %d %d %d %d %d\0A\00", align 1
+@fmt2 = private constant [17 x i8] c"%lu %lu %lu %lu\0A\00", align 1
+
+define i32 @main() {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i1, %loop ]
+  %a = phi i32 [ 1, %entry ], [ %b, %loop ]
+  %b = phi i32 [ 2, %entry ], [ %c, %loop ]
+  %c = phi i32 [ 3, %entry ], [ %a, %loop ]
+  %z = phi i32 [ 0, %entry ], [ %a, %loop ]
+  %x = phi i32 [ 10, %entry ], [ %y, %loop ]
+  %y = phi i32 [ 20, %entry ], [ %x, %loop ]
+  %p = phi i128 [ 18446744073709551621, %entry ], [ %q, %loop ]
+  %q = phi i128 [ 7, %entry ], [ %p, %loop ]
+  %i1 = add i32 %i, 1
+  %cmp = icmp ult i32 %i1, 6
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  call i32 (ptr, ...) @printf(ptr @fmt1, i32 %a, i32 %b, i32 %c, i32 %z, i32 %x, i32 %y)
+  %pl = trunc i128 %p to i64
+  %ph128 = lshr i128 %p, 64
+  %ph = trunc i128 %ph128 to i64
+  %ql = trunc i128 %q to i64
+  %qh128 = lshr i128 %q, 64
+  %qh = trunc i128 %qh128 to i64
+  call i32 (ptr, ...) @printf(ptr @fmt2, i64 %pl, i64 %ph, i64 %ql, i64 %qh)
+  ret i32 0
+}
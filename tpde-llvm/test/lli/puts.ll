@@ -4,6 +4,10 @@
 
 ; RUN: tpde-lli %s | FileCheck %s
 ; RUN: tpde-lli --orc %s | FileCheck %s
+; RUN: tpde-lli --lazy %s | FileCheck %s
+; RUN: rm -rf %t.cache
+; RUN: tpde-lli --cache-dir=%t.cache %s | FileCheck %s
+; RUN: tpde-lli --cache-dir=%t.cache %s | FileCheck %s
 
 @hello = private constant [6 x i8] c"Hello\00", align 1
 @stdout = external local_unnamed_addr global ptr, align 8
@@ -12,6 +12,7 @@
 #include <llvm/TargetParser/Triple.h>
 
 #include "tpde-llvm/LLVMCompiler.hpp"
+#include "tpde-llvm/ObjectCache.hpp"
 
 #include <cstdlib>
 #include <fstream>
@@ -43,6 +44,19 @@ int main(int argc, char *argv[]) {
   args::ValueFlag<std::string> target(
       parser, "target", "Target architecture", {"target"}, args::Options::None);
 
+  args::ValueFlag<std::string> mcpu(
+      parser,
+      "mcpu",
+      "Target CPU whose features may be used (\"native\" for the host)",
+      {"mcpu"},
+      args::Options::None);
+  args::ValueFlag<std::string> mattr(
+      parser,
+      "mattr",
+      "Target features to enable (+feature) or disable (-feature)",
+      {"mattr"},
+      args::Options::None);
+
   args::ValueFlag<std::string> obj_out_path(
       parser,
       "obj_path",
@@ -50,6 +64,74 @@ int main(int argc, char *argv[]) {
       {'o', "obj-out"},
       "-");
 
+  args::ValueFlag<std::string> cache_dir(
+      parser,
+      "cache_dir",
+      "Directory for caching compiled object files",
+      {"cache-dir"},
+      args::Options::None);
+  args::ValueFlag<uint64_t> cache_size(
+      parser,
+      "cache_size",
+      "Maximum size of the object cache in MiB",
+      {"cache-size"},
+      1024);
+
+  args::Flag short_jumps(
+      parser,
+      "short_jumps",
+      "Use the shortest encoding for jumps (x86-64 only)",
+      {"short-jumps"});
+
+  args::Flag arm64_jump_tables(
+      parser,
+      "arm64_jump_tables",
+      "Lower dense switches to jump tables on AArch64",
+      {"arm64-jump-tables"});
+
+  args::ValueFlag<unsigned> inline_mem_max(
+      parser,
+      "inline_mem_max",
+      "Maximum length of memcpy/memmove/memset that are expanded inline",
+      {"inline-mem-max"},
+      args::Options::None);
+
+  args::Flag keep_regs_at_branches(
+      parser,
+      "keep_regs_at_branches",
+      "Keep register assignments at branches to single-predecessor blocks",
+      {"keep-regs-at-branches"});
+
+  args::Flag next_use_evict(
+      parser,
+      "next_use_evict",
+      "Evict registers based on their next use in the block",
+      {"next-use-evict"});
+
+  args::Flag loop_fixed_regs(
+      parser,
+      "loop_fixed_regs",
+      "Prefer fixed registers for loop-carried values of innermost loops",
+      {"loop-fixed-regs"});
+
+  args::Flag const_strength_reduction(
+      parser,
+      "const_strength_reduction",
+      "Strength-reduce integer mul/div/rem by constants",
+      {"const-strength-reduction"});
+
+  args::Flag switch_direct_branches(
+      parser,
+      "switch_direct_branches",
+      "Branch directly from switches to targets without PHI nodes",
+      {"switch-direct-branches"});
+
+  args::Flag omit_leaf_fp(
+      parser,
+      "omit_leaf_fp",
+      "Omit the frame pointer in leaf functions (x86-64 only)",
+      {"omit-leaf-frame-pointer"});
+
   args::ImplicitValueFlag<std::string> time_trace(
       parser,
       "time_trace",
@@ -97,10 +179,19 @@ int main(int argc, char *argv[]) {
   llvm::LLVMContext context;
   llvm::SMDiagnostic diag{};
 
+  // Keep the input for identifying the module in the object cache.
+  std::unique_ptr<llvm::MemoryBuffer> ir_buf;
   std::unique_ptr<llvm::Module> mod;
   {
     llvm::TimeTraceScope time_scope("Parse IR");
-    mod = llvm::parseIRFile(ir_path.Get(), diag, context);
+    auto buf_or_err = llvm::MemoryBuffer::getFileOrSTDIN(ir_path.Get());
+    if (!buf_or_err) {
+      std::cerr << "Failed to read " << ir_path.Get() << ": "
+                << buf_or_err.getError().message() << "\n";
+      return 1;
+    }
+    ir_buf = std::move(*buf_or_err);
+    mod = llvm::parseIR(ir_buf->getMemBufferRef(), diag, context);
     if (!mod) {
       diag.print(argv[0], llvm::errs());
       return 1;
@@ -118,12 +209,54 @@ int main(int argc, char *argv[]) {
     triple_str = llvm::sys::getDefaultTargetTriple();
   }
   llvm::Triple triple(triple_str);
-  auto compiler = tpde_llvm::LLVMCompiler::create(triple);
+  auto compiler =
+      tpde_llvm::LLVMCompiler::create(triple, mcpu.Get(), mattr.Get());
   if (!compiler) {
-    std::cerr << "Unknown architecture: " << triple_str << "\n";
+    std::cerr << "Unknown architecture, CPU, or features: " << triple_str
+              << "\n";
     return 1;
   }
 
+  if (short_jumps) {
+    compiler->set_short_jumps(true);
+  }
+  if (arm64_jump_tables) {
+    compiler->set_arm64_jump_tables(true);
+  }
+
+  if (inline_mem_max) {
+    compiler->set_inline_mem_max_size(inline_mem_max.Get());
+  }
+  if (keep_regs_at_branches) {
+    compiler->set_keep_regs_at_branches(true);
+  }
+  if (next_use_evict) {
+    compiler->set_evict_by_next_use(true);
+  }
+  if (loop_fixed_regs) {
+    compiler->set_loop_fixed_regs(true);
+  }
+  if (const_strength_reduction) {
+    compiler->set_const_strength_reduction(true);
+  }
+  if (switch_direct_branches) {
+    compiler->set_switch_direct_branches(true);
+  }
+  if (omit_leaf_fp) {
+    compiler->set_omit_leaf_frame_pointer(true);
+  }
+
+  std::unique_ptr<tpde_llvm::ObjectCache> object_cache;
+  if (cache_dir) {
+    object_cache = std::make_unique<tpde_llvm::ObjectCache>(
+        cache_dir.Get(), cache_size.Get() << 20);
+    compiler->set_object_cache(object_cache.get());
+    compiler->set_object_cache_source(
+        *mod,
+        {reinterpret_cast<const uint8_t *>(ir_buf->getBufferStart()),
+         ir_buf->getBufferSize()});
+  }
+
   std::vector<uint8_t> buf;
   {
     llvm::TimeTraceScope time_scope("Compile");
@@ -21,7 +21,10 @@
 #include <llvm/TargetParser/Triple.h>
 
 #include "tpde-llvm/LLVMCompiler.hpp"
+#include "tpde-llvm/ObjectCache.hpp"
+#include "tpde/ElfMapper.hpp"
 
+#include <cstdlib>
 #include <dlfcn.h>
 #include <iostream>
 #include <memory>
@@ -48,6 +51,38 @@ int main(int argc, char *argv[]) {
       2);
 
   args::Flag orc(parser, "orc", "Use LLVM ORC", {"orc"});
+  args::Flag lazy(
+      parser, "lazy", "Compile functions on their first call", {"lazy"});
+  args::Flag defer_unwind(parser,
+                          "defer_unwind",
+                          "Register unwind info only before executing main",
+                          {"defer-unwind-registration"});
+
+  args::ValueFlag<std::string> mcpu(
+      parser,
+      "mcpu",
+      "Target CPU whose features may be used (\"native\" for the host)",
+      {"mcpu"},
+      args::Options::None);
+  args::ValueFlag<std::string> mattr(
+      parser,
+      "mattr",
+      "Target features to enable (+feature) or disable (-feature)",
+      {"mattr"},
+      args::Options::None);
+
+  args::ValueFlag<std::string> cache_dir(
+      parser,
+      "cache_dir",
+      "Directory for caching compiled object files",
+      {"cache-dir"},
+      args::Options::None);
+  args::ValueFlag<uint64_t> cache_size(
+      parser,
+      "cache_size",
+      "Maximum size of the object cache in MiB",
+      {"cache-size"},
+      1024);
 
   args::Positional<std::string> ir_path(
       parser, "ir_path", "Path to the input IR file", "-");
@@ -85,7 +120,15 @@ int main(int argc, char *argv[]) {
   llvm::LLVMContext context;
   llvm::SMDiagnostic diag{};
 
-  auto mod = llvm::parseIRFile(ir_path.Get(), diag, context);
+  // Keep the input for identifying the module in the object cache.
+  auto buf_or_err = llvm::MemoryBuffer::getFileOrSTDIN(ir_path.Get());
+  if (!buf_or_err) {
+    std::cerr << "Failed to read " << ir_path.Get() << ": "
+              << buf_or_err.getError().message() << "\n";
+    return 1;
+  }
+  std::unique_ptr<llvm::MemoryBuffer> ir_buf = std::move(*buf_or_err);
+  auto mod = llvm::parseIR(ir_buf->getMemBufferRef(), diag, context);
   if (!mod) {
     diag.print(argv[0], llvm::errs());
     return 1;
@@ -99,16 +142,42 @@ int main(int argc, char *argv[]) {
 
   std::string triple_str = llvm::sys::getProcessTriple();
   llvm::Triple triple(triple_str);
-  auto compiler = tpde_llvm::LLVMCompiler::create(triple);
+  auto compiler =
+      tpde_llvm::LLVMCompiler::create(triple, mcpu.Get(), mattr.Get());
   if (!compiler) {
-    std::cerr << "Unknown architecture: " << triple_str << "\n";
+    std::cerr << "Unknown architecture, CPU, or features: " << triple_str
+              << "\n";
     return 1;
   }
 
+  std::unique_ptr<tpde_llvm::ObjectCache> object_cache;
+  if (cache_dir) {
+    object_cache = std::make_unique<tpde_llvm::ObjectCache>(
+        cache_dir.Get(), cache_size.Get() << 20);
+    compiler->set_object_cache(object_cache.get());
+    compiler->set_object_cache_source(
+        *mod,
+        {reinterpret_cast<const uint8_t *>(ir_buf->getBufferStart()),
+         ir_buf->getBufferSize()});
+  }
+
   if (!orc) {
-    auto mapper = compiler->compile_and_map(*mod, [](std::string_view name) {
+    if (defer_unwind) {
+      tpde::ElfMapper::set_unwind_registration(
+          tpde::ElfMapper::UnwindRegistration::Deferred);
+    }
+    auto resolver = [](std::string_view name) {
       return ::dlsym(RTLD_DEFAULT, std::string(name).c_str());
-    });
+    };
+    // Called instead of a function that failed to compile lazily.
+    void (*lazy_error_handler)() = [] {
+      std::cerr << "JIT compilation failed\n";
+      std::exit(1);
+    };
+    auto mapper =
+        lazy ? compiler->compile_and_map_lazy(
+                   *mod, resolver, reinterpret_cast<void *>(lazy_error_handler))
+             : compiler->compile_and_map(*mod, resolver);
     void *main_addr = mapper.lookup_global(main_fn);
     if (!main_addr) {
       std::cerr << "JIT compilation failed\n";
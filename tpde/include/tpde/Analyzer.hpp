@@ -12,6 +12,7 @@
 #include "tpde/base.hpp"
 #include "util/SmallBitSet.hpp"
 #include "util/SmallVector.hpp"
+#include "util/misc.hpp"
 
 namespace tpde {
 
@@ -59,27 +60,30 @@ struct Analyzer {
 
   util::SmallVector<Loop, 16> loops = {};
 
-  // TODO(ts): move all struct definitions to the top?
-  struct LivenessInfo {
-    // [first, last]
-    BlockIndex first, last;
-    u32 ref_count;
-    u32 lowest_common_loop;
-
-    // TODO(ts): maybe outsource both these booleans to a bitset?
-    // we're wasting a lot of space here
+  /// Minimum loop nesting depth from which the liveness analysis answers
+  /// lowest-common-loop queries in constant time using an Euler tour of the
+  /// loop tree instead of walking up the tree. 0 always uses the Euler tour.
+  u32 loop_lca_min_depth = 8;
 
-    /// The value may not be deallocated until the last block is finished
-    /// even if the reference count hits 0
-    bool last_full;
-
-    u16 epoch = 0;
+  /// Live range of a value, [first, last] in block layout order.
+  struct LiveRange {
+    BlockIndex first, last;
   };
 
-  util::SmallVector<LivenessInfo, SMALL_VALUE_NUM> liveness = {};
+  // Liveness information is stored as separate arrays indexed by ValLocalIdx
+  // so that the queries during code generation, which mostly need the live
+  // range or the reference count of a value, only touch the data they use.
+  util::SmallVector<LiveRange, SMALL_VALUE_NUM> liveness_ranges = {};
+  util::SmallVector<u32, SMALL_VALUE_NUM> liveness_ref_counts = {};
+  /// Innermost loop that contains all uses of the value.
+  util::SmallVector<u32, SMALL_VALUE_NUM> liveness_lcls = {};
+  /// The value may not be deallocated until the last block is finished even
+  /// if the reference count hits 0.
+  util::SmallBitSet<SMALL_VALUE_NUM> liveness_last_full_bits = {};
+  util::SmallVector<u16, SMALL_VALUE_NUM> liveness_epochs = {};
   /// Epoch of liveness information, entries with a value not equal to this
   /// epoch are invalid. This is an optimization to avoid clearing the entire
-  /// liveness vector for every function, which is important for functions with
+  /// liveness arrays for every function, which is important for functions with
   /// many values that are ignored for the liveness analysis (e.g., var refs).
   u16 liveness_epoch = 0;
   u32 liveness_max_value;
@@ -106,11 +110,26 @@ struct Analyzer {
     return static_cast<BlockIndex>(adaptor->block_info(block_ref));
   }
 
-  const LivenessInfo &liveness_info(const ValLocalIdx val_idx) const noexcept {
-    assert(static_cast<u32>(val_idx) < liveness.size());
-    assert(liveness[static_cast<u32>(val_idx)].epoch == liveness_epoch &&
-           "access to liveness of ignored value");
-    return liveness[static_cast<u32>(val_idx)];
+  u32 liveness_size() const noexcept { return liveness_epochs.size(); }
+
+  const LiveRange &liveness_range(const ValLocalIdx val_idx) const noexcept {
+    assert_liveness_valid(val_idx);
+    return liveness_ranges[static_cast<u32>(val_idx)];
+  }
+
+  u32 liveness_ref_count(const ValLocalIdx val_idx) const noexcept {
+    assert_liveness_valid(val_idx);
+    return liveness_ref_counts[static_cast<u32>(val_idx)];
+  }
+
+  bool liveness_last_full(const ValLocalIdx val_idx) const noexcept {
+    assert_liveness_valid(val_idx);
+    return liveness_last_full_bits.is_set(static_cast<u32>(val_idx));
+  }
+
+  u32 liveness_lowest_common_loop(const ValLocalIdx val_idx) const noexcept {
+    assert_liveness_valid(val_idx);
+    return liveness_lcls[static_cast<u32>(val_idx)];
   }
 
   u32 block_loop_idx(const BlockIndex idx) const noexcept {
@@ -141,8 +160,19 @@ struct Analyzer {
   void print_liveness(std::ostream &os) const;
 
 protected:
-  // for use during liveness analysis
-  LivenessInfo &liveness_maybe(const IRValueRef val) noexcept;
+  void assert_liveness_valid(const ValLocalIdx val_idx) const noexcept {
+    (void)val_idx;
+    assert(static_cast<u32>(val_idx) < liveness_epochs.size());
+    assert(liveness_epochs[static_cast<u32>(val_idx)] == liveness_epoch &&
+           "access to liveness of ignored value");
+  }
+
+  /// Resize all liveness arrays, new entries are invalid.
+  void liveness_resize(u32 size) noexcept;
+
+  // for use during liveness analysis, returns the index into the liveness
+  // arrays
+  u32 liveness_maybe(const IRValueRef val) noexcept;
 
   void build_block_layout();
 
@@ -163,6 +193,29 @@ protected:
       util::SmallBitSet<256> &loop_heads) const noexcept;
 
   void compute_liveness() noexcept;
+
+  /// Euler tour of the loop tree, as loop indices.
+  util::SmallVector<u32, 0> loop_tour;
+  /// For each loop, its first position in loop_tour.
+  util::SmallVector<u32, 0> loop_tour_first;
+  /// Sparse tables for range-minimum queries over the loop levels in
+  /// loop_tour: entry [k * size + i] is the position of the loop with the
+  /// lowest level in [i, i + 2^k). On ties, the leftmost/rightmost position
+  /// is stored.
+  util::SmallVector<u32, 0> loop_tour_min_left, loop_tour_min_right;
+
+  struct LoopLCA {
+    /// Lowest common loop.
+    u32 lcl;
+    /// Loops nested directly in lcl containing lhs/rhs, or lcl itself.
+    u32 lhs_child, rhs_child;
+  };
+
+  /// Build loop_tour and the sparse tables for loop_lca.
+  void build_loop_tour() noexcept;
+
+  /// Find the lowest common loop of two loops in constant time.
+  LoopLCA loop_lca(u32 lhs, u32 rhs) const noexcept;
 };
 
 template <IRAdaptor Adaptor>
@@ -214,39 +267,48 @@ void Analyzer<Adaptor>::print_loops(std::ostream &os) const {
 template <IRAdaptor Adaptor>
 void Analyzer<Adaptor>::print_liveness(std::ostream &os) const {
   for (u32 i = 0; i <= liveness_max_value; ++i) {
-    if (liveness[i].epoch != liveness_epoch) {
+    if (liveness_epochs[i] != liveness_epoch) {
       os << std::format("  {}: ignored\n", i);
       continue;
     }
 
-    const auto &info = liveness[i];
+    const LiveRange &range = liveness_ranges[i];
     os << std::format("  {}: {} refs, {}->{} ({}->{}), lf: {}\n",
                       i,
-                      info.ref_count,
-                      static_cast<u32>(info.first),
-                      static_cast<u32>(info.last),
-                      adaptor->block_fmt_ref(block_ref(info.first)),
-                      adaptor->block_fmt_ref(block_ref(info.last)),
-                      info.last_full);
+                      liveness_ref_counts[i],
+                      static_cast<u32>(range.first),
+                      static_cast<u32>(range.last),
+                      adaptor->block_fmt_ref(block_ref(range.first)),
+                      adaptor->block_fmt_ref(block_ref(range.last)),
+                      liveness_last_full_bits.is_set(i));
   }
 }
 
 template <IRAdaptor Adaptor>
-typename Analyzer<Adaptor>::LivenessInfo &
-    Analyzer<Adaptor>::liveness_maybe(const IRValueRef val) noexcept {
+void Analyzer<Adaptor>::liveness_resize(const u32 size) noexcept {
+  // epoch 0 is never valid, so value-initialized entries are invalid
+  liveness_ranges.resize_uninitialized(size);
+  liveness_ref_counts.resize_uninitialized(size);
+  liveness_lcls.resize_uninitialized(size);
+  liveness_last_full_bits.resize(size);
+  liveness_epochs.resize(size);
+}
+
+template <IRAdaptor Adaptor>
+u32 Analyzer<Adaptor>::liveness_maybe(const IRValueRef val) noexcept {
   const ValLocalIdx val_idx = adaptor->val_local_idx(val);
   if constexpr (Adaptor::TPDE_PROVIDES_HIGHEST_VAL_IDX) {
-    assert(liveness.size() > static_cast<u32>(val_idx));
-    return liveness[static_cast<u32>(val_idx)];
+    assert(liveness_epochs.size() > static_cast<u32>(val_idx));
+    return static_cast<u32>(val_idx);
   } else {
     if (liveness_max_value <= static_cast<u32>(val_idx)) {
       liveness_max_value = static_cast<u32>(val_idx);
-      if (liveness.size() <= liveness_max_value) {
+      if (liveness_epochs.size() <= liveness_max_value) {
         // TODO: better growth strategy?
-        liveness.resize(liveness_max_value + 0x100);
+        liveness_resize(liveness_max_value + 0x100);
       }
     }
-    return liveness[static_cast<u32>(val_idx)];
+    return static_cast<u32>(val_idx);
   }
 }
 
@@ -717,6 +779,124 @@ void Analyzer<Adaptor>::identify_loops(
   }
 }
 
+template <IRAdaptor Adaptor>
+void Analyzer<Adaptor>::build_loop_tour() noexcept {
+  // Euler tour + sparse table, see Bender and Farach-Colton: The LCA Problem
+  // Revisited. The lowest common loop of two loops is the loop with the
+  // lowest level between their first occurrences in the tour.
+  const u32 num_loops = loops.size();
+
+  // children of each loop in CSR form, the root loop is its own parent
+  util::SmallVector<u32, 0> child_start, children;
+  child_start.resize(num_loops + 1, 0);
+  for (u32 i = 1; i < num_loops; ++i) {
+    ++child_start[loops[i].parent + 1];
+  }
+  for (u32 i = 0; i < num_loops; ++i) {
+    child_start[i + 1] += child_start[i];
+  }
+  children.resize_uninitialized(num_loops - 1);
+  {
+    util::SmallVector<u32, 0> fill;
+    fill.resize_uninitialized(num_loops);
+    std::copy_n(child_start.begin(), num_loops, fill.begin());
+    for (u32 i = 1; i < num_loops; ++i) {
+      children[fill[loops[i].parent]++] = i;
+    }
+  }
+
+  const u32 tour_len = 2 * num_loops - 1;
+  loop_tour.clear();
+  loop_tour.reserve(tour_len);
+  loop_tour_first.resize_uninitialized(num_loops);
+
+  // iterative DFS, the stack holds (loop, index of next child)
+  util::SmallVector<std::pair<u32, u32>, 16> stack;
+  loop_tour_first[0] = 0;
+  loop_tour.push_back(0);
+  stack.emplace_back(0, child_start[0]);
+  while (!stack.empty()) {
+    auto &[loop_idx, next_child] = stack.back();
+    if (next_child == child_start[loop_idx + 1]) {
+      stack.pop_back();
+      if (!stack.empty()) {
+        loop_tour.push_back(stack.back().first);
+      }
+      continue;
+    }
+    const u32 child = children[next_child++];
+    loop_tour_first[child] = loop_tour.size();
+    loop_tour.push_back(child);
+    stack.emplace_back(child, child_start[child]);
+  }
+  assert(loop_tour.size() == tour_len);
+
+  const u32 num_rows = 32 - util::cnt_lz<u32>(tour_len);
+  loop_tour_min_left.resize_uninitialized(num_rows * tour_len);
+  loop_tour_min_right.resize_uninitialized(num_rows * tour_len);
+  for (u32 i = 0; i < tour_len; ++i) {
+    loop_tour_min_left[i] = i;
+    loop_tour_min_right[i] = i;
+  }
+  for (u32 k = 1; k < num_rows; ++k) {
+    const u32 half = 1u << (k - 1);
+    const u32 *prev_left = &loop_tour_min_left[(k - 1) * tour_len];
+    const u32 *prev_right = &loop_tour_min_right[(k - 1) * tour_len];
+    u32 *cur_left = &loop_tour_min_left[k * tour_len];
+    u32 *cur_right = &loop_tour_min_right[k * tour_len];
+    for (u32 i = 0; i + 2 * half <= tour_len; ++i) {
+      const u32 l0 = prev_left[i], l1 = prev_left[i + half];
+      cur_left[i] = loops[loop_tour[l0]].level <= loops[loop_tour[l1]].level
+                        ? l0
+                        : l1;
+      const u32 r0 = prev_right[i], r1 = prev_right[i + half];
+      cur_right[i] = loops[loop_tour[r1]].level <= loops[loop_tour[r0]].level
+                         ? r1
+                         : r0;
+    }
+  }
+}
+
+template <IRAdaptor Adaptor>
+typename Analyzer<Adaptor>::LoopLCA
+    Analyzer<Adaptor>::loop_lca(u32 lhs, u32 rhs) const noexcept {
+  if (lhs == rhs) {
+    return LoopLCA{.lcl = lhs, .lhs_child = lhs, .rhs_child = rhs};
+  }
+
+  const bool swapped = loop_tour_first[lhs] > loop_tour_first[rhs];
+  const u32 a = swapped ? rhs : lhs, b = swapped ? lhs : rhs;
+  const u32 from = loop_tour_first[a], to = loop_tour_first[b];
+
+  const u32 tour_len = loop_tour.size();
+  const u32 k = 31 - util::cnt_lz<u32>(to - from + 1);
+  const u32 *row_left = &loop_tour_min_left[k * tour_len];
+  const u32 *row_right = &loop_tour_min_right[k * tour_len];
+  const u32 from2 = to + 1 - (1u << k);
+
+  const u32 l0 = row_left[from], l1 = row_left[from2];
+  const u32 left =
+      loops[loop_tour[l0]].level <= loops[loop_tour[l1]].level ? l0 : l1;
+  const u32 r0 = row_right[from], r1 = row_right[from2];
+  const u32 right =
+      loops[loop_tour[r1]].level <= loops[loop_tour[r0]].level ? r1 : r0;
+
+  const u32 lcl = loop_tour[left];
+  // b comes after a in the tour, so it cannot be an ancestor of a. The tour
+  // returns to lcl after the child containing a and enters the child
+  // containing b directly after the last occurrence of lcl before b.
+  assert(lcl != b && right < to);
+  const u32 a_child = a == lcl ? lcl : loop_tour[left - 1];
+  const u32 b_child = loop_tour[right + 1];
+  assert(a_child == lcl || loops[a_child].parent == lcl);
+  assert(loops[b_child].parent == lcl);
+
+  if (swapped) {
+    return LoopLCA{.lcl = lcl, .lhs_child = b_child, .rhs_child = a_child};
+  }
+  return LoopLCA{.lcl = lcl, .lhs_child = a_child, .rhs_child = b_child};
+}
+
 template <IRAdaptor Adaptor>
 void Analyzer<Adaptor>::compute_liveness() noexcept {
   // implement the liveness algorithm described in
@@ -728,14 +908,14 @@ void Analyzer<Adaptor>::compute_liveness() noexcept {
 
   // Bump epoch. On overflow, we must clear all liveness info entries.
   if (++liveness_epoch == 0) {
-    liveness.clear();
+    liveness_resize(0);
     liveness_epoch = 1;
   }
 
   if constexpr (Adaptor::TPDE_PROVIDES_HIGHEST_VAL_IDX) {
     liveness_max_value = adaptor->cur_highest_val_idx();
-    if (liveness_max_value >= liveness.size()) {
-      liveness.resize(liveness_max_value + 1);
+    if (liveness_max_value >= liveness_epochs.size()) {
+      liveness_resize(liveness_max_value + 1);
     }
   } else {
     liveness_max_value = 0;
@@ -743,7 +923,20 @@ void Analyzer<Adaptor>::compute_liveness() noexcept {
 
   num_insts = 0;
 
-  const auto visit = [this](const IRValueRef value, const u32 block_idx) {
+  // Walking up the loop tree is cheap for shallow loop nests, use the Euler
+  // tour only when the nesting depth makes these walks expensive.
+  u32 max_loop_level = 0;
+  for (const Loop &loop : loops) {
+    max_loop_level = std::max(max_loop_level, loop.level);
+  }
+  const bool use_loop_tour =
+      loops.size() > 1 && max_loop_level >= loop_lca_min_depth;
+  if (use_loop_tour) {
+    build_loop_tour();
+  }
+
+  const auto visit = [this, use_loop_tour](const IRValueRef value,
+                                           const u32 block_idx) {
     TPDE_LOG_TRACE("  Visiting value {} in block {}",
                    adaptor->value_fmt_ref(value),
                    block_idx);
@@ -752,69 +945,77 @@ void Analyzer<Adaptor>::compute_liveness() noexcept {
       return;
     }
 
-    auto &liveness = liveness_maybe(value);
-    if (liveness.epoch != liveness_epoch) {
+    const u32 idx = liveness_maybe(value);
+    if (liveness_epochs[idx] != liveness_epoch) {
       TPDE_LOG_TRACE("    initializing liveness info, lcl is {}",
                      block_loop_map[block_idx]);
-      liveness = LivenessInfo{
+      liveness_ranges[idx] = LiveRange{
           .first = static_cast<BlockIndex>(block_idx),
           .last = static_cast<BlockIndex>(block_idx),
-          .ref_count = 1,
-          .lowest_common_loop = block_loop_map[block_idx],
-          .last_full = false,
-          .epoch = liveness_epoch,
       };
+      liveness_ref_counts[idx] = 1;
+      liveness_lcls[idx] = block_loop_map[block_idx];
+      liveness_last_full_bits.mark_unset(idx);
+      liveness_epochs[idx] = liveness_epoch;
       return;
     }
 
-    assert(liveness.ref_count != ~0u && "used value without definition");
+    u32 &ref_count = liveness_ref_counts[idx];
+    assert(ref_count != ~0u && "used value without definition");
 
-    ++liveness.ref_count;
-    TPDE_LOG_TRACE("    increasing ref_count to {}", liveness.ref_count);
+    ++ref_count;
+    TPDE_LOG_TRACE("    increasing ref_count to {}", ref_count);
+
+    LiveRange &range = liveness_ranges[idx];
+    u32 &lcl = liveness_lcls[idx];
 
     // helpers
-    const auto update_for_block_only = [&liveness, block_idx]() {
-      const auto old_first = static_cast<u32>(liveness.first);
-      const auto old_last = static_cast<u32>(liveness.last);
+    const auto update_for_block_only = [this, &range, idx, block_idx]() {
+      const auto old_first = static_cast<u32>(range.first);
+      const auto old_last = static_cast<u32>(range.last);
 
       const auto new_first = std::min(old_first, block_idx);
       const auto new_last = std::max(old_last, block_idx);
-      liveness.first = static_cast<BlockIndex>(new_first);
-      liveness.last = static_cast<BlockIndex>(new_last);
+      range.first = static_cast<BlockIndex>(new_first);
+      range.last = static_cast<BlockIndex>(new_last);
 
       // if last changed, we don't need to extend the lifetime to the end
       // of the last block
-      liveness.last_full = (old_last == new_last) ? liveness.last_full : false;
+      if (old_last != new_last) {
+        liveness_last_full_bits.mark_unset(idx);
+      }
     };
 
-    const auto update_for_loop = [&liveness](const Loop &loop) {
-      const auto old_first = static_cast<u32>(liveness.first);
-      const auto old_last = static_cast<u32>(liveness.last);
+    const auto update_for_loop = [this, &range, idx](const Loop &loop) {
+      const auto old_first = static_cast<u32>(range.first);
+      const auto old_last = static_cast<u32>(range.last);
 
       const auto new_first = std::min(old_first, static_cast<u32>(loop.begin));
       const auto new_last = std::max(old_last, static_cast<u32>(loop.end) - 1);
-      liveness.first = static_cast<BlockIndex>(new_first);
-      liveness.last = static_cast<BlockIndex>(new_last);
+      range.first = static_cast<BlockIndex>(new_first);
+      range.last = static_cast<BlockIndex>(new_last);
 
       // if last changed, set last_full to true
       // since the values need to be allocated when the loop is active
-      liveness.last_full = (old_last == new_last) ? liveness.last_full : true;
+      if (old_last != new_last) {
+        liveness_last_full_bits.mark_set(idx);
+      }
     };
 
     const auto block_loop_idx = block_loop_map[block_idx];
-    if (liveness.lowest_common_loop == block_loop_idx) {
+    if (lcl == block_loop_idx) {
       // just extend the liveness interval
       TPDE_LOG_TRACE("    lcl is same as block loop");
       update_for_block_only();
 
       TPDE_LOG_TRACE("    new interval {}->{}, lf: {}",
-                     static_cast<u32>(liveness.first),
-                     static_cast<u32>(liveness.last),
-                     liveness.last_full);
+                     static_cast<u32>(range.first),
+                     static_cast<u32>(range.last),
+                     liveness_last_full_bits.is_set(idx));
       return;
     }
 
-    const Loop &liveness_loop = loops[liveness.lowest_common_loop];
+    const Loop &liveness_loop = loops[lcl];
     const Loop &block_loop = loops[block_loop_idx];
 
     if (liveness_loop.level < block_loop.level &&
@@ -830,25 +1031,25 @@ void Analyzer<Adaptor>::compute_liveness() noexcept {
       // liveness interval
       const auto target_level = liveness_loop.level + 1;
       auto cur_loop_idx = block_loop_idx;
-      auto cur_level = block_loop.level;
-      // TODO(ts): we could also skip some loops here since we know that
-      // there have to be at least n=(cur_level-target_level) loops
-      // between cur_loop and target_loop
-      // so we could choose cur_loop_idx = min(cur_parent, cur_idx-n)?
-      // however this might jump into more nested loops
-      // so maybe check (cur_idx-n).level first?
-      while (cur_level != target_level) {
-        cur_loop_idx = loops[cur_loop_idx].parent;
-        --cur_level;
+      if (use_loop_tour) {
+        const LoopLCA lca = loop_lca(lcl, block_loop_idx);
+        assert(lca.lcl == lcl);
+        cur_loop_idx = lca.rhs_child;
+      } else {
+        auto cur_level = block_loop.level;
+        while (cur_level != target_level) {
+          cur_loop_idx = loops[cur_loop_idx].parent;
+          --cur_level;
+        }
       }
       assert(loops[cur_loop_idx].level == target_level);
       TPDE_LOG_TRACE("    target_loop is {}", cur_loop_idx);
       update_for_loop(loops[cur_loop_idx]);
 
       TPDE_LOG_TRACE("    new interval {}->{}, lf: {}",
-                     static_cast<u32>(liveness.first),
-                     static_cast<u32>(liveness.last),
-                     liveness.last_full);
+                     static_cast<u32>(range.first),
+                     static_cast<u32>(range.last),
+                     liveness_last_full_bits.is_set(idx));
       return;
     }
 
@@ -857,20 +1058,20 @@ void Analyzer<Adaptor>::compute_liveness() noexcept {
     // need to update the lowest common loop to contain both liveness_loop
     // and block_loop and then extend the interval accordingly
 
-    // TODO(ts): this algorithm is currently worst-case O(n) which makes the
-    // whole liveness analysis worst-case O(n^2) which is not good. However,
-    // we expect the number of loops to be much smaller than the number of
-    // values so it should be fine for most programs. To be safe, we should
-    // implement the algorithm from "Gusfield: Constant-Time Lowest Common
-    // Ancestor Retrieval" which seems to be the one with the most
-    // reasonable overhead. It is however not zero and the queries are also
-    // not exactly free so we should definitely benchmark both version first
-    // with both small and large programs
-
-    auto lhs_idx = liveness.lowest_common_loop;
+    // Walking up the loop tree is worst-case O(loop depth) per use, which
+    // makes the whole analysis quadratic for deeply nested loops. In that
+    // case, loop_lca answers the query in constant time.
+
+    auto lhs_idx = lcl;
     auto rhs_idx = block_loop_idx;
     auto prev_rhs = rhs_idx;
     auto prev_lhs = lhs_idx;
+    if (use_loop_tour) {
+      const LoopLCA lca = loop_lca(lhs_idx, rhs_idx);
+      lhs_idx = rhs_idx = lca.lcl;
+      prev_lhs = lca.lhs_child;
+      prev_rhs = lca.rhs_child;
+    }
     while (lhs_idx != rhs_idx) {
       const auto lhs_level = loops[lhs_idx].level;
       const auto rhs_level = loops[rhs_idx].level;
@@ -894,7 +1095,7 @@ void Analyzer<Adaptor>::compute_liveness() noexcept {
            static_cast<u32>(liveness_loop.end));
     TPDE_LOG_TRACE("    new lcl is {}", lhs_idx);
 
-    liveness.lowest_common_loop = lhs_idx;
+    lcl = lhs_idx;
 
     // extend for the full loop that contains liveness_loop and is nested
     // directly in lcl
@@ -917,9 +1118,9 @@ void Analyzer<Adaptor>::compute_liveness() noexcept {
     }
 
     TPDE_LOG_TRACE("    new interval {}->{}, lf: {}",
-                   static_cast<u32>(liveness.first),
-                   static_cast<u32>(liveness.last),
-                   liveness.last_full);
+                   static_cast<u32>(range.first),
+                   static_cast<u32>(range.last),
+                   liveness_last_full_bits.is_set(idx));
   };
 
   assert(block_layout[0] == adaptor->cur_entry_block());
@@ -989,9 +1190,10 @@ void Analyzer<Adaptor>::compute_liveness() noexcept {
 
 #ifdef TPDE_ASSERTS
   // reset the incorrect ref_counts in the liveness infos
-  for (auto &entry : liveness) {
-    if (entry.ref_count == ~0u) {
-      entry.ref_count = 0;
+  for (u32 i = 0; i < liveness_ref_counts.size(); ++i) {
+    if (liveness_epochs[i] == liveness_epoch &&
+        liveness_ref_counts[i] == ~0u) {
+      liveness_ref_counts[i] = 0;
     }
   }
 #endif
@@ -7,14 +7,17 @@
 #include <cstdlib>
 #include <elf.h>
 #include <span>
+#include <string>
 #include <string_view>
 #include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 #include "base.hpp"
 #include "tpde/StringTable.hpp"
 #include "tpde/util/BumpAllocator.hpp"
 #include "tpde/util/VectorWriter.hpp"
+#include "tpde/util/function_ref.hpp"
 #include "util/SmallVector.hpp"
 #include "util/misc.hpp"
 
@@ -24,7 +27,9 @@ namespace dwarf {
 // DWARF constants
 constexpr u8 DW_CFA_nop = 0;
 constexpr u8 DW_EH_PE_uleb128 = 0x01;
+constexpr u8 DW_EH_PE_udata4 = 0x03;
 constexpr u8 DW_EH_PE_pcrel = 0x10;
+constexpr u8 DW_EH_PE_datarel = 0x30;
 constexpr u8 DW_EH_PE_indirect = 0x80;
 constexpr u8 DW_EH_PE_sdata4 = 0x0b;
 constexpr u8 DW_EH_PE_omit = 0xff;
@@ -430,6 +435,18 @@ private:
   /// The current function
   SymRef cur_func;
 
+  /// Names of global symbols that were added by merge_shard after the common
+  /// prefix, used to deduplicate undefined symbols created by multiple shards.
+  std::unordered_map<std::string, SymRef> merged_globals;
+
+  /// Relocations against section symbols that refer to data of the current
+  /// shard range, as (section, relocation index). The addend of these
+  /// relocations must be adjusted when the range is merged.
+  std::vector<std::pair<SecRef, u32>> shard_range_relocs;
+  /// Symbols of constants in the read-only data section created by
+  /// sym_def_const, keyed by the data followed by the alignment.
+  std::unordered_map<std::string, SymRef> const_pool;
+
 public:
   explicit AssemblerElfBase(const TargetInfo &target_info)
       : target_info(target_info) {
@@ -573,6 +590,11 @@ public:
     return sym;
   }
 
+  /// Get a local symbol for constant data in the read-only data section.
+  /// Constants with identical data and alignment share the same symbol.
+  [[nodiscard]] SymRef sym_def_const(std::span<const u8> data,
+                                     u32 align) noexcept;
+
   void sym_def_predef_zero(SecRef sec_ref,
                            SymRef sym_ref,
                            u32 size,
@@ -598,6 +620,14 @@ public:
     // TODO: handle fixups?
   }
 
+  /// Define symbol with an absolute value, e.g. an address in memory.
+  void sym_def_abs(SymRef sym_ref, u64 value) noexcept {
+    Elf64_Sym *sym = sym_ptr(sym_ref);
+    assert(sym->st_shndx == SHN_UNDEF && "cannot redefined symbol");
+    sym->st_value = value;
+    sym->st_shndx = SHN_ABS;
+  }
+
   void sym_set_visibility(SymRef sym, SymVisibility visibility) noexcept {
     sym_ptr(sym)->st_other = static_cast<u8>(visibility);
   }
@@ -607,6 +637,10 @@ public:
     sym_ptr(sym)->st_value = value;
   }
 
+  /// Call fn for every symbol that has a name.
+  void sym_for_each_named(
+      util::function_ref<void(SymRef, std::string_view)> fn) const noexcept;
+
   const char *sym_name(SymRef sym) const noexcept {
     return strtab.data() + sym_ptr(sym)->st_name;
   }
@@ -641,6 +675,23 @@ public:
   }
 
 protected:
+  /// Number of labels created so far, labels created afterwards have an id
+  /// greater or equal to the result.
+  u32 label_count() const noexcept { return temp_symbols.size(); }
+
+  /// Update offsets after code in sec starting at start was moved, e.g. by
+  /// branch relaxation. This covers labels with an id of at least
+  /// first_label, pending label fixups, relocations, and the call-site table
+  /// of the current function. map translates an old offset into the new one.
+  void remap_code_offsets(SecRef sec,
+                          u32 start,
+                          u32 first_label,
+                          util::function_ref<u32(u32)> map) noexcept;
+
+  /// Remove the relocations of code in sec starting at start, e.g. when the
+  /// code of a function is discarded to compile it again.
+  void discard_code_relocs(SecRef sec, u32 start) noexcept;
+
   [[nodiscard]] static bool sym_is_local(const SymRef sym) noexcept {
     return (sym.id() & 0x8000'0000) == 0;
   }
@@ -681,6 +732,16 @@ public:
 
   void reloc_sec(SecRef sec, Label label, u8 kind, u32 offset) noexcept;
 
+  /// Add a relocation against the section symbol of \p target, which refers to
+  /// data that was written to \p target inside the current shard range. The
+  /// addend is then adjusted by shard_merge. All other relocations against
+  /// section symbols must refer to the common prefix of the shards.
+  void reloc_sec_range(SecRef sec,
+                       SecRef target,
+                       u32 type,
+                       u64 offset,
+                       i64 addend) noexcept;
+
   // Unwind and exception info
 
   static constexpr u32 write_eh_inst(u8 *dst, u8 opcode, u64 arg) noexcept {
@@ -737,9 +798,55 @@ public:
 
   void finalize() noexcept;
 
+  // Shards for parallel compilation
+
+  /// Position in an assembler, delimits the ranges of a shard that are merged
+  /// into another assembler.
+  struct ShardMark {
+    u32 sec_count = 0;
+    u32 local_sym_count = 0;
+    u32 global_sym_count = 0;
+    /// Number of relocations in shard_range_relocs.
+    u32 range_reloc_count = 0;
+    /// Size of every section at the time of the mark.
+    util::SmallVector<u64, 16> sec_sizes;
+  };
+
+  /// Alignment of every range appended to a section by shard_begin and
+  /// shard_merge, so that the contents of a range do not depend on where it is
+  /// placed. Must be at least the largest alignment used inside a range.
+  static constexpr u32 SHARD_ALIGN = 64;
+
+  /// Get the current position. All section writers must be flushed.
+  ShardMark shard_mark() noexcept;
+
+  /// Start a new range: pad all sections to SHARD_ALIGN and ensure that the
+  /// next FDE gets a CIE inside the range. All section writers must be flushed
+  /// and switched to their section again afterwards.
+  ShardMark shard_begin() noexcept;
+
+  /// Append the range [begin, end) of shard to this assembler. Sections and
+  /// symbols up to prefix, which is the mark after the initial symbol and data
+  /// definitions, must be identical in both assemblers. defined_syms are
+  /// symbols from the prefix that were defined inside the range (typically
+  /// functions). Ranges must only reference symbols from the prefix, from the
+  /// range itself, or global symbols. Ranges of the same shard must be merged
+  /// in order.
+  void shard_merge(AssemblerElfBase &shard,
+                   const ShardMark &prefix,
+                   const ShardMark &begin,
+                   const ShardMark &end,
+                   std::span<const SymRef> defined_syms) noexcept;
+
   // Output file generation
 
   std::vector<u8> build_object_file() noexcept;
+
+  /// Replace the contents of the assembler with an object file previously
+  /// created by build_object_file for the same target, e.g. to map a cached
+  /// object file into memory. Returns false if the object is malformed, in
+  /// which case the assembler is left unchanged.
+  bool load_object_file(std::span<const u8> obj) noexcept;
 };
 
 template <typename Derived>
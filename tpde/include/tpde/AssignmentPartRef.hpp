@@ -16,12 +16,13 @@ class AssignmentPartRef {
 
   // note for how parts are structured:
   // |15|14|13|12|11|10|09|08|07|06|05|04|03|02|01|00|
-  // |  |   PS   |RV|  |IM|FA|  bank  |    reg_id    |
+  // |  |   PS   |RV|EV|IM|FA|  bank  |    reg_id    |
   //                         |      full_reg_id      |
   //
   // PS: 1 << PS = part size (TODO(ts): maybe swap with NP so that it can be
   //     extracted easier?)
   // RV: Register Valid
+  // EV: Was the value evicted from its register to free the register?
   // IM: Is the current register value not on the stack?
   // FA: Is the assignment a fixed assignment?
   //
@@ -86,6 +87,18 @@ public:
     }
   }
 
+  [[nodiscard]] bool evicted() const noexcept {
+    return (va->parts[part] & (1u << 10)) != 0;
+  }
+
+  void set_evicted(const bool val) noexcept {
+    if (val) {
+      va->parts[part] |= (1u << 10);
+    } else {
+      va->parts[part] &= ~(1u << 10);
+    }
+  }
+
   [[nodiscard]] bool variable_ref() const noexcept { return va->variable_ref; }
 
   [[nodiscard]] bool is_stack_variable() const noexcept {
@@ -4,8 +4,10 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <functional>
-#include <unordered_map>
+#include <span>
+#include <thread>
 #include <variant>
 
 #include "Analyzer.hpp"
@@ -120,9 +122,13 @@ struct CompilerBase {
     // TODO(ts): make the allocations for 4/8 different from the others
     // since they are probably the one's most used?
     util::SmallVector<i32, 16> fixed_free_lists[5] = {};
-    /// Free-Lists for all other sizes
-    // TODO(ts): think about which data structure we want here
-    std::unordered_map<u32, std::vector<i32>> dynamic_free_lists{};
+    /// Free ranges for all other sizes, sorted by offset. Offsets and sizes
+    /// are multiples of 16, adjacent ranges are merged on free.
+    struct FreeRange {
+      u32 off;
+      u32 size;
+    };
+    util::SmallVector<FreeRange, 16> free_ranges = {};
   } stack = {};
 
   typename Analyzer<Adaptor>::BlockIndex cur_block_idx;
@@ -157,6 +163,9 @@ private:
   /// Default CCAssigner if the implementation doesn't override cur_cc_assigner.
   typename Config::DefaultCCAssigner default_cc_assigner;
 
+  /// Set by reset_keep_adaptor to skip resetting the adaptor in reset.
+  bool keep_adaptor_on_reset = false;
+
 public:
   Assembler assembler;
   Assembler::SectionWriter text_writer;
@@ -166,6 +175,37 @@ public:
   // allocations
   util::SmallVector<typename Assembler::Label> block_labels;
 
+  /// Register assignment at a branch to a block that has the branching block
+  /// as single predecessor and is not compiled directly afterwards. Restored
+  /// when compiling that block, so it does not need to reload these values.
+  /// The values are also spilled at the branch, so entries whose register is
+  /// taken when compiling the block can be dropped.
+  struct RegSnapshotEntry {
+    ValLocalIdx local_idx;
+    u8 reg_id;
+    u8 part;
+  };
+  util::SmallVector<RegSnapshotEntry, 32> reg_snapshot_entries;
+  /// Per block: range [first, second) into reg_snapshot_entries.
+  util::SmallVector<std::pair<u32, u32>, Analyzer<Adaptor>::SMALL_BLOCK_NUM>
+      block_reg_snapshots;
+
+  /// Uses of values in the current block as pairs of local index and
+  /// instruction position, sorted. Only computed if next_use_eviction() is
+  /// true, used to evict the value whose next use is farthest away.
+  util::SmallVector<std::pair<u32, u32>, 64> block_uses;
+  /// Position of the instruction currently compiled in the current block.
+  u32 cur_inst_pos = 0;
+
+  /// Number of values reloaded from the stack after being evicted by
+  /// select_reg_evict, for measuring the quality of eviction decisions.
+  u64 evict_reloads = 0;
+
+  /// Index into the PHI node list of move_to_phi_nodes_impl, indexed by the
+  /// local index of the PHI. Only entries for PHIs of the current target are
+  /// valid, stale entries are detected by checking the PHI of the node.
+  util::SmallVector<u32, 0> phi_node_idx;
+
   util::SmallVector<
       std::pair<typename Assembler::SymRef, typename Assembler::SymRef>,
       4>
@@ -290,10 +330,38 @@ public:
   /// \returns Whether the compilation was successful
   bool compile();
 
+  /// Compile the functions returned by Adaptor::funcs using multiple threads.
+  ///
+  /// Functions are split into chunks of \p chunk_size functions in the order
+  /// returned by Adaptor::funcs, chunks are compiled by the \p workers and
+  /// then appended to this compiler's assembler in order. The resulting object
+  /// file therefore does not depend on the number of workers or on thread
+  /// scheduling. \p workers must be freshly constructed (or reset) compilers
+  /// for the same IR with their own adaptors and must not include this
+  /// compiler. The first worker runs on the calling thread.
+  ///
+  /// \warning The adaptor must not modify IR that is shared between
+  ///   functions during compilation, as the adaptors of multiple workers
+  ///   access the IR concurrently. The LLVM adaptor does not satisfy this
+  ///   (it rewrites constant expressions into instructions), so tpde-llvm
+  ///   does not support parallel compilation.
+  ///
+  /// \returns Whether the compilation was successful
+  bool compile_parallel(std::span<Derived *const> workers,
+                        u32 chunk_size = 256);
+
   /// Reset any leftover data from the previous compilation such that it will
   /// not affect the next compilation
   void reset();
 
+  /// Like reset, but keep the state of the adaptor, e.g. to compile further
+  /// functions of the current module into a new object.
+  void reset_keep_adaptor() {
+    keep_adaptor_on_reset = true;
+    derived()->reset();
+    keep_adaptor_on_reset = false;
+  }
+
   /// Get CCAssigner for current function.
   CCAssigner *cur_cc_assigner() noexcept { return &default_cc_assigner; }
 
@@ -417,6 +485,14 @@ public:
 
   bool try_force_fixed_assignment(IRValueRef) const noexcept { return false; }
 
+  /// Whether to record the register assignment at branches to later blocks
+  /// with a single predecessor and restore it there, see spill_before_branch.
+  bool use_reg_snapshots() const noexcept { return false; }
+
+  /// Whether to compute instruction-level next uses for each block and use
+  /// them as primary criterion for selecting registers to evict.
+  bool next_use_eviction() const noexcept { return false; }
+
   bool hook_post_func_sym_init() noexcept { return true; }
 
   void analysis_start() noexcept {}
@@ -437,11 +513,30 @@ public:
   }
 
 protected:
+  /// Create symbols for all functions, must be called before compiling
+  /// any function.
+  bool init_func_syms() noexcept;
+
   Assembler::SymRef get_personality_sym() noexcept;
 
   bool compile_func(IRFuncRef func, u32 func_idx) noexcept;
 
   bool compile_block(IRBlockRef block, u32 block_idx) noexcept;
+
+private:
+  struct ParallelChunk {
+    u32 worker = 0;
+    bool success = false;
+    typename Assembler::ShardMark begin, end;
+  };
+
+  /// Compile chunks of \p funcs until \p next_chunk exceeds the number of
+  /// chunks. Called on the worker compiler.
+  void compile_parallel_worker(std::span<const IRFuncRef> funcs,
+                               u32 chunk_size,
+                               u32 worker_idx,
+                               std::atomic<u32> &next_chunk,
+                               std::span<ParallelChunk> chunks) noexcept;
 };
 } // namespace tpde
 
@@ -675,7 +770,7 @@ void CompilerBase<Adaptor, Derived, Config>::RetBuilder::ret() noexcept {
 }
 
 template <IRAdaptor Adaptor, typename Derived, CompilerConfig Config>
-bool CompilerBase<Adaptor, Derived, Config>::compile() {
+bool CompilerBase<Adaptor, Derived, Config>::init_func_syms() noexcept {
   // create function symbols
   text_writer.switch_section(
       assembler.get_section(assembler.get_text_section()));
@@ -702,10 +797,19 @@ bool CompilerBase<Adaptor, Derived, Config>::compile() {
     TPDE_LOG_ERR("hook_pust_func_sym_init failed");
     return false;
   }
+  return true;
+}
+
+template <IRAdaptor Adaptor, typename Derived, CompilerConfig Config>
+bool CompilerBase<Adaptor, Derived, Config>::compile() {
+  if (!init_func_syms()) {
+    return false;
+  }
 
   // TODO(ts): create function labels?
 
   bool success = true;
+  evict_reloads = 0;
 
   u32 func_idx = 0;
   for (const IRFuncRef func : adaptor->funcs()) {
@@ -727,20 +831,149 @@ bool CompilerBase<Adaptor, Derived, Config>::compile() {
 
   text_writer.flush();
   assembler.finalize();
+  TPDE_LOG_TRACE("{} reloads of evicted values", evict_reloads);
 
   // TODO(ts): generate object/map?
 
   return success;
 }
 
+template <IRAdaptor Adaptor, typename Derived, CompilerConfig Config>
+void CompilerBase<Adaptor, Derived, Config>::compile_parallel_worker(
+    std::span<const IRFuncRef> funcs,
+    u32 chunk_size,
+    u32 worker_idx,
+    std::atomic<u32> &next_chunk,
+    std::span<ParallelChunk> chunks) noexcept {
+  while (true) {
+    u32 chunk_idx = next_chunk.fetch_add(1, std::memory_order_relaxed);
+    if (chunk_idx >= chunks.size()) {
+      break;
+    }
+
+    ParallelChunk &chunk = chunks[chunk_idx];
+    chunk.worker = worker_idx;
+    chunk.success = true;
+
+    // Each chunk must be self-contained, so don't reuse personality symbols
+    // created by previous chunks.
+    personality_syms.clear();
+    chunk.begin = assembler.shard_begin();
+    // shard_begin may have padded the text section.
+    text_writer.switch_section(
+        assembler.get_section(text_writer.get_sec_ref()));
+
+    u32 start = chunk_idx * chunk_size;
+    u32 end = std::min<u32>(start + chunk_size, funcs.size());
+    for (u32 func_idx = start; func_idx < end; ++func_idx) {
+      const IRFuncRef func = funcs[func_idx];
+      if (adaptor->func_extern(func)) {
+        continue;
+      }
+
+      TPDE_LOG_TRACE("Compiling func {}", adaptor->func_link_name(func));
+      if (!derived()->compile_func(func, func_idx)) {
+        TPDE_LOG_ERR("Failed to compile function {}",
+                     adaptor->func_link_name(func));
+        chunk.success = false;
+      }
+    }
+
+    text_writer.flush();
+    chunk.end = assembler.shard_mark();
+  }
+}
+
+template <IRAdaptor Adaptor, typename Derived, CompilerConfig Config>
+bool CompilerBase<Adaptor, Derived, Config>::compile_parallel(
+    std::span<Derived *const> workers, u32 chunk_size) {
+  assert(!workers.empty() && chunk_size > 0);
+  if (!init_func_syms()) {
+    return false;
+  }
+  text_writer.flush();
+  evict_reloads = 0;
+
+  std::vector<IRFuncRef> funcs;
+  for (const IRFuncRef func : adaptor->funcs()) {
+    funcs.push_back(func);
+  }
+  assert(funcs.size() == func_syms.size());
+
+  // All workers create the same symbols in the same order, so the symbols and
+  // sections up to this point are identical in all assemblers.
+  util::SmallVector<typename Assembler::ShardMark, 8> prefixes;
+  for (Derived *worker : workers) {
+    assert(worker != derived());
+    if (!worker->init_func_syms()) {
+      return false;
+    }
+    worker->text_writer.flush();
+    worker->evict_reloads = 0;
+    prefixes.push_back(worker->assembler.shard_mark());
+  }
+
+  u32 chunk_count = (funcs.size() + chunk_size - 1) / chunk_size;
+  std::vector<ParallelChunk> chunks(chunk_count);
+  std::atomic<u32> next_chunk = 0;
+
+  std::vector<std::thread> threads;
+  for (u32 i = 1; i < workers.size(); ++i) {
+    threads.emplace_back([&, i] {
+      workers[i]->compile_parallel_worker(
+          funcs, chunk_size, i, next_chunk, chunks);
+    });
+  }
+  workers[0]->compile_parallel_worker(funcs, chunk_size, 0, next_chunk, chunks);
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  bool success = true;
+  util::SmallVector<typename Assembler::SymRef, 16> defined;
+  for (u32 chunk_idx = 0; chunk_idx < chunk_count; ++chunk_idx) {
+    const ParallelChunk &chunk = chunks[chunk_idx];
+    success &= chunk.success;
+
+    defined.clear();
+    u32 start = chunk_idx * chunk_size;
+    u32 end = std::min<u32>(start + chunk_size, funcs.size());
+    for (u32 func_idx = start; func_idx < end; ++func_idx) {
+      if (!adaptor->func_extern(funcs[func_idx])) {
+        defined.push_back(func_syms[func_idx]);
+      }
+    }
+
+    Derived *worker = workers[chunk.worker];
+    assembler.shard_merge(worker->assembler,
+                          prefixes[chunk.worker],
+                          chunk.begin,
+                          chunk.end,
+                          defined);
+  }
+
+  text_writer.switch_section(
+      assembler.get_section(assembler.get_text_section()));
+  assembler.finalize();
+
+  for (Derived *worker : workers) {
+    evict_reloads += worker->evict_reloads;
+  }
+  TPDE_LOG_TRACE("{} reloads of evicted values", evict_reloads);
+
+  return success;
+}
+
 template <IRAdaptor Adaptor, typename Derived, CompilerConfig Config>
 void CompilerBase<Adaptor, Derived, Config>::reset() {
-  adaptor->reset();
+  if (!keep_adaptor_on_reset) {
+    adaptor->reset();
+  }
 
   for (auto &e : stack.fixed_free_lists) {
     e.clear();
   }
-  stack.dynamic_free_lists.clear();
+  stack.free_ranges.clear();
 
   assembler.reset();
   func_syms.clear();
@@ -772,8 +1005,6 @@ void CompilerBase<Adaptor, Derived, Config>::init_assignment(
     ap.set_part_size(size);
   }
 
-  const auto &liveness = analyzer.liveness_info(local_idx);
-
   // if there is only one part, try to hand out a fixed assignment
   // if the value is used for longer than one block and there aren't too many
   // definitions in child loops this could interfere with
@@ -787,7 +1018,7 @@ void CompilerBase<Adaptor, Derived, Config>::init_assignment(
     auto ap = AssignmentPartRef{assignment, 0};
 
     auto try_fixed =
-        liveness.last > cur_block_idx &&
+        analyzer.liveness_range(local_idx).last > cur_block_idx &&
         cur_loop.definitions_in_childs +
                 assignments.cur_fixed_assignment_count[ap.bank().id()] <
             Derived::NUM_FIXED_ASSIGNMENTS[ap.bank().id()];
@@ -819,8 +1050,8 @@ void CompilerBase<Adaptor, Derived, Config>::init_assignment(
     }
   }
 
-  const auto last_full = liveness.last_full;
-  const auto ref_count = liveness.ref_count;
+  const auto last_full = analyzer.liveness_last_full(local_idx);
+  const auto ref_count = analyzer.liveness_ref_count(local_idx);
 
   assert(max_part_size <= 256);
   assignment->max_part_size = max_part_size;
@@ -923,11 +1154,37 @@ i32 CompilerBase<Adaptor, Derived, Config>::allocate_stack_slot(
     }
   } else {
     size = util::align_up(size, 16);
-    auto it = stack.dynamic_free_lists.find(size);
-    if (it != stack.dynamic_free_lists.end() && !it->second.empty()) {
-      const auto slot = it->second.back();
-      it->second.pop_back();
-      return slot;
+
+    // Best fit, splitting off the remainder of a larger range.
+    auto &ranges = stack.free_ranges;
+    u32 best = ranges.size();
+    for (u32 i = 0; i < ranges.size(); ++i) {
+      if (ranges[i].size >= size &&
+          (best == ranges.size() || ranges[i].size < ranges[best].size)) {
+        best = i;
+        if (ranges[i].size == size) {
+          break;
+        }
+      }
+    }
+
+    if (best != ranges.size()) {
+      const u32 off = ranges[best].off;
+      if (ranges[best].size == size) {
+        ranges.erase(ranges.begin() + best, ranges.begin() + best + 1);
+      } else {
+        ranges[best].off += size;
+        ranges[best].size -= size;
+      }
+      return Config::FRAME_INDEXING_NEGATIVE ? -static_cast<i32>(off + size)
+                                             : static_cast<i32>(off);
+    }
+
+    // If the last free range is at the end of the frame, grow it in place.
+    if (!ranges.empty() &&
+        ranges.back().off + ranges.back().size == stack.frame_size) {
+      stack.frame_size = ranges.back().off;
+      ranges.pop_back();
     }
   }
 
@@ -966,7 +1223,35 @@ void CompilerBase<Adaptor, Derived, Config>::free_stack_slot(
     stack.fixed_free_lists[free_list_idx].push_back(slot);
   } else {
     size = util::align_up(size, 16);
-    stack.dynamic_free_lists[size].push_back(slot);
+    u32 off = slot;
+    if constexpr (Config::FRAME_INDEXING_NEGATIVE) {
+      off = -static_cast<i32>(slot) - size;
+    }
+
+    auto &ranges = stack.free_ranges;
+    auto it = std::lower_bound(
+        ranges.begin(), ranges.end(), off, [](const auto &range, u32 val) {
+          return range.off < val;
+        });
+    assert((it == ranges.end() || off + size <= it->off) &&
+           "double free of stack slot");
+    const bool merge_prev =
+        it != ranges.begin() && (it - 1)->off + (it - 1)->size == off;
+    const bool merge_next = it != ranges.end() && off + size == it->off;
+    if (merge_prev && merge_next) {
+      (it - 1)->size += size + it->size;
+      ranges.erase(it, it + 1);
+    } else if (merge_prev) {
+      (it - 1)->size += size;
+    } else if (merge_next) {
+      it->off = off;
+      it->size += size;
+    } else {
+      const u32 idx = it - ranges.begin();
+      ranges.push_back({});
+      std::move_backward(ranges.begin() + idx, ranges.end() - 1, ranges.end());
+      ranges[idx] = {off, size};
+    }
   }
 }
 
@@ -1203,26 +1488,43 @@ Reg CompilerBase<Adaptor, Derived, Config>::select_reg_evict(
     }
 
     u32 score = 0;
-    if (ap.stack_valid()) {
-      score |= u32{1} << 31;
-    }
+    const auto &live_range = analyzer.liveness_range(local_idx);
+    u32 refs_left = va->pending_free ? 0 : va->references_left;
+    if (derived()->next_use_eviction()) {
+      // Belady: prefer the value whose next use is farthest away, values not
+      // used anymore in this block first. Then prefer already spilled values.
+      auto it = std::lower_bound(block_uses.begin(),
+                                 block_uses.end(),
+                                 std::pair{u32(local_idx), cur_inst_pos});
+      u32 next_use_dist = 0xffff;
+      if (it != block_uses.end() && it->first == u32(local_idx)) {
+        next_use_dist = std::min(it->second - cur_inst_pos, u32{0xfffe});
+      }
+      score |= next_use_dist << 16;
+      if (ap.stack_valid()) {
+        score |= u32{1} << 15;
+      }
+      score |= (refs_left < 0x7fff ? 0x8000 - refs_left : 1);
+    } else {
+      if (ap.stack_valid()) {
+        score |= u32{1} << 31;
+      }
 
-    const auto &liveness = analyzer.liveness_info(local_idx);
-    u32 last_use_dist = u32(liveness.last) - u32(cur_block_idx);
-    score |= (last_use_dist < 0x8000 ? 0x8000 - last_use_dist : 0) << 16;
+      u32 last_use_dist = u32(live_range.last) - u32(cur_block_idx);
+      score |= (last_use_dist < 0x8000 ? 0x8000 - last_use_dist : 0) << 16;
 
-    u32 refs_left = va->pending_free ? 0 : va->references_left;
-    score |= (refs_left < 0xffff ? 0x10000 - refs_left : 1);
+      score |= (refs_left < 0xffff ? 0x10000 - refs_left : 1);
+    }
 
     TPDE_LOG_DBG("  r{} ({}:{}) rc={}/{} live={}-{}{} spilled={} score={:#x}",
                  reg_id,
                  u32(local_idx),
                  part,
                  refs_left,
-                 liveness.ref_count,
-                 u32(liveness.first),
-                 u32(liveness.last),
-                 &"*"[!liveness.last_full],
+                 analyzer.liveness_ref_count(local_idx),
+                 u32(live_range.first),
+                 u32(live_range.last),
+                 &"*"[!analyzer.liveness_last_full(local_idx)],
                  ap.stack_valid(),
                  score);
 
@@ -1236,6 +1538,9 @@ Reg CompilerBase<Adaptor, Derived, Config>::select_reg_evict(
     TPDE_FATAL("ran out of registers for scratch registers");
   }
   TPDE_LOG_DBG("  selected r{}", candidate.id());
+  AssignmentPartRef{val_assignment(register_file.reg_local_idx(candidate)),
+                    register_file.reg_part(candidate)}
+      .set_evicted(true);
   evict_reg(candidate);
   return candidate;
 }
@@ -1243,6 +1548,10 @@ Reg CompilerBase<Adaptor, Derived, Config>::select_reg_evict(
 template <IRAdaptor Adaptor, typename Derived, CompilerConfig Config>
 void CompilerBase<Adaptor, Derived, Config>::reload_to_reg(
     AsmReg dst, AssignmentPartRef ap) noexcept {
+  if (ap.evicted()) {
+    ap.set_evicted(false);
+    ++evict_reloads;
+  }
   if (!ap.variable_ref()) {
     assert(ap.stack_valid());
     derived()->load_from_stack(dst, ap.frame_off(), ap.part_size());
@@ -1346,6 +1655,12 @@ typename CompilerBase<Adaptor, Derived, Config>::RegisterFile::RegBitSet
   //
   // Values which are only read from PHI-Nodes and have no extended lifetimes,
   // do not need to be spilled as they die at the edge.
+  //
+  // If enabled, successors that are not the next block, but have the current
+  // block as their only predecessor and no PHI-nodes, get a snapshot of the
+  // register assignment, which is restored when compiling them so that the
+  // values need not be reloaded. The values are still spilled, as the
+  // registers might be taken by then.
 
   using RegBitSet = typename RegisterFile::RegBitSet;
 
@@ -1353,6 +1668,21 @@ typename CompilerBase<Adaptor, Derived, Config>::RegisterFile::RegBitSet
 
   const IRBlockRef cur_block_ref = analyzer.block_ref(cur_block_idx);
 
+  if (force_spill) {
+    // A previous call for the same branch might have recorded a snapshot.
+    for (const IRBlockRef succ : adaptor->block_succs(cur_block_ref)) {
+      block_reg_snapshots[static_cast<u32>(analyzer.block_idx(succ))] = {0, 0};
+    }
+  }
+
+  const auto takes_reg_snapshot = [&](const IRBlockRef succ) {
+    return !force_spill && derived()->use_reg_snapshots() &&
+           static_cast<u32>(analyzer.block_idx(succ)) >
+               static_cast<u32>(cur_block_idx) + 1 &&
+           !analyzer.block_has_multiple_incoming(succ) &&
+           !analyzer.block_has_phis(succ);
+  };
+
   bool must_spill = force_spill;
   if (!must_spill) {
     // We must always spill if no block is immediately succeeding or that block
@@ -1418,8 +1748,8 @@ typename CompilerBase<Adaptor, Derived, Config>::RegisterFile::RegBitSet
       return false;
     }
 
-    const auto &liveness = analyzer.liveness_info(local_idx);
-    if (liveness.last <= cur_block_idx) {
+    const auto &live_range = analyzer.liveness_range(local_idx);
+    if (live_range.last <= cur_block_idx) {
       // no need to spill value if it dies immediately after the block
       return false;
     }
@@ -1436,7 +1766,7 @@ typename CompilerBase<Adaptor, Derived, Config>::RegisterFile::RegBitSet
       if (static_cast<u32>(block_idx) == static_cast<u32>(cur_block_idx) + 1) {
         continue;
       }
-      if (block_idx >= liveness.first && block_idx <= liveness.last) {
+      if (block_idx >= live_range.first && block_idx <= live_range.last) {
         spill(ap);
         return false;
       }
@@ -1458,6 +1788,38 @@ typename CompilerBase<Adaptor, Derived, Config>::RegisterFile::RegBitSet
     }
   }
 
+  const u32 snapshot_start = reg_snapshot_entries.size();
+  for (const IRBlockRef succ : adaptor->block_succs(cur_block_ref)) {
+    if (!takes_reg_snapshot(succ)) {
+      continue;
+    }
+    const auto block_idx = analyzer.block_idx(succ);
+    auto &range = block_reg_snapshots[static_cast<u32>(block_idx)];
+    if (range.first >= snapshot_start && range.second > range.first) {
+      // already recorded, e.g. for a switch with multiple cases to the block
+      continue;
+    }
+
+    range.first = reg_snapshot_entries.size();
+    for (auto reg_id : register_file.used_nonfixed_regs()) {
+      const auto local_idx = register_file.reg_local_idx(Reg{reg_id});
+      if (local_idx == INVALID_VAL_LOCAL_IDX) {
+        continue;
+      }
+      const auto part = register_file.reg_part(Reg{reg_id});
+      auto ap = AssignmentPartRef{val_assignment(local_idx), part};
+      const auto &live_range = analyzer.liveness_range(local_idx);
+      if (ap.variable_ref() || block_idx < live_range.first ||
+          block_idx > live_range.last) {
+        continue;
+      }
+      assert(!ap.modified());
+      reg_snapshot_entries.push_back(RegSnapshotEntry{
+          local_idx, static_cast<u8>(reg_id), static_cast<u8>(part)});
+    }
+    range.second = reg_snapshot_entries.size();
+  }
+
   return spilled;
 }
 
@@ -1592,18 +1954,9 @@ void CompilerBase<Adaptor, Derived, Config>::move_to_phi_nodes_impl(
     IRValueRef phi;
     IRValueRef incoming_val;
     ValLocalIdx phi_local_idx;
-    // local idx of same-block phi node that needs special handling
-    ValLocalIdx incoming_phi_local_idx = INVALID_VAL_LOCAL_IDX;
-    // bool incoming_is_phi;
+    // index of same-block phi node that needs special handling
+    u32 incoming_phi_node = ~0u;
     u32 ref_count;
-
-    bool operator<(const NodeEntry &other) const noexcept {
-      return phi_local_idx < other.phi_local_idx;
-    }
-
-    bool operator<(ValLocalIdx other) const noexcept {
-      return phi_local_idx < other;
-    }
   };
 
   util::SmallVector<NodeEntry, 16> nodes;
@@ -1661,8 +2014,15 @@ void CompilerBase<Adaptor, Derived, Config>::move_to_phi_nodes_impl(
     return;
   }
 
-  // sort so we can binary search later
-  std::sort(nodes.begin(), nodes.end());
+  // Map PHIs to their node to find incoming values that are PHIs of the same
+  // block in constant time. The map is not reset between calls, entries are
+  // validated by comparing the PHI.
+  if (phi_node_idx.size() < analyzer.liveness_size()) {
+    phi_node_idx.resize(analyzer.liveness_size());
+  }
+  for (u32 i = 0; i < nodes.size(); ++i) {
+    phi_node_idx[static_cast<u32>(nodes[i].phi_local_idx)] = i;
+  }
 
   // fill in the refcount
   auto all_zero_ref = true;
@@ -1675,14 +2035,14 @@ void CompilerBase<Adaptor, Derived, Config>::move_to_phi_nodes_impl(
     }
 
     ValLocalIdx inc_local_idx = adaptor->val_local_idx(node.incoming_val);
-    auto it = std::lower_bound(nodes.begin(), nodes.end(), inc_local_idx);
-    if (it == nodes.end() || it->phi != node.incoming_val) {
+    u32 inc_node = phi_node_idx[static_cast<u32>(inc_local_idx)];
+    if (inc_node >= nodes.size() || nodes[inc_node].phi != node.incoming_val) {
       // Incoming value is a PHI node, but it's not from our block, so we don't
       // need to be particularly careful when assigning values.
       continue;
     }
-    node.incoming_phi_local_idx = inc_local_idx;
-    ++it->ref_count;
+    node.incoming_phi_node = inc_node;
+    ++nodes[inc_node].ref_count;
     all_zero_ref = false;
   }
 
@@ -1694,18 +2054,19 @@ void CompilerBase<Adaptor, Derived, Config>::move_to_phi_nodes_impl(
     return;
   }
 
-  // TODO(ts): this is rather inefficient...
+  // Sequentialize the parallel move: values that are not needed by any other
+  // PHI are moved first, which in turn can free the values they read. Once
+  // only cycles remain, one value of a cycle is saved to a temporary. Nodes
+  // never become waiting again, so the search for the next cycle resumes
+  // where the previous one stopped and the whole process is linear.
   util::SmallVector<u32, 32> ready_indices;
   ready_indices.reserve(nodes.size());
-  util::SmallBitSet<256> waiting_nodes;
-  waiting_nodes.resize(nodes.size());
   for (u32 i = 0; i < nodes.size(); ++i) {
-    if (nodes[i].ref_count) {
-      waiting_nodes.mark_set(i);
-    } else {
+    if (!nodes[i].ref_count) {
       ready_indices.push_back(i);
     }
   }
+  u32 cycle_search_idx = 0;
 
   u32 handled_count = 0;
   u32 cur_tmp_part_count = 0;
@@ -1749,9 +2110,11 @@ void CompilerBase<Adaptor, Derived, Config>::move_to_phi_nodes_impl(
   while (handled_count != nodes.size()) {
     if (ready_indices.empty()) {
       // need to break a cycle
-      auto cur_idx_opt = waiting_nodes.first_set();
-      assert(cur_idx_opt);
-      auto cur_idx = *cur_idx_opt;
+      while (nodes[cycle_search_idx].ref_count == 0) {
+        ++cycle_search_idx;
+        assert(cycle_search_idx < nodes.size());
+      }
+      auto cur_idx = cycle_search_idx;
       assert(nodes[cur_idx].ref_count == 1);
       assert(cur_tmp_val == Adaptor::INVALID_VALUE_REF);
 
@@ -1798,7 +2161,6 @@ void CompilerBase<Adaptor, Derived, Config>::move_to_phi_nodes_impl(
 
       nodes[cur_idx].ref_count = 0;
       ready_indices.push_back(cur_idx);
-      waiting_nodes.mark_unset(cur_idx);
     }
 
     for (u32 i = 0; i < ready_indices.size(); ++i) {
@@ -1830,20 +2192,16 @@ void CompilerBase<Adaptor, Derived, Config>::move_to_phi_nodes_impl(
 
       move_to_phi(phi_val, incoming_val);
 
-      if (nodes[cur_idx].incoming_phi_local_idx == INVALID_VAL_LOCAL_IDX) {
+      u32 inc_node = nodes[cur_idx].incoming_phi_node;
+      if (inc_node == ~0u) {
         continue;
       }
 
-      auto it = std::lower_bound(
-          nodes.begin(), nodes.end(), nodes[cur_idx].incoming_phi_local_idx);
-      assert(it != nodes.end() && it->phi == incoming_val &&
-             "incoming_phi_local_idx set incorrectly");
-
-      assert(it->ref_count > 0);
-      if (--it->ref_count == 0) {
-        auto node_idx = static_cast<u32>(it - nodes.begin());
-        ready_indices.push_back(node_idx);
-        waiting_nodes.mark_unset(node_idx);
+      assert(nodes[inc_node].phi == incoming_val &&
+             "incoming_phi_node set incorrectly");
+      assert(nodes[inc_node].ref_count > 0);
+      if (--nodes[inc_node].ref_count == 0) {
+        ready_indices.push_back(inc_node);
       }
     }
     ready_indices.clear();
@@ -1905,12 +2263,12 @@ bool CompilerBase<Adaptor, Derived, Config>::compile_func(
   for (auto &e : stack.fixed_free_lists) {
     e.clear();
   }
-  stack.dynamic_free_lists.clear();
+  stack.free_ranges.clear();
 
   assignments.cur_fixed_assignment_count = {};
   assert(std::ranges::none_of(assignments.value_ptrs, std::identity{}));
-  if (assignments.value_ptrs.size() < analyzer.liveness.size()) {
-    assignments.value_ptrs.resize(analyzer.liveness.size());
+  if (assignments.value_ptrs.size() < analyzer.liveness_size()) {
+    assignments.value_ptrs.resize(analyzer.liveness_size());
   }
 
   assignments.allocator.reset();
@@ -1940,6 +2298,10 @@ bool CompilerBase<Adaptor, Derived, Config>::compile_func(
     block_labels[i] = assembler.label_create();
   }
 
+  reg_snapshot_entries.clear();
+  block_reg_snapshots.clear();
+  block_reg_snapshots.resize(analyzer.block_layout.size(), {0, 0});
+
   // TODO(ts): place function label
   // TODO(ts): make function labels optional?
 
@@ -2006,9 +2368,42 @@ bool CompilerBase<Adaptor, Derived, Config>::compile_block(
       static_cast<typename Analyzer<Adaptor>::BlockIndex>(block_idx);
 
   label_place(block_labels[block_idx]);
+
+  // Restore the register assignment from the end of the single predecessor.
+  // The register might have been taken in between, e.g. by a value with a
+  // fixed assignment; the value was spilled at the branch, so it is simply
+  // reloaded from its stack slot then.
+  const auto [snapshot_begin, snapshot_end] = block_reg_snapshots[block_idx];
+  for (u32 i = snapshot_begin; i < snapshot_end; ++i) {
+    const RegSnapshotEntry &entry = reg_snapshot_entries[i];
+    Reg reg{entry.reg_id};
+    AssignmentPartRef ap{val_assignment(entry.local_idx), entry.part};
+    if (register_file.is_used(reg) || ap.register_valid()) {
+      continue;
+    }
+    ap.set_reg(reg);
+    ap.set_register_valid(true);
+    register_file.mark_used(reg, entry.local_idx, entry.part);
+  }
+
+  block_uses.clear();
+  if (derived()->next_use_eviction()) {
+    u32 pos = 0;
+    for (const IRInstRef inst : adaptor->block_insts(block)) {
+      for (const IRValueRef operand : adaptor->inst_operands(inst)) {
+        if (!adaptor->val_ignore_in_liveness_analysis(operand)) {
+          block_uses.emplace_back(u32(adaptor->val_local_idx(operand)), pos);
+        }
+      }
+      ++pos;
+    }
+    std::sort(block_uses.begin(), block_uses.end());
+  }
+
   auto &&val_range = adaptor->block_insts(block);
   auto end = val_range.end();
-  for (auto it = val_range.begin(); it != end; ++it) {
+  cur_inst_pos = 0;
+  for (auto it = val_range.begin(); it != end; ++it, ++cur_inst_pos) {
     const IRInstRef inst = *it;
     if (this->adaptor->inst_fused(inst)) {
       continue;
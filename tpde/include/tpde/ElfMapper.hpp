@@ -2,6 +2,9 @@
 // SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
 #pragma once
 
+#include <atomic>
+#include <map>
+#include <mutex>
 #include <string_view>
 
 #include "base.hpp"
@@ -11,15 +14,85 @@
 
 namespace tpde {
 
+/// Address range reserved once for JIT-compiled code and data, from which
+/// mappings are allocated next to each other. This avoids address space
+/// fragmentation and allows direct calls between mapped modules. Freed ranges
+/// are reused for later allocations.
+class JITArena {
+  u8 *base = nullptr;
+  size_t size = 0;
+
+  std::mutex mutex;
+  /// Free ranges, map from offset to size.
+  std::map<size_t, size_t> free_ranges;
+
+public:
+  /// Reserve size bytes of address space. If the reservation fails, all
+  /// allocations will fail.
+  explicit JITArena(size_t size) noexcept;
+  ~JITArena();
+
+  JITArena(const JITArena &) = delete;
+  JITArena &operator=(const JITArena &) = delete;
+
+  /// The arena shared by all ElfMappers and LazyStubs of the process. It is
+  /// reserved on first use and never released.
+  static JITArena &shared() noexcept;
+
+  /// Allocate size bytes of zeroed, readable and writable memory, rounded up to
+  /// the page size. Returns null if the arena is exhausted. Thread-safe.
+  u8 *allocate(size_t size) noexcept;
+
+  /// Release memory previously returned by allocate. Thread-safe.
+  void free(u8 *addr, size_t size) noexcept;
+};
+
 class ElfMapper {
 public:
   // TODO: use C++26 std::function_ref
   using SymbolResolver = util::function_ref<void *(std::string_view)>;
 
+  /// How unwind info of mapped objects is registered with the system unwinder
+  /// (__register_frame). Independent of this, unwind info is always available
+  /// through find_unwind_info.
+  enum class UnwindRegistration : u8 {
+    /// Register unwind info immediately when mapping.
+    Eager,
+    /// Queue unwind info; all queued unwind info is registered at once by
+    /// register_deferred_unwind_info or the first get_sym_addr of an object
+    /// with queued unwind info. Objects that are unmapped before are never
+    /// registered.
+    Deferred,
+    /// Never register unwind info with the system unwinder, e.g. when a
+    /// custom unwinder uses find_unwind_info.
+    None,
+  };
+
+  /// Unwind information for a mapped object, see find_unwind_info.
+  struct UnwindInfo {
+    /// Start and end of the code described by the unwind info.
+    void *pc_begin;
+    void *pc_end;
+    /// Binary search table in the format of .eh_frame_hdr.
+    const u8 *eh_frame_hdr;
+    const u8 *eh_frame;
+    /// The FDE that covers the queried address, or null.
+    const u8 *fde;
+  };
+
 private:
-  u8 *mapped_addr;
-  size_t mapped_size;
+  u8 *mapped_addr = nullptr;
+  size_t mapped_size = 0;
+  /// Whether the mapping was allocated from JITArena::shared().
+  bool in_arena = false;
+  /// Whether unwind info is registered with the system unwinder or pending in
+  /// the deferred queue; both are protected by the unwind registry lock.
+  bool frame_registered = false;
+  /// Atomic, as get_sym_addr checks it without holding the lock.
+  std::atomic<bool> frame_deferred = false;
   u32 registered_frame_off = 0;
+  /// Offset of the .eh_frame_hdr-style table, zero if there are no FDEs.
+  u32 eh_frame_hdr_off = 0;
 
   u32 local_sym_count = 0;
   util::SmallVector<void *, 64> sym_addrs;
@@ -38,7 +111,81 @@ public:
 
   bool map(AssemblerElfBase &assembler, SymbolResolver resolver) noexcept;
 
+  /// Get the address of a symbol. Registers deferred unwind info, as code of
+  /// the object can be executed afterwards.
   void *get_sym_addr(AssemblerElfBase::SymRef sym) noexcept;
+
+  /// Set how objects mapped afterwards register their unwind info.
+  static void set_unwind_registration(UnwindRegistration mode) noexcept;
+
+  /// Register the unwind info of all objects mapped with deferred
+  /// registration, e.g. before an exception might be thrown through code whose
+  /// address was not obtained through get_sym_addr.
+  static void register_deferred_unwind_info() noexcept;
+
+  /// Find the unwind info for a code address in any mapped object, similar to
+  /// _dl_find_object. Returns false if the address is not in a mapped object.
+  /// Thread-safe; the lookup time is logarithmic in the number of objects.
+  static bool find_unwind_info(const void *pc, UnwindInfo &info) noexcept;
+
+private:
+  friend class UnwindRegistry;
+
+  const u8 *eh_frame_hdr() const noexcept {
+    return mapped_addr + eh_frame_hdr_off;
+  }
+};
+
+/// Executable stubs for functions that are compiled on their first call.
+///
+/// Each stub jumps through a slot, which initially points to a trampoline that
+/// preserves the argument registers, calls the resolver with the stub index and
+/// continues at the returned address. The returned address is stored in the
+/// slot, so that subsequent calls of the stub directly jump to it. If the
+/// resolver fails, the call continues at the error handler and the slot is
+/// left unchanged.
+class LazyStubs {
+public:
+  /// Compile the function for the stub, returns null on failure. Can be called
+  /// concurrently from multiple threads.
+  using Resolver = void *(*)(void *ctx, u32 idx);
+
+private:
+  u8 *mapped_addr = nullptr;
+  size_t mapped_size = 0;
+  bool in_arena = false;
+  /// Start of the stub code, the slots are at the beginning of the mapping.
+  u8 *code_addr = nullptr;
+  u32 count = 0;
+
+  Resolver resolver = nullptr;
+  void *resolver_ctx = nullptr;
+  void *error_handler = nullptr;
+
+public:
+  LazyStubs() noexcept = default;
+  ~LazyStubs() { reset(); }
+
+  LazyStubs(const LazyStubs &) = delete;
+  LazyStubs(LazyStubs &&) = delete;
+
+  LazyStubs &operator=(const LazyStubs &) = delete;
+  LazyStubs &operator=(LazyStubs &&) = delete;
+
+  void reset() noexcept;
+
+  /// Allocate count stubs, returns true on success. error_handler is called
+  /// with the arguments of a function whose compilation failed; if it is null,
+  /// such a failure aborts the process.
+  bool init(u32 count,
+            Resolver resolver,
+            void *ctx,
+            void *error_handler = nullptr) noexcept;
+
+  void *stub_addr(u32 idx) const noexcept;
+
+  /// Called by the trampoline on the first call of a stub.
+  void *resolve(u32 idx) noexcept;
 };
 
 } // namespace tpde
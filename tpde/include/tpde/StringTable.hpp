@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
 #pragma once
 
+#include "tpde/base.hpp"
 #include "tpde/util/SmallVector.hpp"
 
 #include <cstddef>
@@ -9,17 +10,43 @@
 
 namespace tpde {
 
+/// ELF string table that stores every distinct string only once.
 class StringTable {
   util::SmallVector<char, 24> strtab;
 
+  /// Open-addressing hash index (linear probing) of the strings in strtab.
+  /// Offset 0 (the empty string) marks an empty slot.
+  struct IndexEntry {
+    u32 off;
+    u32 hash;
+  };
+  util::SmallVector<IndexEntry, 0> index;
+  u32 index_count = 0;
+
 public:
   StringTable() noexcept { strtab.resize(1); }
 
   size_t size() const noexcept { return strtab.size(); }
   const char *data() const noexcept { return strtab.data(); }
 
-  size_t add(std::string_view str) noexcept;
+  size_t add(std::string_view str) noexcept {
+    return add_prefix(std::string_view{}, str);
+  }
+
+  /// Add the concatenation of prefix and str. The returned offset plus
+  /// prefix.size() is a valid offset for str; later additions of str alone
+  /// will reuse this tail.
   size_t add_prefix(std::string_view prefix, std::string_view str) noexcept;
+
+  /// Replace the contents with existing string table data, which must start
+  /// with a null byte.
+  void assign(std::string_view data) noexcept;
+
+private:
+  /// Find the offset of prefix+str, or 0 if it is not in the table.
+  u32 find(std::string_view prefix, std::string_view str, u32 hash) const
+      noexcept;
+  void index_insert(u32 off, u32 hash) noexcept;
 };
 
 } // namespace tpde
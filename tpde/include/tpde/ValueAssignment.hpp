@@ -66,7 +66,7 @@ struct ValueAssignment {
       bool stack_variable : 1;
 
       /// Whether to delay the free when the reference count reaches zero.
-      /// (This is liveness.last_full, copied here for faster access).
+      /// (This is the liveness last_full flag, copied here for faster access).
       bool delay_free : 1;
 
       // TODO: get the type of parts from Derived
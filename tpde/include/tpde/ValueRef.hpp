@@ -39,13 +39,14 @@ struct CompilerBase<Adaptor, Derived, Config>::ValueRef {
     // Extended liveness checks in debug builds.
 #ifndef NDEBUG
     if (!variable_ref()) {
-      const auto &liveness =
-          compiler->analyzer.liveness_info(state.a.local_idx);
-      assert(liveness.last >= compiler->cur_block_idx &&
+      const auto &analyzer = compiler->analyzer;
+      const auto &live_range = analyzer.liveness_range(state.a.local_idx);
+      assert(live_range.last >= compiler->cur_block_idx &&
              "ref-counted value used outside of its live range");
       assert(state.a.assignment->references_left != 0);
-      if (state.a.assignment->references_left == 1 && !liveness.last_full) {
-        assert(liveness.last == compiler->cur_block_idx &&
+      if (state.a.assignment->references_left == 1 &&
+          !analyzer.liveness_last_full(state.a.local_idx)) {
+        assert(live_range.last == compiler->cur_block_idx &&
                "liveness of non-last-full value must end at last use");
       }
     }
@@ -145,9 +146,9 @@ void CompilerBase<Adaptor, Derived, Config>::ValueRef::reset() noexcept {
         // need to wait until release
         TPDE_LOG_TRACE("Delay freeing assignment for value {}",
                        static_cast<u32>(local_idx));
-        const auto &liveness = compiler->analyzer.liveness_info(local_idx);
+        const auto &live_range = compiler->analyzer.liveness_range(local_idx);
         auto &free_list_head =
-            compiler->assignments.delayed_free_lists[u32(liveness.last)];
+            compiler->assignments.delayed_free_lists[u32(live_range.last)];
         state.a.assignment->next_delayed_free_entry = free_list_head;
         state.a.assignment->pending_free = true;
         free_list_head = local_idx;
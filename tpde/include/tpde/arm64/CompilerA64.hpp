@@ -342,6 +342,9 @@ struct CompilerA64 : BaseTy<Adaptor, Derived, Config> {
 
   enum CPU_FEATURES : u32 {
     CPU_BASELINE = 0, // ARMV8.0
+    CPU_LSE = (1 << 0),
+    CPU_FP16 = (1 << 1),
+    CPU_DOTPROD = (1 << 2),
   };
 
   CPU_FEATURES cpu_feats = CPU_BASELINE;
@@ -1382,10 +1385,8 @@ void CompilerA64<Adaptor, Derived, BaseTy, Config>::materialize_constant(
       return;
     }
 
-    auto rodata = this->assembler.get_data_section(true, false);
     std::span<const u8> raw_data{reinterpret_cast<const u8 *>(data), size};
-    auto sym = this->assembler.sym_def_data(
-        rodata, "", raw_data, 16, Assembler::SymBinding::LOCAL);
+    auto sym = this->assembler.sym_def_const(raw_data, 16);
     this->text_writer.ensure_space(8); // ensure contiguous instructions
     this->reloc_text(
         sym, R_AARCH64_ADR_PREL_PG_HI21, this->text_writer.offset(), 0);
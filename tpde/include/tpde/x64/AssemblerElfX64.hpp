@@ -24,6 +24,34 @@ struct AssemblerElfX64 : AssemblerElf<AssemblerElfX64> {
     JUMP_TABLE,
   };
 
+private:
+  /// A jump to a label inside the current function or an alignment point.
+  struct RelaxItem {
+    /// Offset of the jump instruction or the alignment padding.
+    u32 off;
+    /// Jump target, unused for alignment points.
+    Label target;
+    /// Size as emitted and size after relaxation; for alignment points, the
+    /// number of padding bytes.
+    u8 old_size, size;
+    /// Alignment of the offset after the padding, zero for jumps.
+    u8 align;
+  };
+
+  /// Branch relaxation state of the current function.
+  SecRef relax_sec = INVALID_SEC_REF;
+  u32 relax_start = 0;
+  u32 relax_first_label = 0;
+  /// Jumps and alignment points, sorted by offset.
+  std::vector<RelaxItem> relax_items;
+  /// Offsets of 32-bit PC-relative displacements to the current function.
+  std::vector<u32> relax_pcrel_disps;
+  /// Jump tables as pair of offset and number of entries.
+  std::vector<std::pair<u32, u32>> relax_jump_tables;
+  /// Temporary storage for relax_func.
+  util::SmallVector<u32, 0> relax_shrink;
+
+public:
   explicit AssemblerElfX64() = default;
 
   void add_unresolved_entry(Label label,
@@ -35,6 +63,44 @@ struct AssemblerElfX64 : AssemblerElf<AssemblerElfX64> {
 
   void handle_fixup(const TempSymbolInfo &info,
                     const TempSymbolFixup &fixup) noexcept;
+
+  /// Start branch relaxation for a function starting at off in sec. Code of
+  /// the function must not be referenced by offset except through labels
+  /// created after this call, relocations, call sites, and the jumps,
+  /// displacements, and jump tables registered below.
+  void relax_begin_func(SecRef sec, u32 off) noexcept;
+
+  /// Register a jump to target at off. Forward jumps must use the rel32
+  /// encoding; relax_func shrinks them to rel8 if the target is close enough.
+  void relax_add_jump(u32 off, Label target) noexcept {
+    relax_items.push_back(RelaxItem{off, target, 0, 0, 0});
+  }
+
+  /// Register that the code at off is padded to align, which must be a power
+  /// of two not larger than the function alignment. Must be called before
+  /// emitting the padding; relax_func adjusts the padding to the new offset.
+  void relax_add_align(u32 off, u8 align) noexcept {
+    u8 pad = util::align_up(off, align) - off;
+    relax_items.push_back(RelaxItem{off, Label{}, pad, pad, align});
+  }
+
+  /// Register a 32-bit PC-relative displacement at off that refers to a
+  /// location after the start of the function.
+  void relax_add_pcrel_disp(u32 off) noexcept {
+    relax_pcrel_disps.push_back(off);
+  }
+
+  /// Register a jump table at off with count entries, which are relative to
+  /// the table start.
+  void relax_add_jump_table(u32 off, u32 count) noexcept {
+    relax_jump_tables.emplace_back(off, count);
+  }
+
+  /// Select the shortest encoding for all registered jumps of the function
+  /// ending at end and move the code accordingly, keeping the alignment of
+  /// alignment points. All labels jumped to must be placed. Returns the new
+  /// end offset of the function.
+  [[nodiscard]] u32 relax_func(u32 end) noexcept;
 };
 
 inline void
@@ -71,6 +71,8 @@ struct AsmReg : Reg {
     XMM13,
     XMM14,
     XMM15,
+    // With AVX, XMM0-XMM15 also refer to the aliasing YMM registers for values
+    // with a part size of 32 bytes.
     // TODO(ts): optional support for AVX registers with compiler flag
   };
 
@@ -158,6 +160,8 @@ private:
   unsigned must_assign_stack = 0;
   bool vararg;
   u32 ret_gp_cnt = 0, ret_xmm_cnt = 0;
+  /// Whether a 32-byte value was assigned to a YMM register.
+  bool ymm_assigned = false;
 
 public:
   CCAssignerSysV(bool vararg = false) noexcept
@@ -168,8 +172,13 @@ public:
     must_assign_stack = 0;
     vararg = false;
     ret_gp_cnt = ret_xmm_cnt = 0;
+    ymm_assigned = false;
   }
 
+  /// Whether an argument or return value is passed in the upper half of a
+  /// YMM register.
+  bool has_ymm_assigned() const noexcept { return ymm_assigned; }
+
   void assign_arg(CCAssignment &arg) noexcept override {
     if (arg.byval) {
       stack = util::align_up(stack, arg.byval_align < 8 ? 8 : arg.byval_align);
@@ -202,6 +211,7 @@ public:
       if (!must_assign_stack && xmm_cnt < 8) {
         arg.reg = Reg{AsmReg::XMM0 + xmm_cnt};
         xmm_cnt += 1;
+        ymm_assigned |= arg.size == 32;
       } else {
         // Next N arguments must also be assigned to the stack
         // Increment by one, the value is immediately decremented below.
@@ -235,6 +245,7 @@ public:
       if (ret_xmm_cnt + arg.consecutive < 2) {
         arg.reg = Reg{ret_xmm_cnt == 0 ? AsmReg::XMM0 : AsmReg::XMM1};
         ret_xmm_cnt += 1;
+        ymm_assigned |= arg.size == 32;
       } else {
         assert(false);
       }
@@ -348,6 +359,14 @@ struct CompilerX64 : BaseTy<Adaptor, Derived, Config> {
   u32 reg_save_frame_off = 0;
   u32 var_arg_stack_off = 0;
   util::SmallVector<u32, 8> func_ret_offs = {};
+  /// Whether the current function is a leaf function without frame pointer.
+  /// Its stack frame is in the red zone and is addressed relative to rsp,
+  /// which is never modified.
+  bool func_omit_frame_ptr = false;
+  /// Whether the stack frame of the current function without frame pointer
+  /// exceeded the red zone. The function is then compiled again with frame
+  /// pointer.
+  bool func_red_zone_overflow = false;
 
   /// Symbol for __tls_get_addr.
   Assembler::SymRef sym_tls_get_addr;
@@ -393,12 +412,54 @@ struct CompilerX64 : BaseTy<Adaptor, Derived, Config> {
     return Helper{this, enc_fn};
   }
 
+  bool compile_func(IRFuncRef func, u32 func_idx) noexcept;
+
   void start_func(u32 func_idx) noexcept;
 
   void gen_func_prolog_and_args(CCAssigner *) noexcept;
 
   void finish_func(u32 func_idx) noexcept;
 
+  /// Whether jumps inside a function are shortened to rel8 after the function
+  /// is compiled, see relax_jumps.
+  bool use_short_jumps() const noexcept { return false; }
+
+  /// Whether leaf functions can omit the frame pointer. The derived class
+  /// must then also precisely implement cur_func_may_emit_calls.
+  bool may_omit_leaf_frame_pointer() const noexcept { return false; }
+
+  /// Whether all stack slots of the current function fit into the red zone.
+  /// This is an estimate, finish_func checks the actual frame size.
+  bool cur_func_frame_fits_red_zone() noexcept;
+
+  /// Whether the current function may use the upper half of YMM registers.
+  /// If so, vzeroupper is emitted before calls and returns that do not pass
+  /// values in YMM registers to avoid AVX-SSE transition penalties.
+  bool cur_func_uses_ymm() const noexcept { return false; }
+
+  /// Emit vzeroupper if required before a call or return with cc_assigner,
+  /// which must be a CCAssignerSysV.
+  void gen_vzeroupper_if_needed(const CCAssigner &cc_assigner) noexcept;
+
+  /// Base register and displacement for an offset in the stack frame. Frame
+  /// offsets are relative to rbp, which is emulated with rsp - 8 in functions
+  /// without frame pointer.
+  std::pair<AsmReg, i32> frame_addr(i32 frame_off) const noexcept {
+    if (func_omit_frame_ptr) {
+      return {AsmReg::SP, frame_off - 8};
+    }
+    return {AsmReg::BP, frame_off};
+  }
+
+  FeMem frame_mem(i32 frame_off) const noexcept {
+    auto [base, disp] = frame_addr(frame_off);
+    return FE_MEM(base, 0, FE_NOREG, disp);
+  }
+
+  /// Shorten jumps of the current function if use_short_jumps() is true,
+  /// called at the end of finish_func.
+  void relax_jumps() noexcept;
+
   void reset() noexcept;
 
   // helpers
@@ -420,7 +481,8 @@ struct CompilerX64 : BaseTy<Adaptor, Derived, Config> {
   GenericValuePart val_spill_slot(ValuePart &val_ref) noexcept {
     const auto ap = val_ref.assignment();
     assert(ap.stack_valid() && !ap.variable_ref());
-    return typename GenericValuePart::Expr(AsmReg::BP, ap.frame_off());
+    auto [base, disp] = frame_addr(ap.frame_off());
+    return typename GenericValuePart::Expr(base, disp);
   }
 
   AsmReg gval_expr_as_reg(GenericValuePart &gv) noexcept;
@@ -496,6 +558,31 @@ struct CompilerX64 : BaseTy<Adaptor, Derived, Config> {
   }
 };
 
+template <IRAdaptor Adaptor,
+          typename Derived,
+          template <typename, typename, typename> class BaseTy,
+          typename Config>
+bool CompilerX64<Adaptor, Derived, BaseTy, Config>::compile_func(
+    const IRFuncRef func, const u32 func_idx) noexcept {
+  func_red_zone_overflow = false;
+  if (!Base::compile_func(func, func_idx)) {
+    return false;
+  }
+  if (!func_red_zone_overflow) {
+    return true;
+  }
+
+  // The stack frame turned out to be larger than the red zone. finish_func
+  // neither defined the symbol nor emitted unwind info, so discard the code
+  // and compile the function again with frame pointer.
+  TPDE_LOG_TRACE("Frame of {} exceeds red zone, compiling again",
+                 this->adaptor->func_link_name(func));
+  auto sec = this->text_writer.get_sec_ref();
+  this->assembler.discard_code_relocs(sec, func_start_off);
+  this->text_writer.cur_ptr() = this->text_writer.begin_ptr() + func_start_off;
+  return Base::compile_func(func, func_idx);
+}
+
 template <IRAdaptor Adaptor,
           typename Derived,
           template <typename, typename, typename> class BaseTy,
@@ -504,6 +591,8 @@ void CompilerX64<Adaptor, Derived, BaseTy, Config>::start_func(
     const u32 /*func_idx*/) noexcept {
   this->text_writer.align(16);
   this->assembler.except_begin_func();
+  this->assembler.relax_begin_func(this->text_writer.get_sec_ref(),
+                                   this->text_writer.offset());
 }
 
 template <IRAdaptor Adaptor,
@@ -521,6 +610,9 @@ void CompilerX64<Adaptor, Derived, BaseTy, Config>::gen_func_prolog_and_args(
   //   bytes for the higher 8 regs
   // sub rsp, #<frame_size>+<largest_call_frame_usage>
 
+  // leaf functions without frame pointer (if enabled) have no prologue; they
+  // don't use callee-saved regs and keep the frame in the red zone below rsp
+  //
   // TODO(ts): technically we only need rbp if there
   // is a dynamic alloca but then we need to make the
   // frame indexing dynamic in CompilerBase and the
@@ -533,35 +625,51 @@ void CompilerX64<Adaptor, Derived, BaseTy, Config>::gen_func_prolog_and_args(
 
   const CCInfo &cc_info = cc_assigner->get_ccinfo();
 
-  ASM(PUSHr, FE_BP);
-  ASM(MOV64rr, FE_BP, FE_SP);
+  func_omit_frame_ptr = derived()->may_omit_leaf_frame_pointer() &&
+                        !derived()->cur_func_may_emit_calls() &&
+                        !this->adaptor->cur_has_dynamic_alloca() &&
+                        !this->adaptor->cur_is_vararg() &&
+                        !func_red_zone_overflow &&
+                        cur_func_frame_fits_red_zone();
+  if (func_omit_frame_ptr) {
+    // Without pushes, rsp stays where the return address is and the frame
+    // starts 8 bytes below, like with rbp. Offset 0 stays reserved.
+    this->register_file.allocatable &= ~cc_info.callee_saved_regs;
+    this->stack.frame_size = 8;
+    func_reg_save_off = this->text_writer.offset();
+    func_reg_save_alloc = func_reg_restore_alloc = 0;
+    frame_size_setup_offset = 0;
+  } else {
+    ASM(PUSHr, FE_BP);
+    ASM(MOV64rr, FE_BP, FE_SP);
 
-  func_reg_save_off = this->text_writer.offset();
+    func_reg_save_off = this->text_writer.offset();
 
-  auto csr = cc_info.callee_saved_regs;
-  assert(!(csr & ~this->register_file.bank_regs(Config::GP_BANK)) &&
-         "non-gp callee-saved registers not implemented");
+    auto csr = cc_info.callee_saved_regs;
+    assert(!(csr & ~this->register_file.bank_regs(Config::GP_BANK)) &&
+           "non-gp callee-saved registers not implemented");
 
-  u32 csr_logp = std::popcount((csr >> AsmReg::AX) & 0xff);
-  u32 csr_higp = std::popcount((csr >> AsmReg::R8) & 0xff);
-  // R8 and higher need a REX prefix.
-  u32 reg_save_size = 1 * csr_logp + 2 * csr_higp;
-  this->stack.frame_size = 8 * (csr_logp + csr_higp);
+    u32 csr_logp = std::popcount((csr >> AsmReg::AX) & 0xff);
+    u32 csr_higp = std::popcount((csr >> AsmReg::R8) & 0xff);
+    // R8 and higher need a REX prefix.
+    u32 reg_save_size = 1 * csr_logp + 2 * csr_higp;
+    this->stack.frame_size = 8 * (csr_logp + csr_higp);
 
-  this->text_writer.ensure_space(reg_save_size);
-  this->text_writer.cur_ptr() += reg_save_size;
-  func_reg_save_alloc = reg_save_size;
-  // pop uses the same amount of bytes as push
-  func_reg_restore_alloc = reg_save_size;
+    this->text_writer.ensure_space(reg_save_size);
+    this->text_writer.cur_ptr() += reg_save_size;
+    func_reg_save_alloc = reg_save_size;
+    // pop uses the same amount of bytes as push
+    func_reg_restore_alloc = reg_save_size;
 
-  // TODO(ts): support larger stack alignments?
+    // TODO(ts): support larger stack alignments?
 
-  // placeholder for later
-  frame_size_setup_offset = this->text_writer.offset();
-  ASM(SUB64ri, FE_SP, 0x7FFF'FFFF);
+    // placeholder for later
+    frame_size_setup_offset = this->text_writer.offset();
+    ASM(SUB64ri, FE_SP, 0x7FFF'FFFF);
 #ifdef TPDE_ASSERTS
-  assert((this->text_writer.offset() - frame_size_setup_offset) == 7);
+    assert((this->text_writer.offset() - frame_size_setup_offset) == 7);
 #endif
+  }
 
   if (this->adaptor->cur_is_vararg()) {
     this->stack.frame_size += 6 * 8 + 8 * 16;
@@ -660,14 +768,96 @@ void CompilerX64<Adaptor, Derived, BaseTy, Config>::gen_func_prolog_and_args(
   this->register_file.allocatable |= cc_info.arg_regs;
 }
 
+template <IRAdaptor Adaptor,
+          typename Derived,
+          template <typename, typename, typename> typename BaseTy,
+          typename Config>
+bool CompilerX64<Adaptor, Derived, BaseTy, Config>::
+    cur_func_frame_fits_red_zone() noexcept {
+  // The red zone are the 128 bytes below rsp; frame offsets are relative to
+  // rsp - 8, so the frame size must not exceed 120 bytes. The frame starts
+  // with 8 bytes and allocate_stack_slot pads the frame to the slot alignment,
+  // so slots of up to 8 bytes need at most 8 bytes and larger slots need at
+  // most 8 bytes of padding. This is conservative: every value gets a slot and
+  // PHIs get a second one for breaking cycles.
+  const auto slot_size = [](u32 size) -> u32 {
+    return size <= 8 ? 8 : util::align_up(size, 16) + 8;
+  };
+  const u32 max_size = 128 - 8 - 8;
+  u32 size = 0;
+  for (const IRValueRef alloca : this->adaptor->cur_static_allocas()) {
+    u32 alloca_size = this->adaptor->val_alloca_size(alloca);
+    alloca_size = util::align_up(alloca_size,
+                                 this->adaptor->val_alloca_align(alloca));
+    size += alloca_size ? slot_size(alloca_size) : 0;
+    if (size > max_size) {
+      return false;
+    }
+  }
+
+  const auto add_value = [&](IRValueRef value, u32 count) {
+    if (this->adaptor->val_ignore_in_liveness_analysis(value)) {
+      return true;
+    }
+    auto parts = derived()->val_parts(value);
+    u32 max_part_size = 0;
+    for (u32 i = 0, part_count = parts.count(); i < part_count; ++i) {
+      max_part_size = std::max(max_part_size, parts.size_bytes(i));
+    }
+    size += count * slot_size(parts.count() * max_part_size);
+    return size <= max_size;
+  };
+
+  for (const IRValueRef arg : this->adaptor->cur_args()) {
+    if (!add_value(arg, 1)) {
+      return false;
+    }
+  }
+  for (const IRBlockRef block : this->adaptor->cur_blocks()) {
+    for (const IRValueRef phi : this->adaptor->block_phis(block)) {
+      if (!add_value(phi, 2)) {
+        return false;
+      }
+    }
+    for (const auto inst : this->adaptor->block_insts(block)) {
+      for (const IRValueRef res : this->adaptor->inst_results(inst)) {
+        if (!add_value(res, 1)) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
 template <IRAdaptor Adaptor,
           typename Derived,
           template <typename, typename, typename> typename BaseTy,
           typename Config>
 void CompilerX64<Adaptor, Derived, BaseTy, Config>::finish_func(
     u32 func_idx) noexcept {
+  if (func_omit_frame_ptr && this->stack.frame_size > 128 - 8) {
+    // compile_func discards the code and compiles the function again.
+    func_red_zone_overflow = true;
+    return;
+  }
+
   // NB: code alignment factor 1, data alignment factor -8.
   auto fde_off = this->assembler.eh_begin_fde(this->get_personality_sym());
+  auto func_sym = this->func_syms[func_idx];
+  auto func_sec = this->text_writer.get_sec_ref();
+
+  if (func_omit_frame_ptr) {
+    // rsp is never modified, so the CFA rule of the CIE holds everywhere and
+    // the epilogues are already complete.
+    relax_jumps();
+    auto func_size = this->text_writer.offset() - func_start_off;
+    this->assembler.sym_def(func_sym, func_sec, func_start_off, func_size);
+    this->assembler.eh_end_fde(fde_off, func_sym);
+    this->assembler.except_encode_func(func_sym);
+    return;
+  }
+
   // push rbp
   this->assembler.eh_write_inst(dwarf::DW_CFA_advance_loc, 1);
   this->assembler.eh_write_inst(dwarf::DW_CFA_def_cfa_offset, 16);
@@ -754,9 +944,8 @@ void CompilerX64<Adaptor, Derived, BaseTy, Config>::finish_func(
     fe64_NOP(write_ptr, nop_len);
   }
 
-  auto func_sym = this->func_syms[func_idx];
-  auto func_sec = this->text_writer.get_sec_ref();
   if (func_ret_offs.empty()) {
+    relax_jumps();
     // TODO(ts): honor cur_needs_unwind_info
     auto func_size = this->text_writer.offset() - func_start_off;
     this->assembler.sym_def(func_sym, func_sec, func_start_off, func_size);
@@ -813,6 +1002,8 @@ void CompilerX64<Adaptor, Derived, BaseTy, Config>::finish_func(
     }
   }
 
+  relax_jumps();
+
   // Do sym_def at the very end; we shorten the function here again, so only at
   // this point we know the actual size of the function.
   // TODO(ts): honor cur_needs_unwind_info
@@ -822,6 +1013,18 @@ void CompilerX64<Adaptor, Derived, BaseTy, Config>::finish_func(
   this->assembler.except_encode_func(func_sym);
 }
 
+template <IRAdaptor Adaptor,
+          typename Derived,
+          template <typename, typename, typename> typename BaseTy,
+          typename Config>
+void CompilerX64<Adaptor, Derived, BaseTy, Config>::relax_jumps() noexcept {
+  if (!derived()->use_short_jumps()) {
+    return;
+  }
+  u32 func_end = this->assembler.relax_func(this->text_writer.offset());
+  this->text_writer.cur_ptr() = this->text_writer.begin_ptr() + func_end;
+}
+
 template <IRAdaptor Adaptor,
           typename Derived,
           template <typename, typename, typename> typename BaseTy,
@@ -850,6 +1053,13 @@ void CompilerX64<Adaptor, Derived, BaseTy, Config>::gen_func_epilog() noexcept {
   // however, since we will later patch this, we only
   // reserve the space for now
 
+  gen_vzeroupper_if_needed(*derived()->cur_cc_assigner());
+
+  if (func_omit_frame_ptr) {
+    ASM(RET);
+    return;
+  }
+
   func_ret_offs.push_back(this->text_writer.offset());
 
   // add reg, imm32
@@ -864,6 +1074,23 @@ void CompilerX64<Adaptor, Derived, BaseTy, Config>::gen_func_epilog() noexcept {
   this->text_writer.cur_ptr() += epilogue_size;
 }
 
+template <IRAdaptor Adaptor,
+          typename Derived,
+          template <typename, typename, typename> typename BaseTy,
+          typename Config>
+void CompilerX64<Adaptor, Derived, BaseTy, Config>::gen_vzeroupper_if_needed(
+    const CCAssigner &cc_assigner) noexcept {
+  if (!derived()->cur_func_uses_ymm()) {
+    return;
+  }
+  // Values passed in YMM registers must keep their upper half.
+  if (static_cast<const CCAssignerSysV &>(cc_assigner).has_ymm_assigned()) {
+    return;
+  }
+  assert(has_cpu_feats(CPU_AVX));
+  ASM(VZEROUPPER);
+}
+
 template <IRAdaptor Adaptor,
           typename Derived,
           template <typename, typename, typename> typename BaseTy,
@@ -872,7 +1099,7 @@ void CompilerX64<Adaptor, Derived, BaseTy, Config>::spill_reg(
     const AsmReg reg, const i32 frame_off, const u32 size) noexcept {
   this->text_writer.ensure_space(16);
   assert(frame_off < 0);
-  const auto mem = FE_MEM(FE_BP, 0, FE_NOREG, frame_off);
+  const auto mem = frame_mem(frame_off);
   if (reg.id() <= AsmReg::R15) {
     switch (size) {
     case 1: ASMNC(MOV8mr, mem, reg); break;
@@ -888,6 +1115,11 @@ void CompilerX64<Adaptor, Derived, BaseTy, Config>::spill_reg(
   case 4: ASMNC(SSE_MOVD_X2Gmr, mem, reg); break;
   case 8: ASMNC(SSE_MOVQ_X2Gmr, mem, reg); break;
   case 16: ASMNC(SSE_MOVAPDmr, mem, reg); break;
+  case 32:
+    // Stack slots are only 16-byte aligned.
+    assert(has_cpu_feats(CPU_AVX));
+    ASMNC(VMOVUPD256mr, mem, reg);
+    break;
   default: TPDE_UNREACHABLE("invalid spill size");
   }
 }
@@ -902,7 +1134,7 @@ void CompilerX64<Adaptor, Derived, BaseTy, Config>::load_from_stack(
     const u32 size,
     const bool sign_extend) noexcept {
   this->text_writer.ensure_space(16);
-  const auto mem = FE_MEM(FE_BP, 0, FE_NOREG, frame_off);
+  const auto mem = frame_mem(frame_off);
 
   if (dst.id() <= AsmReg::R15) {
     if (!sign_extend) {
@@ -931,6 +1163,10 @@ void CompilerX64<Adaptor, Derived, BaseTy, Config>::load_from_stack(
   case 4: ASMNC(SSE_MOVD_G2Xrm, dst, mem); break;
   case 8: ASMNC(SSE_MOVQ_G2Xrm, dst, mem); break;
   case 16: ASMNC(SSE_MOVAPDrm, dst, mem); break;
+  case 32:
+    assert(has_cpu_feats(CPU_AVX));
+    ASMNC(VMOVUPD256rm, dst, mem);
+    break;
   default: TPDE_UNREACHABLE("invalid spill size");
   }
 }
@@ -941,7 +1177,7 @@ template <IRAdaptor Adaptor,
           typename Config>
 void CompilerX64<Adaptor, Derived, BaseTy, Config>::load_address_of_stack_var(
     const AsmReg dst, const AssignmentPartRef ap) noexcept {
-  ASM(LEA64rm, dst, FE_MEM(FE_BP, 0, FE_NOREG, ap.variable_stack_off()));
+  ASM(LEA64rm, dst, frame_mem(ap.variable_stack_off()));
 }
 
 template <IRAdaptor Adaptor,
@@ -1141,6 +1377,12 @@ void CompilerX64<Adaptor, Derived, BaseTy, Config>::materialize_constant(
 
   assert(bank == Config::FP_BANK);
   const auto high_u64 = size <= 8 ? 0 : data[1];
+  if (size == 32 && (data[0] | data[1] | data[2] | data[3]) == 0) {
+    // VEX-encoded instructions clear the upper half of the YMM register.
+    assert(has_cpu_feats(CPU_AVX));
+    ASM(VPXOR128rrr, dst, dst, dst);
+    return;
+  }
   if (const_u64 == 0 && (size <= 8 || (high_u64 == 0 && size <= 16))) {
     if (has_cpu_feats(CPU_AVX)) {
       ASM(VPXOR128rrr, dst, dst, dst);
@@ -1188,10 +1430,7 @@ void CompilerX64<Adaptor, Derived, BaseTy, Config>::materialize_constant(
   // We store constants in 8-byte units.
   auto alloc_size = util::align_up(size, 8);
   std::span<const u8> raw_data{reinterpret_cast<const u8 *>(data), alloc_size};
-  // TODO: deduplicate/pool constants?
-  auto rodata = this->assembler.get_data_section(true, false);
-  auto sym = this->assembler.sym_def_data(
-      rodata, "", raw_data, alloc_size, Assembler::SymBinding::LOCAL);
+  auto sym = this->assembler.sym_def_const(raw_data, alloc_size);
   if (size <= 4) {
     if (has_cpu_feats(CPU_AVX)) {
       ASM(VMOVSSrm, dst, FE_MEM(FE_IP, 0, FE_NOREG, -1));
@@ -1210,6 +1449,9 @@ void CompilerX64<Adaptor, Derived, BaseTy, Config>::materialize_constant(
     } else {
       ASM(SSE_MOVAPSrm, dst, FE_MEM(FE_IP, 0, FE_NOREG, -1));
     }
+  } else if (size <= 32) {
+    assert(has_cpu_feats(CPU_AVX));
+    ASM(VMOVAPS256rm, dst, FE_MEM(FE_IP, 0, FE_NOREG, -1));
   } else {
     // TODO: implement for AVX/AVX-512.
     TPDE_FATAL("unable to materialize constant");
@@ -1382,6 +1624,10 @@ template <IRAdaptor Adaptor,
           typename Config>
 void CompilerX64<Adaptor, Derived, BaseTy, Config>::generate_raw_jump(
     Jump jmp, Assembler::Label target_label) noexcept {
+  if (derived()->use_short_jumps()) {
+    // Jumps are shortened to rel8 if possible in finish_func.
+    this->assembler.relax_add_jump(this->text_writer.offset(), target_label);
+  }
   if (this->assembler.label_is_pending(target_label)) {
     this->text_writer.ensure_space(6);
     auto *target = this->text_writer.cur_ptr();
@@ -1699,6 +1945,13 @@ void CompilerX64<Adaptor, Derived, BaseTy, Config>::CallBuilder::add_arg_stack(
            FE_MEM(FE_SP, 0, FE_NOREG, i32(cca.stack_off)),
            reg);
       break;
+    case 32:
+      // The stack pointer is only guaranteed to be 16-byte aligned.
+      ASMC(&this->compiler,
+           VMOVUPD256mr,
+           FE_MEM(FE_SP, 0, FE_NOREG, i32(cca.stack_off)),
+           reg);
+      break;
     default: TPDE_UNREACHABLE("invalid GP reg size");
     }
   }
@@ -1732,6 +1985,8 @@ void CompilerX64<Adaptor, Derived, BaseTy, Config>::CallBuilder::call_impl(
     assert(this->assigner.get_stack_size() == 0);
   }
 
+  this->compiler.gen_vzeroupper_if_needed(this->assigner);
+
   if (auto *sym = std::get_if<typename Assembler::SymRef>(&target)) {
     this->compiler.text_writer.ensure_space(16);
     ASMC(&this->compiler, CALL, this->compiler.text_writer.cur_ptr());
@@ -1743,7 +1998,7 @@ void CompilerX64<Adaptor, Derived, BaseTy, Config>::CallBuilder::call_impl(
       ASMC(&this->compiler, CALLr, reg);
     } else if (tvp.has_assignment() && tvp.assignment().stack_valid()) {
       auto off = tvp.assignment().frame_off();
-      ASMC(&this->compiler, CALLm, FE_MEM(FE_BP, 0, FE_NOREG, off));
+      ASMC(&this->compiler, CALLm, this->compiler.frame_mem(off));
     } else {
       assert(!this->compiler.register_file.is_used(Reg{AsmReg::R10}));
       AsmReg reg = tvp.reload_into_specific_fixed(&this->compiler, AsmReg::R10);
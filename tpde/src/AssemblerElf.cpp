@@ -7,6 +7,7 @@
 #include "tpde/util/misc.hpp"
 
 #include <algorithm>
+#include <cstring>
 #include <elf.h>
 
 namespace tpde {
@@ -121,6 +122,9 @@ void AssemblerElfBase::reset() noexcept {
   secref_eh_frame = INVALID_SEC_REF;
   secref_except_table = INVALID_SEC_REF;
   cur_personality_func_addr = SymRef();
+  merged_globals.clear();
+  shard_range_relocs.clear();
+  const_pool.clear();
 
   init_sections();
   eh_init_cie();
@@ -322,6 +326,22 @@ void AssemblerElfBase::sym_copy(SymRef dst, SymRef src) noexcept {
   // Don't copy st_info.
 }
 
+void AssemblerElfBase::sym_for_each_named(
+    util::function_ref<void(SymRef, std::string_view)> fn) const noexcept {
+  for (size_t i = 0; i < global_symbols.size(); ++i) {
+    if (global_symbols[i].st_name != 0) {
+      SymRef sym{static_cast<u32>(0x8000'0000 | i)};
+      fn(sym, sym_name(sym));
+    }
+  }
+  for (size_t i = 1; i < local_symbols.size(); ++i) {
+    if (local_symbols[i].st_name != 0) {
+      SymRef sym{static_cast<u32>(i)};
+      fn(sym, sym_name(sym));
+    }
+  }
+}
+
 AssemblerElfBase::SymRef AssemblerElfBase::sym_add(const std::string_view name,
                                                    SymBinding binding,
                                                    u32 type) noexcept {
@@ -371,6 +391,19 @@ void AssemblerElfBase::sym_def_predef_data(SecRef sec_ref,
   }
 }
 
+AssemblerElfBase::SymRef
+    AssemblerElfBase::sym_def_const(std::span<const u8> data,
+                                    u32 align) noexcept {
+  std::string key(reinterpret_cast<const char *>(data.data()), data.size());
+  key.append(reinterpret_cast<const char *>(&align), sizeof(align));
+  auto [it, inserted] = const_pool.try_emplace(std::move(key));
+  if (inserted) {
+    SecRef rodata = get_data_section(true, false);
+    it->second = sym_def_data(rodata, "", data, align, SymBinding::LOCAL);
+  }
+  return it->second;
+}
+
 void AssemblerElfBase::sym_def_predef_zero(
     SecRef sec_ref, SymRef sym_ref, u32 size, u32 align, u32 *off) noexcept {
   DataSection &sec = get_section(sec_ref);
@@ -410,6 +443,16 @@ void AssemblerElfBase::reloc_sec(const SecRef sec_ref,
   sec.write<Elf64_Rela>(rel);
 }
 
+void AssemblerElfBase::reloc_sec_range(const SecRef sec,
+                                       const SecRef target,
+                                       const u32 type,
+                                       const u64 offset,
+                                       const i64 addend) noexcept {
+  const u32 idx = get_reloc_section(sec).size() / sizeof(Elf64_Rela);
+  shard_range_relocs.emplace_back(sec, idx);
+  reloc_sec(sec, get_section(target).sym, type, offset, addend);
+}
+
 void AssemblerElfBase::reloc_sec(const SecRef sec,
                                  const Label label,
                                  const u8 kind,
@@ -434,6 +477,63 @@ void AssemblerElfBase::reloc_sec(const SecRef sec,
   info.fixup_idx = fixup_idx;
 }
 
+void AssemblerElfBase::remap_code_offsets(
+    SecRef sec,
+    u32 start,
+    u32 first_label,
+    util::function_ref<u32(u32)> map) noexcept {
+  for (u32 i = first_label; i < temp_symbols.size(); ++i) {
+    TempSymbolInfo &info = temp_symbols[i];
+    if (info.section == sec) {
+      if (info.off >= start) {
+        info.off = map(info.off);
+      }
+      continue;
+    }
+    if (info.section != INVALID_SEC_REF) {
+      continue;
+    }
+    for (u32 idx = info.fixup_idx; idx != ~0u;) {
+      TempSymbolFixup &fixup = temp_symbol_fixups[idx];
+      if (fixup.section == sec && fixup.off >= start) {
+        fixup.off = map(fixup.off);
+      }
+      idx = fixup.next_list_entry;
+    }
+  }
+
+  // Relocations are appended in order, so all relocations of the moved code
+  // are at the end.
+  std::span<Elf64_Rela> relocs = get_relocs(sec);
+  for (auto it = relocs.rbegin(); it != relocs.rend(); ++it) {
+    if (it->r_offset < start) {
+      break;
+    }
+    it->r_offset = map(it->r_offset);
+  }
+
+  for (ExceptCallSiteInfo &info : except_call_site_table) {
+    if (info.start >= start) {
+      u64 end = map(info.start + info.len);
+      info.start = map(info.start);
+      info.len = end - info.start;
+    }
+  }
+}
+
+void AssemblerElfBase::discard_code_relocs(SecRef sec, u32 start) noexcept {
+  // Relocations are appended in order, so all relocations of the discarded
+  // code are at the end.
+  std::span<Elf64_Rela> relocs = get_relocs(sec);
+  size_t count = relocs.size();
+  while (count > 0 && relocs[count - 1].r_offset >= start) {
+    --count;
+  }
+  if (count != relocs.size()) {
+    get_reloc_section(sec).data.resize(count * sizeof(Elf64_Rela));
+  }
+}
+
 void AssemblerElfBase::eh_align_frame() noexcept {
   if (unsigned count = -eh_writer.size() & 7) {
     eh_writer.reserve(8);
@@ -610,12 +710,11 @@ void AssemblerElfBase::eh_end_fde(u32 fde_start, SymRef func) noexcept {
   // relocate against .text so we don't have to fix up any relocations
   // NB: ld.bfd (for a reason that needs to be investigated) doesn't accept
   // using the function symbol here.
-  DataSection &func_sec = get_section(sym_section(func));
-  this->reloc_sec(secref_eh_frame,
-                  func_sec.sym,
-                  target_info.reloc_pc32,
-                  fde_start + 8,
-                  func_sym->st_value);
+  this->reloc_sec_range(secref_eh_frame,
+                        sym_section(func),
+                        target_info.reloc_pc32,
+                        fde_start + 8,
+                        func_sym->st_value);
   // Adjust func_size to the function size
   *reinterpret_cast<i32 *>(eh_data + fde_start + 12) = func_sym->st_size;
 
@@ -629,11 +728,11 @@ void AssemblerElfBase::eh_end_fde(u32 fde_start, SymRef func) noexcept {
                               SHF_ALLOC,
                               8);
     ;
-    reloc_sec(secref_eh_frame,
-              except_table.sym,
-              target_info.reloc_pc32,
-              fde_start + 17,
-              except_table.data.size());
+    reloc_sec_range(secref_eh_frame,
+                    secref_except_table,
+                    target_info.reloc_pc32,
+                    fde_start + 17,
+                    except_table.data.size());
   }
 }
 
@@ -814,6 +913,338 @@ u32 AssemblerElfBase::except_type_idx_for_sym(const SymRef sym) noexcept {
 
 void AssemblerElfBase::finalize() noexcept { eh_writer.flush(); }
 
+namespace {
+/// Whether ranges of shards are aligned inside the section. Relocations,
+/// groups, .eh_frame and pointer arrays are sequences of entries which must not
+/// contain padding.
+bool shard_sec_is_aligned(const AssemblerElfBase::DataSection &sec,
+                          bool is_eh_frame) noexcept {
+  unsigned type = sec.hdr.sh_type;
+  return !is_eh_frame && (type == SHT_PROGBITS || type == SHT_NOBITS);
+}
+} // namespace
+
+AssemblerElfBase::ShardMark AssemblerElfBase::shard_mark() noexcept {
+  eh_writer.flush();
+
+  ShardMark mark;
+  mark.sec_count = sections.size();
+  mark.local_sym_count = local_symbols.size();
+  mark.global_sym_count = global_symbols.size();
+  mark.range_reloc_count = shard_range_relocs.size();
+  mark.sec_sizes.resize(sections.size());
+  for (size_t i = 0; i < sections.size(); ++i) {
+    mark.sec_sizes[i] = sections[i]->size();
+  }
+  return mark;
+}
+
+AssemblerElfBase::ShardMark AssemblerElfBase::shard_begin() noexcept {
+  eh_writer.flush();
+
+  for (size_t i = elf::predef_sec_count(); i < sections.size(); ++i) {
+    DataSection &sec = *sections[i];
+    if (!shard_sec_is_aligned(sec, sec.get_ref() == secref_eh_frame)) {
+      continue;
+    }
+    if (sec.hdr.sh_type == SHT_NOBITS) {
+      sec.hdr.sh_size = util::align_up(sec.hdr.sh_size, SHARD_ALIGN);
+    } else {
+      sec.data.resize(util::align_up(sec.data.size(), SHARD_ALIGN));
+    }
+  }
+
+  // Ranges must not refer to local symbols of a previous range.
+  const_pool.clear();
+
+  // FDEs of the range must not refer to a CIE of a previous range. The initial
+  // CIE is part of the common prefix and therefore valid in all shards.
+  cur_personality_func_addr = SymRef();
+  eh_cur_cie_off = 0;
+
+  return shard_mark();
+}
+
+void AssemblerElfBase::shard_merge(
+    AssemblerElfBase &shard,
+    const ShardMark &prefix,
+    const ShardMark &begin,
+    const ShardMark &end,
+    std::span<const SymRef> defined_syms) noexcept {
+  using namespace elf;
+
+  assert(sections.size() >= prefix.sec_count);
+  assert(local_symbols.size() >= prefix.local_sym_count);
+  assert(global_symbols.size() >= prefix.global_sym_count);
+  assert(begin.sec_count >= prefix.sec_count && end.sec_count >= begin.sec_count);
+
+  eh_writer.flush();
+
+  // Sections that are created on demand at most once. A shard section that is
+  // one of these maps to the corresponding section in this assembler.
+  static constexpr SecRef AssemblerElfBase::*singletons[] = {
+      &AssemblerElfBase::secref_text,
+      &AssemblerElfBase::secref_rodata,
+      &AssemblerElfBase::secref_relro,
+      &AssemblerElfBase::secref_data,
+      &AssemblerElfBase::secref_bss,
+      &AssemblerElfBase::secref_tdata,
+      &AssemblerElfBase::secref_tbss,
+      &AssemblerElfBase::secref_eh_frame,
+      &AssemblerElfBase::secref_except_table,
+  };
+
+  const u32 sec_count = end.sec_count;
+  const auto range_begin = [&](u32 idx) -> u64 {
+    return idx < begin.sec_count ? begin.sec_sizes[idx] : 0;
+  };
+
+  // Map shard sections to sections of this assembler; zero if the section
+  // belongs to another range and must not be modified.
+  util::SmallVector<u32, 16> sec_map;
+  sec_map.resize(sec_count);
+  util::SmallVector<u32, 8> new_secs;
+  for (u32 i = 0; i < sec_count; ++i) {
+    DataSection &in_sec = *shard.sections[i];
+    if (i < prefix.sec_count) {
+      sec_map[i] = i;
+      continue;
+    }
+    if (in_sec.hdr.sh_type == SHT_RELA) {
+      // Relocation sections are always created right after their section.
+      u32 target = sec_map[in_sec.hdr.sh_info];
+      sec_map[i] = target != 0 ? target + 1 : 0;
+      continue;
+    }
+
+    const SecRef in_ref = static_cast<SecRef>(i);
+    const bool with_rela = shard.has_reloc_section(in_ref);
+    unsigned rela_name = with_rela ? shard.get_reloc_section(in_ref).hdr.sh_name
+                                   : in_sec.hdr.sh_name;
+
+    SecRef AssemblerElfBase::*singleton = nullptr;
+    for (auto member : singletons) {
+      if (shard.*member == in_ref) {
+        singleton = member;
+        break;
+      }
+    }
+    if (singleton) {
+      (void)get_or_create_section(this->*singleton,
+                                  rela_name,
+                                  in_sec.hdr.sh_type,
+                                  static_cast<unsigned>(in_sec.hdr.sh_flags),
+                                  static_cast<unsigned>(in_sec.hdr.sh_addralign),
+                                  with_rela);
+      sec_map[i] = static_cast<u32>(this->*singleton);
+      continue;
+    }
+    if (i < begin.sec_count) {
+      sec_map[i] = 0;
+      continue;
+    }
+
+    // New section, copy name and header.
+    unsigned name = in_sec.hdr.sh_name;
+    if (name >= SHSTRTAB.size()) {
+      std::string_view str{shard.shstrtab_extra.data() + name -
+                           SHSTRTAB.size()};
+      rela_name = SHSTRTAB.size() +
+                  shstrtab_extra.add_prefix(with_rela ? ".rela" : "", str);
+      name = with_rela ? rela_name + 5 : rela_name;
+    }
+    SecRef ref = create_section(
+        in_sec.hdr.sh_type, static_cast<unsigned>(in_sec.hdr.sh_flags), name);
+    DataSection &sec = get_section(ref);
+    sec.hdr.sh_addralign = in_sec.hdr.sh_addralign;
+    sec.hdr.sh_entsize = in_sec.hdr.sh_entsize;
+    if (with_rela) {
+      unsigned group_flag = shard.get_reloc_section(in_ref).hdr.sh_flags &
+                            SHF_GROUP;
+      (void)create_rela_section(ref, group_flag, rela_name);
+    }
+    sec_map[i] = static_cast<u32>(ref);
+    new_secs.push_back(i);
+  }
+
+  // Append section contents.
+  util::SmallVector<i64, 16> sec_delta;
+  sec_delta.resize(sec_count);
+  for (u32 i = predef_sec_count(); i < sec_count; ++i) {
+    const u64 from = range_begin(i), to = end.sec_sizes[i];
+    if (from == to) {
+      continue;
+    }
+    if (sec_map[i] == 0) {
+      TPDE_FATAL("shard range modifies section of other range");
+    }
+
+    const DataSection &in_sec = *shard.sections[i];
+    DataSection &sec = get_section(static_cast<SecRef>(sec_map[i]));
+    sec.hdr.sh_addralign =
+        std::max(sec.hdr.sh_addralign, in_sec.hdr.sh_addralign);
+    u64 off = sec.size();
+    if (shard_sec_is_aligned(sec, sec.get_ref() == secref_eh_frame)) {
+      off = util::align_up(off, SHARD_ALIGN);
+    }
+    sec_delta[i] = static_cast<i64>(off - from);
+    if (sec.hdr.sh_type == SHT_NOBITS) {
+      sec.hdr.sh_size = off + (to - from);
+    } else {
+      sec.data.resize(off);
+      sec.data.append(in_sec.data.data() + from, in_sec.data.data() + to);
+    }
+  }
+
+  const u32 local_base = local_symbols.size();
+  const auto map_sym = [&](SymRef sym) -> SymRef {
+    const u32 idx = sym_idx(sym);
+    if (sym_is_local(sym)) {
+      if (idx < prefix.local_sym_count) {
+        return sym;
+      }
+      if (idx >= begin.local_sym_count && idx < end.local_sym_count) {
+        return SymRef(local_base + idx - begin.local_sym_count);
+      }
+      TPDE_FATAL("shard range references local symbol of other range");
+    }
+    if (idx < prefix.global_sym_count) {
+      return sym;
+    }
+    auto it = merged_globals.find(std::string(shard.sym_name(sym)));
+    assert(it != merged_globals.end());
+    return it->second;
+  };
+
+  const auto copy_def = [&](SymRef dst, SymRef src) {
+    const Elf64_Sym *in = shard.sym_ptr(src);
+    Elf64_Sym *out = sym_ptr(dst);
+    out->st_value = in->st_value;
+    out->st_size = in->st_size;
+    if (in->st_shndx == SHN_UNDEF ||
+        (in->st_shndx >= SHN_LORESERVE && in->st_shndx != SHN_XINDEX)) {
+      out->st_shndx = in->st_shndx;
+      return;
+    }
+    const u32 in_sec = static_cast<u32>(shard.sym_section(src));
+    if (ELF64_ST_TYPE(in->st_info) != STT_SECTION) {
+      out->st_value += sec_delta[in_sec];
+    }
+    const SecRef sec = static_cast<SecRef>(sec_map[in_sec]);
+    if (!sec_is_xindex(sec)) [[likely]] {
+      out->st_shndx = static_cast<Elf64_Section>(sec);
+    } else {
+      out->st_shndx = SHN_XINDEX;
+      sym_def_xindex(dst, sec);
+    }
+  };
+
+  for (u32 i = begin.local_sym_count; i < end.local_sym_count; ++i) {
+    Elf64_Sym sym = shard.local_symbols[i];
+    sym.st_name = strtab.add(shard.strtab.data() + sym.st_name);
+    local_symbols.push_back(sym);
+    copy_def(SymRef(local_symbols.size() - 1), SymRef(i));
+  }
+
+  for (u32 i = begin.global_sym_count; i < end.global_sym_count; ++i) {
+    const SymRef in_ref(i | 0x8000'0000);
+    auto [it, inserted] =
+        merged_globals.try_emplace(std::string(shard.sym_name(in_ref)));
+    if (!inserted) {
+      // Other shards can only create the same undefined symbols.
+      assert(shard.global_symbols[i].st_shndx == SHN_UNDEF);
+      continue;
+    }
+    Elf64_Sym sym = shard.global_symbols[i];
+    sym.st_name = strtab.add(it->first);
+    global_symbols.push_back(sym);
+    assert(global_symbols.size() < 0x8000'0000);
+    it->second = SymRef((global_symbols.size() - 1) | 0x8000'0000);
+    copy_def(it->second, in_ref);
+  }
+
+  for (SymRef sym : defined_syms) {
+    assert(sym_idx(sym) < (sym_is_local(sym) ? prefix.local_sym_count
+                                             : prefix.global_sym_count));
+    if (shard.sym_ptr(sym)->st_shndx != SHN_UNDEF) {
+      copy_def(sym, sym);
+    }
+  }
+
+  for (u32 i : new_secs) {
+    get_section(static_cast<SecRef>(sec_map[i])).sym =
+        map_sym(shard.sections[i]->sym);
+  }
+
+  // Fix up references to sections and symbols in the appended contents.
+  for (u32 i = predef_sec_count(); i < sec_count; ++i) {
+    const u64 from = range_begin(i), to = end.sec_sizes[i];
+    if (from == to) {
+      continue;
+    }
+
+    const DataSection &in_sec = *shard.sections[i];
+    DataSection &sec = get_section(static_cast<SecRef>(sec_map[i]));
+    u8 *data = sec.data.data() + (from + sec_delta[i]);
+    const u64 size = to - from;
+    if (in_sec.hdr.sh_type == SHT_RELA) {
+      const u32 target = in_sec.hdr.sh_info;
+      std::span<Elf64_Rela> relocs{reinterpret_cast<Elf64_Rela *>(data),
+                                   size / sizeof(Elf64_Rela)};
+      for (Elf64_Rela &rel : relocs) {
+        const SymRef in_sym(ELF64_R_SYM(rel.r_info));
+        rel.r_offset += sec_delta[target];
+        rel.r_info =
+            ELF64_R_INFO(map_sym(in_sym).id(), ELF64_R_TYPE(rel.r_info));
+      }
+    } else if (in_sec.hdr.sh_type == SHT_GROUP) {
+      // The first word of a new group contains the group flags.
+      for (u64 off = from == 0 ? 4 : 0; off < size; off += sizeof(u32)) {
+        u32 member;
+        std::memcpy(&member, data + off, sizeof(u32));
+        member = sec_map[member];
+        std::memcpy(data + off, &member, sizeof(u32));
+      }
+    } else if (static_cast<SecRef>(i) == shard.secref_eh_frame) {
+      // FDEs referring to a CIE of the prefix need an updated CIE pointer, the
+      // CIE is at the same offset in both assemblers.
+      for (u64 off = 0; off < size;) {
+        u32 len, id;
+        std::memcpy(&len, data + off, sizeof(u32));
+        std::memcpy(&id, data + off + 4, sizeof(u32));
+        const u64 in_off = from + off;
+        if (id != 0 && in_off + 4 - id < from) {
+          u64 cie_off = in_off + 4 - id;
+          u32 new_id = in_off + sec_delta[i] + 4 - cie_off;
+          std::memcpy(data + off + 4, &new_id, sizeof(u32));
+        }
+        off += sizeof(u32) + len;
+      }
+    }
+  }
+
+  // Relocations against section symbols of the range encode the offset inside
+  // the range in the addend.
+  for (u32 i = begin.range_reloc_count; i < end.range_reloc_count; ++i) {
+    const auto [in_sec, idx] = shard.shard_range_relocs[i];
+    // Relocation sections are always created right after their section.
+    const u32 rela = static_cast<u32>(in_sec) + 1;
+    const u64 off = idx * sizeof(Elf64_Rela);
+    const u8 *in_data = shard.sections[rela]->data.data();
+    Elf64_Rela in_rel;
+    std::memcpy(&in_rel, in_data + off, sizeof(in_rel));
+    const SymRef in_sym(ELF64_R_SYM(in_rel.r_info));
+    const u32 sym_sec = static_cast<u32>(shard.sym_section(in_sym));
+    u8 *data = get_section(static_cast<SecRef>(sec_map[rela])).data.data();
+    Elf64_Rela rel;
+    std::memcpy(&rel, data + off + sec_delta[rela], sizeof(rel));
+    rel.r_addend += sec_delta[sym_sec];
+    std::memcpy(data + off + sec_delta[rela], &rel, sizeof(rel));
+  }
+
+  eh_writer = util::VectorWriter(get_section(secref_eh_frame).data);
+}
+
 std::vector<u8> AssemblerElfBase::build_object_file() noexcept {
   using namespace elf;
 
@@ -1020,4 +1451,189 @@ std::vector<u8> AssemblerElfBase::build_object_file() noexcept {
   return out;
 }
 
+bool AssemblerElfBase::load_object_file(std::span<const u8> obj) noexcept {
+  using namespace elf;
+
+  const auto in_bounds = [&](u64 off, u64 size) {
+    return off <= obj.size() && size <= obj.size() - off;
+  };
+
+  Elf64_Ehdr ehdr;
+  if (!in_bounds(0, sizeof(ehdr))) {
+    return false;
+  }
+  std::memcpy(&ehdr, obj.data(), sizeof(ehdr));
+  if (std::memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0 ||
+      ehdr.e_ident[EI_CLASS] != ELFCLASS64 ||
+      ehdr.e_ident[EI_DATA] != ELFDATA2LSB || ehdr.e_type != ET_REL ||
+      ehdr.e_machine != target_info.elf_machine ||
+      ehdr.e_shentsize != sizeof(Elf64_Shdr)) {
+    return false;
+  }
+  // TODO: support objects with SHN_XINDEX sections (e_shnum == 0).
+  u32 sec_count = ehdr.e_shnum;
+  if (sec_count < predef_sec_count() ||
+      !in_bounds(ehdr.e_shoff, sec_count * sizeof(Elf64_Shdr))) {
+    return false;
+  }
+
+  util::SmallVector<Elf64_Shdr, 64> shdrs;
+  shdrs.resize(sec_count);
+  std::memcpy(shdrs.data(),
+              obj.data() + ehdr.e_shoff,
+              sec_count * sizeof(Elf64_Shdr));
+  for (const Elf64_Shdr &shdr : shdrs) {
+    if (shdr.sh_type != SHT_NOBITS &&
+        !in_bounds(shdr.sh_offset, shdr.sh_size)) {
+      return false;
+    }
+  }
+  const auto sec_data = [&](const Elf64_Shdr &shdr) {
+    const char *data = reinterpret_cast<const char *>(obj.data());
+    return std::string_view{data + shdr.sh_offset, shdr.sh_size};
+  };
+
+  const Elf64_Shdr &symtab_hdr = shdrs[sec_idx(".symtab")];
+  const Elf64_Shdr &strtab_hdr = shdrs[sec_idx(".strtab")];
+  const Elf64_Shdr &shstrtab_hdr = shdrs[sec_idx(".shstrtab")];
+  if (symtab_hdr.sh_type != SHT_SYMTAB || strtab_hdr.sh_type != SHT_STRTAB ||
+      shstrtab_hdr.sh_type != SHT_STRTAB ||
+      symtab_hdr.sh_size % sizeof(Elf64_Sym) != 0 ||
+      symtab_hdr.sh_info == 0 ||
+      symtab_hdr.sh_info > symtab_hdr.sh_size / sizeof(Elf64_Sym)) {
+    return false;
+  }
+  std::string_view strtab_data = sec_data(strtab_hdr);
+  std::string_view shstrtab_data = sec_data(shstrtab_hdr);
+  if (strtab_data.empty() || strtab_data[0] != '\0' ||
+      shstrtab_data.size() <= SHSTRTAB.size() ||
+      shstrtab_data[SHSTRTAB.size()] != '\0') {
+    return false;
+  }
+
+  // Validate everything before modifying the assembler, so that the caller
+  // can continue to use it if the object is malformed.
+  u32 local_count = symtab_hdr.sh_info;
+  u32 sym_count = symtab_hdr.sh_size / sizeof(Elf64_Sym);
+  bool has_text = false, has_eh_frame = false;
+  for (u32 i = predef_sec_count(); i < sec_count; ++i) {
+    const Elf64_Shdr &shdr = shdrs[i];
+    if (shdr.sh_type == SHT_RELA) {
+      // Relocation sections are always created right after their section.
+      if (shdr.sh_info != i - 1 || shdr.sh_size % sizeof(Elf64_Rela) != 0) {
+        return false;
+      }
+      const u8 *data = obj.data() + shdr.sh_offset;
+      for (u64 off = 0; off < shdr.sh_size; off += sizeof(Elf64_Rela)) {
+        Elf64_Rela reloc;
+        std::memcpy(&reloc, data + off, sizeof(reloc));
+        if (ELF64_R_SYM(reloc.r_info) >= sym_count) {
+          return false;
+        }
+      }
+    } else if (shdr.sh_type == SHT_GROUP) {
+      if (shdr.sh_info >= sym_count) {
+        return false;
+      }
+    } else if (shdr.sh_name == sec_off(".text")) {
+      has_text = true;
+    } else if (shdr.sh_name == sec_off(".eh_frame")) {
+      // The initial CIE must be present.
+      if (shdr.sh_size < sizeof(u32)) {
+        return false;
+      }
+      has_eh_frame = true;
+    }
+  }
+  if (!has_text || !has_eh_frame) {
+    return false;
+  }
+
+  // Drop the previous contents entirely, including the initial CIE.
+  reset();
+  eh_writer = util::VectorWriter();
+  sections.clear();
+  section_allocator.reset();
+  secref_text = INVALID_SEC_REF;
+  secref_eh_frame = INVALID_SEC_REF;
+
+  strtab.assign(strtab_data);
+  shstrtab_extra.assign(shstrtab_data.substr(SHSTRTAB.size()));
+
+  const char *symtab_data = sec_data(symtab_hdr).data();
+  local_symbols.resize(local_count);
+  global_symbols.resize(sym_count - local_count);
+  std::memcpy(
+      local_symbols.data(), symtab_data, local_count * sizeof(Elf64_Sym));
+  std::memcpy(global_symbols.data(),
+              symtab_data + local_count * sizeof(Elf64_Sym),
+              (sym_count - local_count) * sizeof(Elf64_Sym));
+
+  // Symbol indices in the object file are converted back to SymRef.
+  const auto obj_sym = [local_count](u32 idx) {
+    return SymRef(idx < local_count ? idx : 0x8000'0000 | (idx - local_count));
+  };
+
+  // Section singletons are identified by their predefined name.
+  std::pair<u32, SecRef *> singletons[] = {
+      {           sec_off(".text"),         &secref_text},
+      {         sec_off(".rodata"),       &secref_rodata},
+      {   sec_off(".data.rel.ro"),        &secref_relro},
+      {           sec_off(".data"),         &secref_data},
+      {            sec_off(".bss"),          &secref_bss},
+      {          sec_off(".tdata"),        &secref_tdata},
+      {           sec_off(".tbss"),         &secref_tbss},
+      {       sec_off(".eh_frame"),     &secref_eh_frame},
+      {sec_off(".gcc_except_table"), &secref_except_table},
+  };
+
+  for (u32 i = 0; i < predef_sec_count(); ++i) {
+    (void)create_section(SHT_NULL, 0, 0);
+  }
+  for (u32 i = predef_sec_count(); i < sec_count; ++i) {
+    const Elf64_Shdr &shdr = shdrs[i];
+    SecRef ref = create_section(shdr.sh_type, shdr.sh_flags, shdr.sh_name);
+    DataSection &sec = get_section(ref);
+    sec.hdr = shdr;
+    if (shdr.sh_type != SHT_NOBITS) {
+      std::string_view data = sec_data(shdr);
+      sec.data.resize_uninitialized(data.size());
+      std::memcpy(sec.data.data(), data.data(), data.size());
+    }
+
+    if (shdr.sh_type == SHT_RELA) {
+      for (Elf64_Rela &reloc : get_relocs(static_cast<SecRef>(i - 1))) {
+        u32 sym = obj_sym(ELF64_R_SYM(reloc.r_info)).id();
+        reloc.r_info = ELF64_R_INFO(sym, ELF64_R_TYPE(reloc.r_info));
+      }
+    } else if (shdr.sh_type == SHT_GROUP) {
+      sec.sym = obj_sym(shdr.sh_info);
+    } else {
+      for (auto [name, secref] : singletons) {
+        if (shdr.sh_name == name && *secref == INVALID_SEC_REF) {
+          *secref = ref;
+        }
+      }
+    }
+  }
+
+  for (u32 i = 1; i < local_count; ++i) {
+    const Elf64_Sym &sym = local_symbols[i];
+    if (ELF64_ST_TYPE(sym.st_info) == STT_SECTION && sym.st_shndx < sec_count) {
+      get_section(static_cast<SecRef>(sym.st_shndx)).sym = SymRef(i);
+    }
+  }
+
+  assert(secref_text != INVALID_SEC_REF && secref_eh_frame != INVALID_SEC_REF);
+
+  // New FDEs are appended to the existing unwind info; the first FDE follows
+  // the initial CIE.
+  DataSection &eh_frame = get_section(secref_eh_frame);
+  u32 cie_len;
+  std::memcpy(&cie_len, eh_frame.data.data(), sizeof(cie_len));
+  eh_first_fde_off = sizeof(cie_len) + cie_len;
+  eh_writer = util::VectorWriter(eh_frame.data);
+  return true;
+}
+
 } // end namespace tpde
@@ -4,8 +4,14 @@
 #include "tpde/ElfMapper.hpp"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <compare>
+#include <cstring>
 #include <elf.h>
+#include <iterator>
+#include <mutex>
+#include <shared_mutex>
 #include <unistd.h>
 
 #include "tpde/AssemblerElf.hpp"
@@ -21,6 +27,14 @@
 extern "C" void __register_frame(void *);
 extern "C" void __deregister_frame(void *);
 
+/// Entry point for lazy stubs; expects the stub address in r11 (x86-64) or
+/// the stub address + 8 in x16 (AArch64).
+extern "C" void tpde_lazy_stub_trampoline();
+  #if defined(__x86_64__)
+/// Like tpde_lazy_stub_trampoline, but preserves ymm0-7 instead of xmm0-7.
+extern "C" void tpde_lazy_stub_trampoline_avx();
+  #endif
+
 #else
   #error "unsupported architecture/os combo"
 #endif
@@ -43,18 +57,264 @@ static constexpr Arch TargetArch = Arch::AArch64;
 static constexpr Arch TargetArch = Arch::Unknown;
 #endif
 
+#if defined(__x86_64__)
+// Keep all references within the arena in range of 32-bit pc-relative
+// relocations.
+constexpr size_t SHARED_ARENA_SIZE = size_t{1} << 30;
+#else
+// Keep all calls within the arena in range of R_AARCH64_CALL26.
+constexpr size_t SHARED_ARENA_SIZE = size_t{128} << 20;
+#endif
+
+/// Allocate zeroed RW memory, preferably from the shared arena. size must be a
+/// multiple of the page size.
+u8 *allocate_mapping(size_t size, bool &in_arena) noexcept {
+  if (u8 *res = JITArena::shared().allocate(size)) {
+    in_arena = true;
+    return res;
+  }
+
+  in_arena = false;
+  void *mmap_res = ::mmap(nullptr,
+                          size,
+                          PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS,
+                          -1,
+                          0);
+  if (mmap_res == MAP_FAILED) {
+    return nullptr;
+  }
+  return static_cast<u8 *>(mmap_res);
+}
+
+void free_mapping(u8 *addr, size_t size, bool in_arena) noexcept {
+  if (in_arena) {
+    JITArena::shared().free(addr, size);
+  } else {
+    ::munmap(addr, size);
+  }
+}
+
 } // anonymous namespace
 
+JITArena::JITArena(size_t size) noexcept {
+  size = util::align_up(size, ::getpagesize());
+  void *mmap_res = ::mmap(nullptr,
+                          size,
+                          PROT_NONE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                          -1,
+                          0);
+  if (mmap_res == MAP_FAILED) {
+    TPDE_LOG_WARN("failed to reserve JIT arena of size {:#x}", size);
+    return;
+  }
+  base = static_cast<u8 *>(mmap_res);
+  this->size = size;
+  free_ranges.emplace(0, size);
+}
+
+JITArena::~JITArena() {
+  if (base) {
+    ::munmap(base, size);
+  }
+}
+
+JITArena &JITArena::shared() noexcept {
+  // Never destroyed, mapped code might still be executed during exit.
+  static JITArena *arena = new JITArena(SHARED_ARENA_SIZE);
+  return *arena;
+}
+
+u8 *JITArena::allocate(size_t alloc_size) noexcept {
+  alloc_size = util::align_up(alloc_size, ::getpagesize());
+  size_t off;
+  {
+    std::lock_guard lock{mutex};
+    // First fit: prefer low addresses to keep mappings close to each other.
+    const auto fits = [&](const auto &r) { return r.second >= alloc_size; };
+    auto it = std::find_if(free_ranges.begin(), free_ranges.end(), fits);
+    if (it == free_ranges.end()) {
+      return nullptr;
+    }
+    off = it->first;
+    size_t rem = it->second - alloc_size;
+    free_ranges.erase(it);
+    if (rem) {
+      free_ranges.emplace(off + alloc_size, rem);
+    }
+  }
+
+  // Free ranges are always PROT_NONE and zeroed.
+  if (::mprotect(base + off, alloc_size, PROT_READ | PROT_WRITE) != 0) {
+    free(base + off, alloc_size);
+    return nullptr;
+  }
+  return base + off;
+}
+
+void JITArena::free(u8 *addr, size_t free_size) noexcept {
+  assert(addr >= base && addr < base + size);
+  free_size = util::align_up(free_size, ::getpagesize());
+  // Replace the range with fresh inaccessible pages, which discards the
+  // contents and keeps the address range reserved.
+  void *mmap_res = ::mmap(addr,
+                          free_size,
+                          PROT_NONE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE |
+                              MAP_FIXED,
+                          -1,
+                          0);
+  if (mmap_res == MAP_FAILED) {
+    // Leak the range, it cannot be reused safely.
+    TPDE_LOG_ERR("failed to release JIT arena memory");
+    return;
+  }
+
+  std::lock_guard lock{mutex};
+  size_t off = addr - base;
+  auto next = free_ranges.lower_bound(off);
+  if (next != free_ranges.end() && off + free_size == next->first) {
+    free_size += next->second;
+    next = free_ranges.erase(next);
+  }
+  if (next != free_ranges.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == off) {
+      prev->second += free_size;
+      return;
+    }
+  }
+  free_ranges.emplace_hint(next, off, free_size);
+}
+
+/// Process-wide registry of the unwind info of all mapped objects.
+class UnwindRegistry {
+  struct Object {
+    uintptr_t pc_end;
+    ElfMapper *mapper;
+  };
+
+  std::shared_mutex mutex;
+  /// Objects with FDEs, keyed by the start address of their code.
+  std::map<uintptr_t, Object> objects;
+  /// Objects whose registration with the system unwinder is deferred.
+  std::vector<ElfMapper *> deferred;
+
+public:
+  std::atomic<ElfMapper::UnwindRegistration> mode =
+      ElfMapper::UnwindRegistration::Eager;
+
+  static UnwindRegistry &get() noexcept {
+    // Never destroyed, unwinding might happen during exit.
+    static UnwindRegistry *registry = new UnwindRegistry();
+    return *registry;
+  }
+
+  void add(ElfMapper &mapper, uintptr_t pc_begin, uintptr_t pc_end) noexcept {
+    std::unique_lock lock{mutex};
+    if (pc_begin != pc_end) {
+      objects.emplace(pc_begin, Object{pc_end, &mapper});
+    }
+    switch (mode.load(std::memory_order_relaxed)) {
+    case ElfMapper::UnwindRegistration::Eager: register_frame(mapper); break;
+    case ElfMapper::UnwindRegistration::Deferred:
+      mapper.frame_deferred = true;
+      deferred.push_back(&mapper);
+      break;
+    case ElfMapper::UnwindRegistration::None: break;
+    }
+  }
+
+  void remove(ElfMapper &mapper) noexcept {
+    std::unique_lock lock{mutex};
+    if (mapper.eh_frame_hdr_off) {
+      objects.erase(pc_begin(mapper));
+    }
+    if (mapper.frame_registered) {
+      __deregister_frame(mapper.mapped_addr + mapper.registered_frame_off);
+      mapper.frame_registered = false;
+    }
+    if (mapper.frame_deferred) {
+      auto it = std::find(deferred.begin(), deferred.end(), &mapper);
+      assert(it != deferred.end());
+      *it = deferred.back();
+      deferred.pop_back();
+      mapper.frame_deferred = false;
+    }
+  }
+
+  void register_deferred() noexcept {
+    std::unique_lock lock{mutex};
+    for (ElfMapper *mapper : deferred) {
+      mapper->frame_deferred = false;
+      register_frame(*mapper);
+    }
+    deferred.clear();
+  }
+
+  bool find(uintptr_t pc, ElfMapper::UnwindInfo &info) noexcept {
+    std::shared_lock lock{mutex};
+    auto it = objects.upper_bound(pc);
+    if (it == objects.begin()) {
+      return false;
+    }
+    --it;
+    if (pc >= it->second.pc_end) {
+      return false;
+    }
+
+    const ElfMapper &mapper = *it->second.mapper;
+    const u8 *hdr = mapper.eh_frame_hdr();
+    u32 fde_count;
+    std::memcpy(&fde_count, hdr + 8, sizeof(u32));
+    const auto *table = reinterpret_cast<const std::array<i32, 2> *>(hdr + 12);
+    i64 pc_rel = pc - reinterpret_cast<uintptr_t>(hdr);
+    // First entry with an initial location after pc.
+    const auto before = [](i64 val, const auto &entry) {
+      return val < entry[0];
+    };
+    const auto *entry =
+        std::upper_bound(table, table + fde_count, pc_rel, before);
+
+    info.pc_begin = reinterpret_cast<void *>(it->first);
+    info.pc_end = reinterpret_cast<void *>(it->second.pc_end);
+    info.eh_frame_hdr = hdr;
+    info.eh_frame = hdr + 4 + *reinterpret_cast<const i32 *>(hdr + 4);
+    info.fde = nullptr;
+    if (entry != table) {
+      const u8 *fde = hdr + entry[-1][1];
+      i32 pc_range;
+      std::memcpy(&pc_range, fde + dwarf::EH_FDE_FUNC_START_OFF + 4, 4);
+      if (pc_rel < i64{entry[-1][0]} + pc_range) {
+        info.fde = fde;
+      }
+    }
+    return true;
+  }
+
+private:
+  static uintptr_t pc_begin(const ElfMapper &mapper) noexcept {
+    const u8 *hdr = mapper.eh_frame_hdr();
+    return reinterpret_cast<uintptr_t>(hdr) +
+           *reinterpret_cast<const i32 *>(hdr + 12);
+  }
+
+  static void register_frame(ElfMapper &mapper) noexcept {
+    __register_frame(mapper.mapped_addr + mapper.registered_frame_off);
+    mapper.frame_registered = true;
+  }
+};
+
 void ElfMapper::reset() noexcept {
   if (!mapped_addr) {
     return;
   }
 
-  if (registered_frame_off) {
-    __deregister_frame(mapped_addr + registered_frame_off);
-  }
+  UnwindRegistry::get().remove(*this);
+  eh_frame_hdr_off = 0;
 
-  munmap(mapped_addr, mapped_size);
+  free_mapping(mapped_addr, mapped_size, in_arena);
   mapped_addr = nullptr;
   sym_addrs.clear();
 }
@@ -114,6 +374,27 @@ bool ElfMapper::map(AssemblerElfBase &assembler,
     prev_flags = SHF_EXECINSTR | SHF_ALLOC;
   }
 
+  // Count FDEs for the .eh_frame_hdr-style lookup table.
+  const auto &eh_frame_data =
+      assembler.get_section(assembler.secref_eh_frame).data;
+  const auto for_each_fde = [&](const u8 *eh_frame, auto &&fn) {
+    for (size_t off = 0; off + 8 <= eh_frame_data.size();) {
+      u32 len, id;
+      std::memcpy(&len, eh_frame + off, sizeof(u32));
+      std::memcpy(&id, eh_frame + off + 4, sizeof(u32));
+      if (len == 0) {
+        break;
+      }
+      if (id != 0) {
+        fn(eh_frame + off);
+      }
+      off += 4 + len;
+    }
+  };
+  u32 fde_count = 0;
+  for_each_fde(eh_frame_data.data(), [&](const u8 *) { ++fde_count; });
+  size_t hdr_off = 0;
+
   size_t page_size = ::getpagesize();
   for (const auto &as : alloc_sections) {
     auto &sec = assembler.get_section(as.section);
@@ -136,6 +417,11 @@ bool ElfMapper::map(AssemblerElfBase &assembler,
       // Add zero-terminator to eh_frame. This is required for libgcc's
       // __register_frame, which iterates over FDEs up to the zero-terminator.
       sec_size += 4;
+      // Followed by the binary search table for FDEs.
+      if (fde_count) {
+        hdr_off = util::align_up(base_off + sec_size, 4);
+        sec_size = hdr_off - base_off + 12 + 8 * fde_count;
+      }
     }
     base_off += sec_size;
 
@@ -144,22 +430,15 @@ bool ElfMapper::map(AssemblerElfBase &assembler,
                    sec_size,
                    sec.hdr.sh_addr);
   }
-  // TODO(ts): align base_off up to page_size?
   perm_boundaries.emplace_back(base_off, 0);
 
-  // Allocate memory
-  mapped_size = base_off;
-  void *mmap_res = ::mmap(nullptr,
-                          mapped_size,
-                          PROT_READ | PROT_WRITE,
-                          MAP_PRIVATE | MAP_ANONYMOUS,
-                          -1,
-                          0);
-  if (mmap_res == MAP_FAILED || !mmap_res) {
-    mapped_addr = nullptr;
+  // Allocate memory. Mappings in the shared arena are placed next to each
+  // other, so calls between them don't need PLT entries.
+  mapped_size = util::align_up(base_off, page_size);
+  mapped_addr = allocate_mapping(mapped_size, in_arena);
+  if (!mapped_addr) {
     return false;
   }
-  mapped_addr = static_cast<u8 *>(mmap_res);
 
   bool success = true;
 
@@ -199,11 +478,20 @@ bool ElfMapper::map(AssemblerElfBase &assembler,
 
     return sym_addrs[idx];
   };
-  // Resolve all defined global symbols.
+  // Resolve all defined symbols. Local symbols are needed for lookups of
+  // internal globals, e.g. by lazily compiled functions.
+  const auto sym_is_def = [](const Elf64_Sym &elf_sym) {
+    return elf_sym.st_shndx != SHN_UNDEF &&
+           (elf_sym.st_shndx < SHN_LORESERVE ||
+            elf_sym.st_shndx == SHN_XINDEX || elf_sym.st_shndx == SHN_ABS);
+  };
+  for (size_t i = 0; i < assembler.local_symbols.size(); ++i) {
+    if (sym_is_def(assembler.local_symbols[i])) {
+      (void)sym_addr(typename AssemblerElfBase::SymRef(i));
+    }
+  }
   for (size_t i = 0; i < assembler.global_symbols.size(); ++i) {
-    auto &elf_sym = assembler.global_symbols[i];
-    if (elf_sym.st_shndx != SHN_UNDEF &&
-        (elf_sym.st_shndx < SHN_LORESERVE || elf_sym.st_shndx == SHN_XINDEX)) {
+    if (sym_is_def(assembler.global_symbols[i])) {
       (void)sym_addr(typename AssemblerElfBase::SymRef(0x8000'0000 | i));
     }
   }
@@ -378,6 +666,37 @@ bool ElfMapper::map(AssemblerElfBase &assembler,
     return false;
   }
 
+  // Build the FDE lookup table in the format of .eh_frame_hdr, sorted by the
+  // initial location of the FDEs.
+  auto &eh_frame = assembler.get_section(assembler.secref_eh_frame);
+  uintptr_t pc_begin = 0, pc_end = 0;
+  if (fde_count) {
+    u8 *hdr = mapped_addr + hdr_off;
+    u8 *eh_frame_addr = mapped_addr + eh_frame.hdr.sh_addr;
+    hdr[0] = 1; // version
+    hdr[1] = dwarf::DW_EH_PE_pcrel | dwarf::DW_EH_PE_sdata4;
+    hdr[2] = dwarf::DW_EH_PE_udata4;
+    hdr[3] = dwarf::DW_EH_PE_datarel | dwarf::DW_EH_PE_sdata4;
+    i32 eh_frame_ptr = eh_frame_addr - (hdr + 4);
+    std::memcpy(hdr + 4, &eh_frame_ptr, sizeof(i32));
+    std::memcpy(hdr + 8, &fde_count, sizeof(u32));
+
+    auto *table = reinterpret_cast<std::array<i32, 2> *>(hdr + 12);
+    u32 idx = 0;
+    for_each_fde(eh_frame_addr, [&](const u8 *fde) {
+      const u8 *start_ptr = fde + dwarf::EH_FDE_FUNC_START_OFF;
+      i32 start_rel, pc_range;
+      std::memcpy(&start_rel, start_ptr, sizeof(i32));
+      std::memcpy(&pc_range, start_ptr + 4, sizeof(i32));
+      const u8 *start = start_ptr + start_rel;
+      table[idx++] = {i32(start - hdr), i32(fde - hdr)};
+      pc_end = std::max(pc_end, reinterpret_cast<uintptr_t>(start + pc_range));
+    });
+    assert(idx == fde_count);
+    std::sort(table, table + fde_count);
+    pc_begin = reinterpret_cast<uintptr_t>(hdr) + table[0][0];
+  }
+
   // Adjust permissions
   assert(perm_boundaries.size() > 1);
   for (size_t i = 0; i < perm_boundaries.size() - 1; ++i) {
@@ -395,9 +714,9 @@ bool ElfMapper::map(AssemblerElfBase &assembler,
   }
 
   // Register eh_frame FDEs
-  auto &eh_frame = assembler.get_section(assembler.secref_eh_frame);
   registered_frame_off = eh_frame.hdr.sh_addr + assembler.eh_first_fde_off;
-  __register_frame(mapped_addr + registered_frame_off);
+  eh_frame_hdr_off = hdr_off;
+  UnwindRegistry::get().add(*this, pc_begin, pc_end);
 
   return true;
 }
@@ -408,7 +727,297 @@ void *ElfMapper::get_sym_addr(AssemblerElfBase::SymRef sym) noexcept {
     idx += local_sym_count;
   }
   assert(idx < sym_addrs.size());
+  if (frame_deferred.load(std::memory_order_relaxed)) [[unlikely]] {
+    register_deferred_unwind_info();
+  }
   return sym_addrs[idx];
 }
 
+void ElfMapper::set_unwind_registration(UnwindRegistration mode) noexcept {
+  UnwindRegistry::get().mode.store(mode, std::memory_order_relaxed);
+}
+
+void ElfMapper::register_deferred_unwind_info() noexcept {
+  UnwindRegistry::get().register_deferred();
+}
+
+bool ElfMapper::find_unwind_info(const void *pc, UnwindInfo &info) noexcept {
+  return UnwindRegistry::get().find(reinterpret_cast<uintptr_t>(pc), info);
+}
+
+namespace {
+
+// Stub layout: code (20 bytes), u32 index at 20, LazyStubs pointer at 24.
+// x86-64: jmp [slot]; lea r11, [stub]; jmp [trampoline]; int3
+// AArch64: ldr x16, slot; br x16; ldr x17, trampoline; br x17; udf
+constexpr size_t LAZY_STUB_SIZE = 32;
+constexpr size_t LAZY_STUB_IDX_OFF = 20;
+constexpr size_t LAZY_STUB_OWNER_OFF = 24;
+// The stub code is preceded by the address of the trampoline.
+constexpr size_t LAZY_STUB_HDR_SIZE = 16;
+
+} // anonymous namespace
+
+void LazyStubs::reset() noexcept {
+  if (!mapped_addr) {
+    return;
+  }
+
+  free_mapping(mapped_addr, mapped_size, in_arena);
+  mapped_addr = nullptr;
+  code_addr = nullptr;
+  count = 0;
+}
+
+bool LazyStubs::init(u32 count,
+                     Resolver resolver,
+                     void *ctx,
+                     void *error_handler) noexcept {
+  reset();
+
+  // Slots are writable and placed before the code, which is mapped read-only.
+  size_t page_size = ::getpagesize();
+  size_t slots_size = util::align_up(count * sizeof(uintptr_t), page_size);
+  size_t code_size = LAZY_STUB_HDR_SIZE + count * LAZY_STUB_SIZE;
+  if constexpr (TargetArch == Arch::AArch64) {
+    // ldr (literal) has a range of +-1MiB.
+    if (slots_size + code_size >= (1 << 20)) {
+      TPDE_LOG_ERR("too many lazy stubs: {}", count);
+      return false;
+    }
+  }
+
+  mapped_size = slots_size + util::align_up(code_size, page_size);
+  mapped_addr = allocate_mapping(mapped_size, in_arena);
+  if (!mapped_addr) {
+    return false;
+  }
+  code_addr = mapped_addr + slots_size;
+  this->count = count;
+  this->resolver = resolver;
+  this->resolver_ctx = ctx;
+  this->error_handler = error_handler;
+
+  auto trampoline = reinterpret_cast<uintptr_t>(&tpde_lazy_stub_trampoline);
+#if defined(__x86_64__)
+  // With AVX, vector arguments can be passed in the full ymm registers, whose
+  // upper halves the resolver might clobber.
+  if (__builtin_cpu_supports("avx")) {
+    trampoline = reinterpret_cast<uintptr_t>(&tpde_lazy_stub_trampoline_avx);
+  }
+#endif
+  std::memcpy(code_addr, &trampoline, sizeof(uintptr_t));
+
+  LazyStubs *owner = this;
+  for (u32 i = 0; i < count; ++i) {
+    u8 *stub = code_addr + LAZY_STUB_HDR_SIZE + i * LAZY_STUB_SIZE;
+    u8 *slot = mapped_addr + i * sizeof(uintptr_t);
+    uintptr_t target = 0;
+    if constexpr (TargetArch == Arch::X86_64) {
+      fe64_JMPm(stub, 0, FE_MEM(FE_IP, 0, FE_NOREG, slot - stub));
+      fe64_LEA64rm(stub + 6, 0, FE_R11, FE_MEM(FE_IP, 0, FE_NOREG, -6));
+      fe64_JMPm(
+          stub + 13, 0, FE_MEM(FE_IP, 0, FE_NOREG, code_addr - (stub + 13)));
+      stub[19] = 0xcc; // int3
+      target = reinterpret_cast<uintptr_t>(stub + 6);
+    } else if constexpr (TargetArch == Arch::AArch64) {
+      u32 insts[5] = {
+          de64_LDRx_pcrel(DA_GP(16), (slot - stub) / 4),
+          de64_BR(DA_GP(16)),
+          de64_LDRx_pcrel(DA_GP(17), (code_addr - stub - 8) / 4),
+          de64_BR(DA_GP(17)),
+          0, // udf
+      };
+      std::memcpy(stub, insts, sizeof(insts));
+      target = reinterpret_cast<uintptr_t>(stub + 8);
+    }
+    std::memcpy(stub + LAZY_STUB_IDX_OFF, &i, sizeof(u32));
+    std::memcpy(stub + LAZY_STUB_OWNER_OFF, &owner, sizeof(LazyStubs *));
+    std::memcpy(slot, &target, sizeof(uintptr_t));
+  }
+
+  if constexpr (TargetArch == Arch::AArch64) {
+    __builtin___clear_cache(reinterpret_cast<char *>(code_addr),
+                            reinterpret_cast<char *>(code_addr + code_size));
+  }
+
+  if (mprotect(code_addr,
+               mapped_addr + mapped_size - code_addr,
+               PROT_READ | PROT_EXEC) != 0) {
+    TPDE_LOG_ERR("mprotect failed");
+    reset();
+    return false;
+  }
+  return true;
+}
+
+void *LazyStubs::stub_addr(u32 idx) const noexcept {
+  assert(idx < count);
+  return code_addr + LAZY_STUB_HDR_SIZE + idx * LAZY_STUB_SIZE;
+}
+
+void *LazyStubs::resolve(u32 idx) noexcept {
+  assert(idx < count);
+  void *addr = resolver(resolver_ctx, idx);
+  if (!addr) {
+    if (!error_handler) {
+      TPDE_FATAL("lazy compilation failed");
+    }
+    // Keep the stub, a later call retries the compilation.
+    return error_handler;
+  }
+  auto *slot = reinterpret_cast<uintptr_t *>(mapped_addr) + idx;
+  std::atomic_ref<uintptr_t>(*slot).store(reinterpret_cast<uintptr_t>(addr),
+                                          std::memory_order_release);
+  return addr;
+}
+
 } // namespace tpde
+
+extern "C" [[gnu::visibility("hidden")]] void *
+    tpde_lazy_stub_resolve(const tpde::u8 *stub) {
+  tpde::u32 idx;
+  tpde::LazyStubs *owner;
+  std::memcpy(&idx, stub + tpde::LAZY_STUB_IDX_OFF, sizeof(idx));
+  std::memcpy(&owner, stub + tpde::LAZY_STUB_OWNER_OFF, sizeof(owner));
+  return owner->resolve(idx);
+}
+
+// The trampolines preserve all argument registers (and rax/r10 resp. x8 on
+// x86-64 resp. AArch64) around the call to tpde_lazy_stub_resolve.
+#if defined(__x86_64__)
+asm(R"(
+  .text
+  .p2align 4
+  .globl tpde_lazy_stub_trampoline
+  .hidden tpde_lazy_stub_trampoline
+  .type tpde_lazy_stub_trampoline, @function
+tpde_lazy_stub_trampoline:
+  push %rbp
+  mov %rsp, %rbp
+  push %rdi
+  push %rsi
+  push %rdx
+  push %rcx
+  push %r8
+  push %r9
+  push %rax
+  push %r10
+  sub $128, %rsp
+  movdqu %xmm0, 0(%rsp)
+  movdqu %xmm1, 16(%rsp)
+  movdqu %xmm2, 32(%rsp)
+  movdqu %xmm3, 48(%rsp)
+  movdqu %xmm4, 64(%rsp)
+  movdqu %xmm5, 80(%rsp)
+  movdqu %xmm6, 96(%rsp)
+  movdqu %xmm7, 112(%rsp)
+  mov %r11, %rdi
+  call tpde_lazy_stub_resolve
+  mov %rax, %r11
+  movdqu 0(%rsp), %xmm0
+  movdqu 16(%rsp), %xmm1
+  movdqu 32(%rsp), %xmm2
+  movdqu 48(%rsp), %xmm3
+  movdqu 64(%rsp), %xmm4
+  movdqu 80(%rsp), %xmm5
+  movdqu 96(%rsp), %xmm6
+  movdqu 112(%rsp), %xmm7
+  add $128, %rsp
+  pop %r10
+  pop %rax
+  pop %r9
+  pop %r8
+  pop %rcx
+  pop %rdx
+  pop %rsi
+  pop %rdi
+  pop %rbp
+  jmp *%r11
+  .size tpde_lazy_stub_trampoline, .-tpde_lazy_stub_trampoline
+
+  .p2align 4
+  .globl tpde_lazy_stub_trampoline_avx
+  .hidden tpde_lazy_stub_trampoline_avx
+  .type tpde_lazy_stub_trampoline_avx, @function
+tpde_lazy_stub_trampoline_avx:
+  push %rbp
+  mov %rsp, %rbp
+  push %rdi
+  push %rsi
+  push %rdx
+  push %rcx
+  push %r8
+  push %r9
+  push %rax
+  push %r10
+  sub $256, %rsp
+  vmovdqu %ymm0, 0(%rsp)
+  vmovdqu %ymm1, 32(%rsp)
+  vmovdqu %ymm2, 64(%rsp)
+  vmovdqu %ymm3, 96(%rsp)
+  vmovdqu %ymm4, 128(%rsp)
+  vmovdqu %ymm5, 160(%rsp)
+  vmovdqu %ymm6, 192(%rsp)
+  vmovdqu %ymm7, 224(%rsp)
+  vzeroupper
+  mov %r11, %rdi
+  call tpde_lazy_stub_resolve
+  mov %rax, %r11
+  vmovdqu 0(%rsp), %ymm0
+  vmovdqu 32(%rsp), %ymm1
+  vmovdqu 64(%rsp), %ymm2
+  vmovdqu 96(%rsp), %ymm3
+  vmovdqu 128(%rsp), %ymm4
+  vmovdqu 160(%rsp), %ymm5
+  vmovdqu 192(%rsp), %ymm6
+  vmovdqu 224(%rsp), %ymm7
+  add $256, %rsp
+  pop %r10
+  pop %rax
+  pop %r9
+  pop %r8
+  pop %rcx
+  pop %rdx
+  pop %rsi
+  pop %rdi
+  pop %rbp
+  jmp *%r11
+  .size tpde_lazy_stub_trampoline_avx, .-tpde_lazy_stub_trampoline_avx
+)");
+#elif defined(__aarch64__)
+asm(R"(
+  .text
+  .p2align 2
+  .globl tpde_lazy_stub_trampoline
+  .hidden tpde_lazy_stub_trampoline
+  .type tpde_lazy_stub_trampoline, %function
+tpde_lazy_stub_trampoline:
+  stp x29, x30, [sp, #-224]!
+  mov x29, sp
+  stp x0, x1, [sp, #16]
+  stp x2, x3, [sp, #32]
+  stp x4, x5, [sp, #48]
+  stp x6, x7, [sp, #64]
+  str x8, [sp, #80]
+  stp q0, q1, [sp, #96]
+  stp q2, q3, [sp, #128]
+  stp q4, q5, [sp, #160]
+  stp q6, q7, [sp, #192]
+  sub x0, x16, #8
+  bl tpde_lazy_stub_resolve
+  mov x16, x0
+  ldp q6, q7, [sp, #192]
+  ldp q4, q5, [sp, #160]
+  ldp q2, q3, [sp, #128]
+  ldp q0, q1, [sp, #96]
+  ldr x8, [sp, #80]
+  ldp x6, x7, [sp, #64]
+  ldp x4, x5, [sp, #48]
+  ldp x2, x3, [sp, #32]
+  ldp x0, x1, [sp, #16]
+  ldp x29, x30, [sp], #224
+  br x16
+  .size tpde_lazy_stub_trampoline, .-tpde_lazy_stub_trampoline
+)");
+#endif
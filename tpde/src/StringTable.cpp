@@ -3,32 +3,113 @@
 
 #include "tpde/StringTable.hpp"
 
+#include <cassert>
 #include <cstring>
 
 namespace tpde {
 
-size_t StringTable::add(std::string_view str) noexcept {
-  if (str.empty()) {
+namespace {
+// FNV-1a, which can be continued over multiple pieces of a string.
+constexpr u32 HASH_INIT = 2166136261u;
+
+u32 hash_str(std::string_view str, u32 hash = HASH_INIT) noexcept {
+  for (char c : str) {
+    hash = (hash ^ static_cast<u8>(c)) * 16777619u;
+  }
+  return hash;
+}
+} // namespace
+
+u32 StringTable::find(std::string_view prefix,
+                      std::string_view str,
+                      u32 hash) const noexcept {
+  if (index.empty()) {
     return 0;
   }
+  const size_t len = prefix.size() + str.size();
+  const u32 mask = index.size() - 1;
+  for (u32 slot = hash & mask; index[slot].off != 0; slot = (slot + 1) & mask) {
+    const IndexEntry &entry = index[slot];
+    if (entry.hash != hash || entry.off + len >= strtab.size()) {
+      continue;
+    }
+    const char *s = strtab.data() + entry.off;
+    if (s[len] == '\0' && prefix == std::string_view(s, prefix.size()) &&
+        str == std::string_view(s + prefix.size(), str.size())) {
+      return entry.off;
+    }
+  }
+  return 0;
+}
+
+void StringTable::index_insert(u32 off, u32 hash) noexcept {
+  // Keep the load factor at or below 1/2.
+  if (2 * (index_count + 1) > index.size()) {
+    util::SmallVector<IndexEntry, 0> old = std::move(index);
+    index.clear();
+    index.resize(old.empty() ? 64 : 2 * old.size(), IndexEntry{0, 0});
+    index_count = 0;
+    for (const IndexEntry &entry : old) {
+      if (entry.off != 0) {
+        index_insert(entry.off, entry.hash);
+      }
+    }
+  }
 
-  // TODO: use hash table for deduplication
-  size_t off = strtab.size();
-  strtab.resize_uninitialized(strtab.size() + str.size() + 1);
-  strtab[strtab.size() - 1] = '\0';
-  std::memcpy(strtab.data() + off, str.data(), str.size());
-  return off;
+  const u32 mask = index.size() - 1;
+  u32 slot = hash & mask;
+  while (index[slot].off != 0) {
+    slot = (slot + 1) & mask;
+  }
+  index[slot] = IndexEntry{off, hash};
+  ++index_count;
 }
 
 size_t StringTable::add_prefix(std::string_view prefix,
                                std::string_view str) noexcept {
-  // TODO: use hash table for deduplication
+  if (prefix.empty() && str.empty()) {
+    return 0;
+  }
+
+  const u32 str_hash = hash_str(str);
+  const u32 hash = prefix.empty() ? str_hash : hash_str(str, hash_str(prefix));
+  if (u32 off = find(prefix, str, hash)) {
+    return off;
+  }
+
   size_t off = strtab.size();
   strtab.resize_uninitialized(strtab.size() + prefix.size() + str.size() + 1);
   strtab[strtab.size() - 1] = '\0';
-  std::memcpy(strtab.data() + off, prefix.data(), prefix.size());
+  if (!prefix.empty()) {
+    std::memcpy(strtab.data() + off, prefix.data(), prefix.size());
+  }
   std::memcpy(strtab.data() + off + prefix.size(), str.data(), str.size());
+  index_insert(off, hash);
+
+  // Tail merging: make str itself available at the end of the new string,
+  // e.g. ".text.f" inside ".rela.text.f".
+  if (!prefix.empty() && !str.empty() && !find({}, str, str_hash)) {
+    index_insert(off + prefix.size(), str_hash);
+  }
   return off;
 }
 
+void StringTable::assign(std::string_view data) noexcept {
+  assert(!data.empty() && data[0] == '\0');
+  strtab.resize_uninitialized(data.size());
+  std::memcpy(strtab.data(), data.data(), data.size());
+
+  index.clear();
+  index_count = 0;
+  for (size_t off = 1; off < data.size();) {
+    std::string_view str{data.data() + off,
+                         strnlen(data.data() + off, data.size() - off)};
+    u32 hash = hash_str(str);
+    if (!str.empty() && !find({}, str, hash)) {
+      index_insert(off, hash);
+    }
+    off += str.size() + 1;
+  }
+}
+
 } // end namespace tpde
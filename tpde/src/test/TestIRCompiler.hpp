@@ -19,6 +19,7 @@ struct TestIRCompilerX64 : x64::CompilerX64<TestIRAdaptor, TestIRCompilerX64> {
   using InstRange = typename Base::InstRange;
 
   bool no_fixed_assignments;
+  bool reg_snapshots = false;
 
   explicit TestIRCompilerX64(TestIRAdaptor *adaptor, bool no_fixed_assignments)
       : Base{adaptor}, no_fixed_assignments(no_fixed_assignments) {}
@@ -59,6 +60,8 @@ struct TestIRCompilerX64 : x64::CompilerX64<TestIRAdaptor, TestIRCompilerX64> {
     return ir()->values[static_cast<u32>(value)].force_fixed_assignment;
   }
 
+  bool use_reg_snapshots() const noexcept { return reg_snapshots; }
+
   std::optional<ValRefSpecial> val_ref_special(IRValueRef) noexcept {
     return {};
   }
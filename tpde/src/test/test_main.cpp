@@ -2,9 +2,11 @@
 //
 // SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
 
+#include <algorithm>
 #include <cstdio>
 #include <fstream>
 #include <iostream>
+#include <memory>
 
 #define ARGS_NOEXCEPT
 #include <args/args.hxx>
@@ -61,12 +63,27 @@ int main(int argc, char *argv[]) {
                             "Print the liveness information",
                             {"print-liveness"});
 
+  args::ValueFlag<unsigned> loop_lca_min_depth(
+      parser,
+      "depth",
+      "Minimum loop nesting depth for constant-time lowest common loop queries "
+      "in the liveness analysis, 0 always uses them",
+      {"loop-lca-min-depth"},
+      8);
+
   args::Flag no_fixed_assignments(
       parser,
       "no_fixed_assignments",
       "Prevent fixed assignments from occuring unless they are forced",
       {"no-fixed-assignments"});
 
+  args::Flag reg_snapshots(
+      parser,
+      "reg_snapshots",
+      "Keep register assignments at branches to later single-predecessor "
+      "blocks (x64 only)",
+      {"reg-snapshots"});
+
   std::unordered_map<std::string_view, RunTestUntil> run_map{
       {    "full",          RunTestUntil::full},
       {      "ir",    RunTestUntil::ir_parsing},
@@ -91,6 +108,20 @@ int main(int argc, char *argv[]) {
                                              arch_map,
                                              Arch::x64);
 
+  args::ValueFlag<unsigned> threads(
+      parser,
+      "threads",
+      "Number of threads used for compilation (x64 only), 0 compiles without "
+      "splitting functions into chunks",
+      {"threads"},
+      0);
+  args::ValueFlag<unsigned> parallel_chunk_size(
+      parser,
+      "chunk_size",
+      "Number of functions per chunk for parallel compilation",
+      {"parallel-chunk-size"},
+      256);
+
   args::ValueFlag<std::string> obj_out_path(
       parser,
       "obj_path",
@@ -178,6 +209,7 @@ int main(int argc, char *argv[]) {
     test::TestIRAdaptor adaptor{&ir};
 
     Analyzer<test::TestIRAdaptor> analyzer{&adaptor};
+    analyzer.loop_lca_min_depth = loop_lca_min_depth.Get();
 
     for (auto func : adaptor.funcs()) {
       if (adaptor.func_extern(func)) {
@@ -220,10 +252,29 @@ int main(int argc, char *argv[]) {
   if (arch.Get() == Arch::x64) {
     test::TestIRAdaptor adaptor{&ir};
     test::TestIRCompilerX64 compiler{&adaptor, no_fixed_assignments};
+    compiler.reg_snapshots = reg_snapshots;
 
-    if (!compiler.compile()) {
-      TPDE_LOG_ERR("Failed to compile IR");
-      return 1;
+    if (threads.Get() == 0) {
+      if (!compiler.compile()) {
+        TPDE_LOG_ERR("Failed to compile IR");
+        return 1;
+      }
+    } else {
+      std::vector<std::unique_ptr<test::TestIRAdaptor>> worker_adaptors;
+      std::vector<std::unique_ptr<test::TestIRCompilerX64>> worker_compilers;
+      std::vector<test::TestIRCompilerX64 *> workers;
+      for (unsigned i = 0; i < threads.Get(); ++i) {
+        worker_adaptors.push_back(std::make_unique<test::TestIRAdaptor>(&ir));
+        worker_compilers.push_back(std::make_unique<test::TestIRCompilerX64>(
+            worker_adaptors.back().get(), no_fixed_assignments));
+        worker_compilers.back()->reg_snapshots = reg_snapshots;
+        workers.push_back(worker_compilers.back().get());
+      }
+      if (!compiler.compile_parallel(workers,
+                                     std::max(parallel_chunk_size.Get(), 1u))) {
+        TPDE_LOG_ERR("Failed to compile IR");
+        return 1;
+      }
     }
 
     if (obj_out_path) {
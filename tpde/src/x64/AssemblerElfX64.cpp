@@ -3,6 +3,9 @@
 
 #include "tpde/x64/AssemblerElfX64.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 namespace tpde::x64 {
 
 namespace {
@@ -43,4 +46,159 @@ const AssemblerElfBase::TargetInfo AssemblerElfX64::TARGET_INFO{
     .reloc_abs64 = R_X86_64_64,
 };
 
+void AssemblerElfX64::relax_begin_func(SecRef sec, u32 off) noexcept {
+  relax_sec = sec;
+  relax_start = off;
+  relax_first_label = label_count();
+  relax_items.clear();
+  relax_pcrel_disps.clear();
+  relax_jump_tables.clear();
+}
+
+u32 AssemblerElfX64::relax_func(u32 end) noexcept {
+  if (relax_items.empty()) {
+    return end;
+  }
+
+  u8 *data = get_section(relax_sec).data.data();
+  const auto long_size = [data](u32 off) -> u8 {
+    u8 opc = data[off];
+    // jmp rel8/rel32 or jcc rel8/rel32
+    assert(opc == 0xeb || opc == 0xe9 || (opc & 0xf0) == 0x70 || opc == 0x0f);
+    return opc == 0xeb || opc == 0xe9 ? 5 : 6;
+  };
+
+  // Start optimistically with rel8 for all jumps and grow jumps whose target
+  // is out of range until a fixed point is reached. Jumps only grow, so this
+  // terminates. Alignment padding can grow when code before it shrinks, so
+  // distances can exceed the emitted ones; if a jump emitted as rel8 goes out
+  // of range, the function is left unchanged.
+  for (RelaxItem &item : relax_items) {
+    assert(item.off >= relax_start && item.off < end);
+    if (item.align) {
+      continue;
+    }
+    assert(!label_is_pending(item.target));
+    u8 opc = data[item.off];
+    item.old_size = opc == 0x0f || opc == 0xe9 ? long_size(item.off) : 2;
+    item.size = 2;
+  }
+
+  // shrink[i] is the number of bytes removed before item i.
+  auto &shrink = relax_shrink;
+  shrink.resize(relax_items.size() + 1);
+  const auto compute_shrink = [&] {
+    shrink[0] = 0;
+    for (size_t i = 0; i < relax_items.size(); ++i) {
+      RelaxItem &item = relax_items[i];
+      if (item.align) {
+        u32 new_off = item.off - shrink[i];
+        item.size = util::align_up(new_off, item.align) - new_off;
+      }
+      // Padding can grow, but never beyond the bytes removed before it.
+      shrink[i + 1] = shrink[i] + item.old_size - item.size;
+    }
+  };
+  const auto map = [&](u32 off) -> u32 {
+    // Jumps starting at off are not moved before off; code at the end of
+    // padding is moved with the padding.
+    auto it = std::upper_bound(
+        relax_items.begin(),
+        relax_items.end(),
+        off,
+        [](u32 off, const RelaxItem &item) {
+          return off < item.off + (item.align ? item.old_size : 1);
+        });
+    return off - shrink[it - relax_items.begin()];
+  };
+
+  bool changed;
+  do {
+    changed = false;
+    compute_shrink();
+    for (size_t i = 0; i < relax_items.size(); ++i) {
+      RelaxItem &item = relax_items[i];
+      if (item.align || item.size != 2) {
+        continue;
+      }
+      i64 src = item.off - shrink[i] + 2;
+      i64 dst = map(label_offset(item.target));
+      if (dst - src < -128 || dst - src > 127) {
+        if (item.old_size == 2) {
+          return end;
+        }
+        item.size = long_size(item.off);
+        changed = true;
+      }
+    }
+  } while (changed);
+
+  if (std::all_of(relax_items.begin(), relax_items.end(), [](const auto &i) {
+        return i.size == i.old_size;
+      })) {
+    return end;
+  }
+
+  // Move code between the items, encode jumps with their final size and
+  // re-emit the padding of alignment points.
+  u32 src = relax_items[0].off, dst = src;
+  for (size_t i = 0; i < relax_items.size(); ++i) {
+    const RelaxItem &item = relax_items[i];
+    assert(item.off >= src);
+    std::memmove(data + dst, data + src, item.off - src);
+    dst += item.off - src;
+    assert(dst == item.off - shrink[i]);
+    src = item.off + item.old_size;
+
+    if (item.align) {
+      if (item.size) {
+        fe64_NOP(data + dst, item.size);
+      }
+      dst += item.size;
+      continue;
+    }
+
+    u8 opc = data[item.off];
+    bool is_jmp = opc == 0xeb || opc == 0xe9;
+    u8 cc = opc == 0x0f ? data[item.off + 1] & 0xf : opc & 0xf;
+    i32 disp = (i32)map(label_offset(item.target)) - (i32)(dst + item.size);
+    if (item.size == 2) {
+      data[dst] = is_jmp ? 0xeb : 0x70 | cc;
+      data[dst + 1] = (u8)(i8)disp;
+    } else if (is_jmp) {
+      data[dst] = 0xe9;
+      std::memcpy(data + dst + 1, &disp, sizeof(i32));
+    } else {
+      data[dst] = 0x0f;
+      data[dst + 1] = 0x80 | cc;
+      std::memcpy(data + dst + 2, &disp, sizeof(i32));
+    }
+    dst += item.size;
+  }
+  std::memmove(data + dst, data + src, end - src);
+
+  // Fix references to moved code; the values are relative, so the old target
+  // can be recovered from the value.
+  for (u32 off : relax_pcrel_disps) {
+    i32 value;
+    std::memcpy(&value, data + map(off), sizeof(i32));
+    u32 target = off + 4 + value;
+    value = (i32)map(target) - (i32)(map(off) + 4);
+    std::memcpy(data + map(off), &value, sizeof(i32));
+  }
+  for (auto [table_off, count] : relax_jump_tables) {
+    u32 new_table_off = map(table_off);
+    for (u32 i = 0; i < count; ++i) {
+      u8 *entry = data + new_table_off + 4 * i;
+      i32 value;
+      std::memcpy(&value, entry, sizeof(i32));
+      value = (i32)map(table_off + value) - (i32)new_table_off;
+      std::memcpy(entry, &value, sizeof(i32));
+    }
+  }
+
+  remap_code_offsets(relax_sec, relax_start, relax_first_label, map);
+  return end - shrink.back();
+}
+
 } // end namespace tpde::x64